@@ -0,0 +1,127 @@
+﻿using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Reflection;
+using System.Runtime.Loader;
+
+namespace GameEstate.App.Quest
+{
+    // The app proper. It lives in its own assembly so it can be reloaded while the VR session keeps running.
+    public interface IQuestApp
+    {
+        void Initialize(string[] args);
+        void Frame(long frameIndex, double displayTime);
+        void Shutdown();
+    }
+
+    // Loads the assembly named by DotQuest.App.Assembly (relative to App.Quest.dll) into a collectible context and
+    // creates its DotQuest.App.Type. The native entry points stay in App.Quest and forward to the current instance,
+    // so reloading only swaps that instance; FrameChannel and CommandBuffer stay attached throughout.
+    public static class AppLoader
+    {
+        sealed class AppLoadContext : AssemblyLoadContext
+        {
+            readonly string _directory;
+
+            public AppLoadContext(string directory) : base("App", isCollectible: true) => _directory = directory;
+
+            protected override Assembly Load(AssemblyName name)
+            {
+                // the contract has to be the host's own copy, or IQuestApp would be a different type in here
+                if (name.Name == s_HostAssembly.GetName().Name)
+                    return s_HostAssembly;
+                var path = Path.Combine(_directory, name.Name + ".dll");
+                return File.Exists(path) ? LoadFromBytes(this, path) : null;
+            }
+        }
+
+        static readonly Assembly s_HostAssembly = typeof(IQuestApp).Assembly;
+        static readonly List<WeakReference> s_Unloaded = new List<WeakReference>();
+        static string[] s_Args;
+        static string s_AssemblyPath;
+        static string s_TypeName;
+        static AppLoadContext s_Context;
+
+        public static IQuestApp Current { get; private set; }
+
+        public static void Initialize(string[] args)
+        {
+            s_Args = args;
+            var assembly = AppContext.GetData("DotQuest.App.Assembly") as string;
+            s_TypeName = AppContext.GetData("DotQuest.App.Type") as string;
+            if (string.IsNullOrEmpty(assembly) || string.IsNullOrEmpty(s_TypeName))
+                return;
+            s_AssemblyPath = Path.Combine(Path.GetDirectoryName(s_HostAssembly.Location), assembly);
+            Load();
+        }
+
+        // Shuts the current app down, unloads its context and loads the assembly again. Called by the host between
+        // frames. Returns the number of contexts from earlier reloads still alive after a full collection; the one
+        // just unloaded is not counted, unloading takes a few collections to finish.
+        public static int Reload()
+        {
+            if (s_AssemblyPath == null)
+                return 0;
+            Unload();
+            Load();
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+            GC.Collect();
+            var leaked = 0;
+            for (var i = 0; i < s_Unloaded.Count - 1; i++)
+                if (s_Unloaded[i].IsAlive)
+                    leaked++;
+            s_Unloaded.RemoveAll(context => !context.IsAlive);
+            return leaked;
+        }
+
+        public static void Shutdown() => Unload();
+
+        // Reads the file into memory first, so the build can overwrite it while it is loaded.
+        static Assembly LoadFromBytes(AssemblyLoadContext context, string path)
+        {
+            using var assembly = new MemoryStream(File.ReadAllBytes(path));
+            var symbolsPath = Path.ChangeExtension(path, ".pdb");
+            if (!File.Exists(symbolsPath))
+                return context.LoadFromStream(assembly);
+            using var symbols = new MemoryStream(File.ReadAllBytes(symbolsPath));
+            return context.LoadFromStream(assembly, symbols);
+        }
+
+        static void Load()
+        {
+            try
+            {
+                s_Context = new AppLoadContext(Path.GetDirectoryName(s_AssemblyPath));
+                var type = LoadFromBytes(s_Context, s_AssemblyPath).GetType(s_TypeName, true);
+                Current = (IQuestApp)Activator.CreateInstance(type);
+                Current.Initialize(s_Args);
+            }
+            catch (Exception e)
+            {
+                Console.WriteLine($"AppLoader: unable to load {s_TypeName} from {s_AssemblyPath}: {e}");
+                Current = null;
+            }
+        }
+
+        static void Unload()
+        {
+            if (s_Context == null)
+                return;
+            try
+            {
+                Current?.Shutdown();
+            }
+            catch (Exception e)
+            {
+                Console.WriteLine($"AppLoader: shutdown failed: {e}");
+            }
+            Current = null;
+            // handlers left here would keep the old context alive
+            FrameGC.ClearSafePoint();
+            s_Unloaded.Add(new WeakReference(s_Context));
+            s_Context.Unload();
+            s_Context = null;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+﻿using System.Numerics;
+using System.Runtime.CompilerServices;
+
+namespace GameEstate.App.Quest
+{
+    // Must match the COMMAND_* and UNIFORM_* values in VrCompositor.h.
+    public enum CommandOp : ushort
+    {
+        SetLayer = 1,
+        Clear,
+        SetProgram,
+        SetGeometry,
+        SetTexture,
+        SetUniform,
+        Draw,
+    }
+
+    public enum Uniform : uint
+    {
+        ModelMatrix,
+        ViewId,
+        SceneMatrices,
+        Color,
+    }
+
+    // Writes render commands straight into the native command memory the host attached. The host replays
+    // them after Frame returns, so a frame costs one native call no matter how many draws it contains.
+    // Matrices are written as System.Numerics lays them out, which is what GL expects column-major.
+    public static unsafe class CommandBuffer
+    {
+        public const uint ColorBufferBit = 0x00004000;
+        public const uint DepthBufferBit = 0x00000100;
+
+        static byte* s_Data;
+        static int s_Capacity;
+        static int s_Length;
+
+        public static bool Attached => s_Data != null;
+        public static int Length => s_Length;
+
+        internal static int Attach(byte* data, int capacity)
+        {
+            if (data == null || capacity <= 0)
+                return 1;
+            s_Data = data;
+            s_Capacity = capacity;
+            s_Length = 0;
+            return 0;
+        }
+
+        public static void Reset() => s_Length = 0;
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        static byte* Write(CommandOp op, int argumentBytes)
+        {
+            var size = 4 + argumentBytes;
+            if (s_Length + size > s_Capacity)
+                return null;
+            var command = s_Data + s_Length;
+            *(ushort*)command = (ushort)op;
+            *(ushort*)(command + 2) = (ushort)size;
+            s_Length += size;
+            return command + 4;
+        }
+
+        public static bool SetLayer(uint layer)
+        {
+            var args = Write(CommandOp.SetLayer, 4);
+            if (args == null) return false;
+            *(uint*)args = layer;
+            return true;
+        }
+
+        public static bool Clear(uint mask, Vector4 color, float depth = 1f)
+        {
+            var args = Write(CommandOp.Clear, 4 + 5 * 4);
+            if (args == null) return false;
+            *(uint*)args = mask;
+            *(Vector4*)(args + 4) = color;
+            *(float*)(args + 20) = depth;
+            return true;
+        }
+
+        public static bool SetProgram(uint program)
+        {
+            var args = Write(CommandOp.SetProgram, 4);
+            if (args == null) return false;
+            *(uint*)args = program;
+            return true;
+        }
+
+        public static bool SetGeometry(uint mesh)
+        {
+            var args = Write(CommandOp.SetGeometry, 4);
+            if (args == null) return false;
+            *(uint*)args = mesh;
+            return true;
+        }
+
+        public static bool SetTexture(uint unit, uint texture)
+        {
+            var args = Write(CommandOp.SetTexture, 8);
+            if (args == null) return false;
+            *(uint*)args = unit;
+            *(uint*)(args + 4) = texture;
+            return true;
+        }
+
+        public static bool SetUniform(Uniform uniform, in Vector4 value)
+        {
+            var args = Write(CommandOp.SetUniform, 4 + 16);
+            if (args == null) return false;
+            *(uint*)args = (uint)uniform;
+            *(Vector4*)(args + 4) = value;
+            return true;
+        }
+
+        public static bool SetUniform(Uniform uniform, in Matrix4x4 value)
+        {
+            var args = Write(CommandOp.SetUniform, 4 + 64);
+            if (args == null) return false;
+            *(uint*)args = (uint)uniform;
+            *(Matrix4x4*)(args + 4) = value;
+            return true;
+        }
+
+        public static bool Draw(in Matrix4x4 model)
+        {
+            var args = Write(CommandOp.Draw, 64);
+            if (args == null) return false;
+            *(Matrix4x4*)args = model;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+﻿using System;
+using System.Numerics;
+
+namespace GameEstate.App.Quest
+{
+    // --drawbench N: draws an N cube grid in front of the user every frame through the command buffer, with the
+    // host's default program, cube mesh and white texture (handle 0 of each). The default program is instanced, so
+    // the host draws the grid as one batch per eye. Native timing is reported by the host.
+    public static class DrawBench
+    {
+        static int s_Count;
+
+        public static bool Enabled => s_Count > 0;
+
+        public static void Enable(string[] args)
+        {
+            var i = Array.IndexOf(args, "--drawbench");
+            if (i >= 0 && i + 1 < args.Length && int.TryParse(args[i + 1], out var count) && count > 0)
+                s_Count = count;
+        }
+
+        public static void Frame(double displayTime)
+        {
+            if (!Enabled || !CommandBuffer.Attached)
+                return;
+            CommandBuffer.SetLayer(0);
+            CommandBuffer.Clear(CommandBuffer.ColorBufferBit | CommandBuffer.DepthBufferBit, new Vector4(0.125f, 0f, 0.125f, 1f));
+            CommandBuffer.SetProgram(0);
+            CommandBuffer.SetGeometry(0);
+            CommandBuffer.SetTexture(0, 0);
+            CommandBuffer.SetUniform(Uniform.Color, Vector4.One);
+
+            var side = (int)MathF.Ceiling(MathF.Sqrt(s_Count));
+            var spacing = 4f / side;
+            var scale = Matrix4x4.CreateScale(spacing * 0.5f);
+            var spin = Matrix4x4.CreateFromYawPitchRoll((float)(displayTime % (2 * Math.PI)), 0.5f, 0f);
+            for (var i = 0; i < s_Count; i++)
+            {
+                var x = (i % side - (side - 1) * 0.5f) * spacing;
+                var y = (i / side - (side - 1) * 0.5f) * spacing;
+                if (!CommandBuffer.Draw(scale * spin * Matrix4x4.CreateTranslation(x, y + 1.5f, -4f)))
+                    break;
+            }
+        }
+    }
+}
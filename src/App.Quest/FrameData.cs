@@ -0,0 +1,83 @@
+﻿using System.Numerics;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+namespace GameEstate.App.Quest
+{
+    // Mirrors ovrFrameData in FrameData.h; bump Version on both sides when the layout changes.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct FramePose
+    {
+        public Quaternion Orientation;
+        public Vector3 Position;
+        public uint Status;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct FrameController
+    {
+        public uint Buttons;
+        public uint Touches;
+        public float IndexTrigger;
+        public float GripTrigger;
+        public Vector2 Joystick;
+        public FramePose Pose;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    public struct FrameData
+    {
+        public const uint CurrentVersion = 1;
+
+        public uint Version;
+        public uint Size;
+        public uint Sequence;
+        public uint Reserved;
+        public long FrameIndex;
+        public double DisplayTime;
+        public double SampleTime;
+        public FramePose Head;
+        public FrameController Left;
+        public FrameController Right;
+        public float FrameSeconds;
+        public float ManagedSeconds;
+    }
+
+    // Reads the block the host publishes every frame. A snapshot is a plain copy onto the caller's stack:
+    // no marshalling and no allocations, and the sequence lock makes sure the copy is never torn.
+    public static unsafe class FrameChannel
+    {
+        static FrameData* s_Data;
+
+        public static bool Attached => s_Data != null;
+
+        internal static int Attach(FrameData* data, int size)
+        {
+            if (data == null || size != sizeof(FrameData) || data->Version != FrameData.CurrentVersion)
+                return 1;
+            s_Data = data;
+            return 0;
+        }
+
+        public static bool TryRead(out FrameData frame)
+        {
+            frame = default;
+            if (s_Data == null)
+                return false;
+            for (var spin = 0; spin < 100; spin++)
+            {
+                var sequence = Volatile.Read(ref s_Data->Sequence);
+                if ((sequence & 1) != 0)
+                {
+                    Thread.SpinWait(1);
+                    continue;
+                }
+                frame = *s_Data;
+                Interlocked.MemoryBarrier();
+                if (Volatile.Read(ref s_Data->Sequence) == sequence)
+                    return true;
+            }
+            return false;
+        }
+    }
+}
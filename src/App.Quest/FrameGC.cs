@@ -0,0 +1,112 @@
+﻿using System;
+using System.Runtime;
+using System.Runtime.InteropServices;
+
+namespace GameEstate.App.Quest
+{
+    // Mirrors dotnet_gc_pause in DotNetHost.h.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct GCPause
+    {
+        public int Collections;
+        public int Generation;
+        public double Milliseconds;
+    }
+
+    public enum FrameGCMode
+    {
+        None,
+        // collect gen0 at the start of a frame once DotQuest.GC.Gen0Budget bytes were allocated since the last one
+        Gen0,
+        // keep a no GC region of DotQuest.GC.NoGCRegionBytes open, restarting it at the start of a frame whenever
+        // an allocation overran it
+        NoGCRegion,
+    }
+
+    // Runs at the host's per-frame safe point, before anything else in the frame, so the collections this app
+    // chooses to pay for land at a frame boundary instead of in the middle of rendering. Configured from main.cfg.
+    public static class FrameGC
+    {
+        static readonly GCKind[] s_Kinds = { GCKind.Ephemeral, GCKind.FullBlocking, GCKind.Background };
+
+        static FrameGCMode s_Mode;
+        static long s_Gen0Budget;
+        static long s_NoGCRegionBytes;
+        static long s_AllocatedAtCollect;
+        static long s_LastIndex;
+        static int s_LastCount;
+
+        // Raised at every safe point after the configured policy ran, with the index of the frame about to start.
+        public static event Action<long> SafePoint;
+
+        public static FrameGCMode Mode => s_Mode;
+
+        internal static void ClearSafePoint() => SafePoint = null;
+
+        public static void Configure()
+        {
+            Enum.TryParse(AppContext.GetData("DotQuest.GC.FrameMode") as string, true, out s_Mode);
+            long.TryParse(AppContext.GetData("DotQuest.GC.Gen0Budget") as string, out s_Gen0Budget);
+            long.TryParse(AppContext.GetData("DotQuest.GC.NoGCRegionBytes") as string, out s_NoGCRegionBytes);
+            if (s_Mode == FrameGCMode.Gen0 && s_Gen0Budget <= 0)
+                s_Gen0Budget = 4 * 1024 * 1024;
+            if (s_Mode == FrameGCMode.NoGCRegion && s_NoGCRegionBytes <= 0)
+                s_NoGCRegionBytes = 16 * 1024 * 1024;
+            s_AllocatedAtCollect = GC.GetTotalAllocatedBytes();
+            s_LastCount = GC.CollectionCount(0);
+            Console.WriteLine($"FrameGC: {s_Mode}, server {GCSettings.IsServerGC}, latency {GCSettings.LatencyMode}");
+        }
+
+        internal static unsafe int OnSafePoint(long frameIndex, GCPause* pause)
+        {
+            switch (s_Mode)
+            {
+                case FrameGCMode.Gen0:
+                    if (GC.GetTotalAllocatedBytes() - s_AllocatedAtCollect >= s_Gen0Budget)
+                    {
+                        GC.Collect(0, GCCollectionMode.Forced, true, false);
+                        s_AllocatedAtCollect = GC.GetTotalAllocatedBytes();
+                    }
+                    break;
+                case FrameGCMode.NoGCRegion:
+                    if (GCSettings.LatencyMode != GCLatencyMode.NoGCRegion)
+                        try
+                        {
+                            GC.TryStartNoGCRegion(s_NoGCRegionBytes, true);
+                        }
+                        catch (ArgumentOutOfRangeException)
+                        {
+                            Console.WriteLine($"FrameGC: a {s_NoGCRegionBytes} byte region is larger than the ephemeral segment, disabled");
+                            s_Mode = FrameGCMode.None;
+                        }
+                    break;
+            }
+            SafePoint?.Invoke(frameIndex);
+            return Measure(pause);
+        }
+
+        // Collections since the previous safe point, every collection counts toward gen0. Only the latest collection
+        // of each kind keeps its pause times, which covers the common case of at most one of each per frame.
+        static unsafe int Measure(GCPause* pause)
+        {
+            *pause = default;
+            var count = GC.CollectionCount(0);
+            pause->Collections = count - s_LastCount;
+            s_LastCount = count;
+            if (pause->Collections == 0)
+                return 0;
+            var lastIndex = s_LastIndex;
+            foreach (var kind in s_Kinds)
+            {
+                var info = GC.GetGCMemoryInfo(kind);
+                if (info.Index <= lastIndex)
+                    continue;
+                pause->Generation = Math.Max(pause->Generation, info.Generation);
+                foreach (var duration in info.PauseDurations)
+                    pause->Milliseconds += duration.TotalMilliseconds;
+                s_LastIndex = Math.Max(s_LastIndex, info.Index);
+            }
+            return pause->Collections;
+        }
+    }
+}
@@ -0,0 +1,270 @@
+﻿using System;
+using System.Diagnostics;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Text;
+
+namespace GameEstate.App.Quest
+{
+    // Mirrors ovrHostFrameStats in HostApi.h.
+    [StructLayout(LayoutKind.Sequential)]
+    public struct HostFrameStats
+    {
+        public long FrameIndex;
+        public double DisplayTime;
+        public long CommandFrames;
+        public long CommandDraws;
+        public double CommandSeconds;
+        public long UploadedTextures;
+        public long UploadedBytes;
+        public double UploadSeconds;
+        public long JobsSubmitted;
+        public long JobsRanInline;
+    }
+
+    // Mirrors ovrPoseSample in PoseHistory.h.
+    [StructLayout(LayoutKind.Sequential)]
+    public unsafe struct HostPose
+    {
+        // x, y, z, w
+        public fixed float Orientation[4];
+        public fixed float Position[3];
+        // radians per second, world axes
+        public fixed float AngularVelocity[3];
+        // meters per second
+        public fixed float LinearVelocity[3];
+        // ovrTrackingStatus, 0 while the device is not tracked
+        public uint Status;
+    }
+
+    // Mirrors ovrHostApi in HostApi.h; bump Version on both sides when the layout changes.
+    [StructLayout(LayoutKind.Sequential)]
+    public unsafe struct HostApiTable
+    {
+        public const int CurrentVersion = 8;
+
+        public int Version;
+        public int Size;
+        public delegate* unmanaged<int, byte*, void> Log;
+        public delegate* unmanaged<double> TimeInSeconds;
+        public delegate* unmanaged<delegate* unmanaged<IntPtr, void>, IntPtr, long> SubmitJob;
+        public delegate* unmanaged<long, void> WaitJob;
+        public delegate* unmanaged<int, void> SubmitLayer;
+        public delegate* unmanaged<HostFrameStats*, void> GetFrameStats;
+        public delegate* unmanaged<float*, float*, float*, float*, float*, float*, float*, int, void> TransformPoints;
+        public delegate* unmanaged<float*, float*, float*, int, void> ConcatTransforms;
+        public delegate* unmanaged<float*, float*, float*, float*, int, int, void> BlendQuaternions;
+        public delegate* unmanaged<ushort*, float*, int, void> FloatToHalf;
+        public delegate* unmanaged<float*, ushort*, int, void> HalfToFloat;
+        public delegate* unmanaged<int, float*, float*, int, int*, int> CullBoxes;
+        public delegate* unmanaged<int, float*, int, int*, int> CullSpheres;
+        public delegate* unmanaged<int, double, HostPose*, int> GetPose;
+        public delegate* unmanaged<byte*, int> LoadTexture;
+        public delegate* unmanaged<int, int, void*, int> UploadTexture;
+    }
+
+    public enum HostLogPriority
+    {
+        Verbose = 2,
+        Debug,
+        Info,
+        Warn,
+        Error,
+    }
+
+    // QUAT_BLEND_* in lib/Math.h
+    public enum QuaternionBlend
+    {
+        Slerp,
+        // nlerp with a corrected weight, within 5e-4 of slerp
+        SlerpFast,
+        Nlerp,
+    }
+
+    // CULL_* in Culling.h
+    public enum CullView
+    {
+        Left,
+        Right,
+        // both eyes at once
+        Stereo,
+    }
+
+    // POSE_* in PoseHistory.h
+    public enum PoseDevice
+    {
+        Head,
+        LeftController,
+        RightController,
+    }
+
+    [Flags]
+    public enum HostLayer
+    {
+        LoadingIcon = 1,
+    }
+
+    // The native functions the host handed over at startup. Every call is a plain indirect call through the table.
+    public static unsafe class Host
+    {
+        static HostApiTable* s_Api;
+
+        public static bool Attached => s_Api != null;
+
+        internal static int Attach(HostApiTable* api, int size)
+        {
+            if (api == null || size != sizeof(HostApiTable) || api->Version != HostApiTable.CurrentVersion)
+                return 1;
+            s_Api = api;
+            return 0;
+        }
+
+        public static void Log(HostLogPriority priority, string message)
+        {
+            var length = Encoding.UTF8.GetMaxByteCount(message.Length) + 1;
+            Span<byte> buffer = length <= 1024 ? stackalloc byte[length] : new byte[length];
+            buffer[Encoding.UTF8.GetBytes(message, buffer)] = 0;
+            fixed (byte* text = buffer)
+                s_Api->Log((int)priority, text);
+        }
+
+        public static void Log(string message) => Log(HostLogPriority.Info, message);
+
+        [MethodImpl(MethodImplOptions.AggressiveInlining)]
+        public static double TimeInSeconds() => s_Api->TimeInSeconds();
+
+        // Runs function(argument) on a host worker thread. Returns 0 when the queue was full and it already ran here.
+        public static long SubmitJob(delegate* unmanaged<IntPtr, void> function, IntPtr argument) => s_Api->SubmitJob(function, argument);
+
+        public static void WaitJob(long job) => s_Api->WaitJob(job);
+
+        public static void SubmitLayer(HostLayer layer) => s_Api->SubmitLayer((int)layer);
+
+        public static HostFrameStats GetFrameStats()
+        {
+            HostFrameStats stats;
+            s_Api->GetFrameStats(&stats);
+            return stats;
+        }
+
+        // Transforms count points, one array per component, by a row major 3x4 matrix; the outputs may be the inputs.
+        // Large batches are split over the host workers, so never call this from a job.
+        public static void TransformPoints(float* matrix, float* x, float* y, float* z, float* outX, float* outY, float* outZ, int count) =>
+            s_Api->TransformPoints(matrix, x, y, z, outX, outY, outZ, count);
+
+        // output[i] = parents[i] * locals[i] over count row major 3x4 matrices, split like TransformPoints.
+        public static void ConcatTransforms(float* output, float* parents, float* locals, int count) =>
+            s_Api->ConcatTransforms(output, parents, locals, count);
+
+        // output[i] = from[i] blended toward to[i] by weights[i] along the shorter arc, over count x, y, z, w quaternions;
+        // output may be from or to. Split like TransformPoints.
+        public static void BlendQuaternions(float* output, float* from, float* to, float* weights, int count, QuaternionBlend mode) =>
+            s_Api->BlendQuaternions(output, from, to, weights, count, (int)mode);
+
+        // Packs count floats to half floats, rounded to nearest even, for GL_HALF_FLOAT vertex attributes.
+        // Runs on the caller, the conversion is bound by memory rather than arithmetic.
+        public static void FloatToHalf(ushort* output, float* values, int count) => s_Api->FloatToHalf(output, values, count);
+
+        public static void HalfToFloat(float* output, ushort* values, int count) => s_Api->HalfToFloat(output, values, count);
+
+        // Writes the indices of the boxes, x, y, z mins and maxs, that the view can see this frame to visible, in increasing
+        // order, and returns how many. visible must hold count entries. Split like TransformPoints.
+        public static int CullBoxes(CullView view, float* mins, float* maxs, int count, int* visible) =>
+            s_Api->CullBoxes((int)view, mins, maxs, count, visible);
+
+        // As CullBoxes, for spheres stored as x, y, z, radius.
+        public static int CullSpheres(CullView view, float* spheres, int count, int* visible) =>
+            s_Api->CullSpheres((int)view, spheres, count, visible);
+
+        // The device's pose at a display time, from the poses the host records every frame: interpolated between frames
+        // up to about a second back, extrapolated from its velocities at most 0.1 s past the newest frame. False for times
+        // older than that, with the oldest pose kept. Needs no VrApi call and is safe from any thread.
+        public static bool GetPose(PoseDevice device, double time, out HostPose pose)
+        {
+            HostPose result;
+            var inHistory = s_Api->GetPose((int)device, time, &result) != 0;
+            pose = result;
+            return inHistory;
+        }
+
+        // Loads a KTX2 file of ETC2 or ASTC levels, relative to /sdcard/DotQuest, and returns its texture handle for draw
+        // commands, -1 if it cannot be loaded. The coarse levels are there at once and the finer ones stream in over the
+        // next frames. Only from initialize or a frame, the levels are uploaded on the frame thread's context.
+        public static int LoadTexture(string path)
+        {
+            var length = Encoding.UTF8.GetMaxByteCount(path.Length) + 1;
+            Span<byte> buffer = length <= 1024 ? stackalloc byte[length] : new byte[length];
+            buffer[Encoding.UTF8.GetBytes(path, buffer)] = 0;
+            fixed (byte* text = buffer)
+                return s_Api->LoadTexture(text);
+        }
+
+        // Copies width x height RGBA8 pixels, first row at the bottom as GL reads them, and queues them for the host's
+        // upload thread. Returns the texture handle for draw commands at once, -1 when the queue or the handles are full;
+        // the handle draws white until the upload has finished, usually a frame or two later. Only from initialize or a frame.
+        public static int UploadTexture(int width, int height, ReadOnlySpan<byte> pixels)
+        {
+            if (width <= 0 || height <= 0 || pixels.Length < (long)width * height * 4)
+                throw new ArgumentException($"{pixels.Length} bytes is not {width}x{height} RGBA8 pixels", nameof(pixels));
+            fixed (byte* data = pixels)
+                return s_Api->UploadTexture(width, height, data);
+        }
+
+        // --apibench: the cost of one call through the table next to the same native function through P/Invoke.
+        [DllImport("DotQuest", EntryPoint = "dotquest_time_in_seconds")]
+        static extern double PInvokeTimeInSeconds();
+
+        [DllImport("DotQuest", EntryPoint = "dotquest_time_in_seconds"), SuppressGCTransition]
+        static extern double PInvokeTimeInSecondsNoTransition();
+
+        public static void Benchmark()
+        {
+            Log($"Host api: function pointer {Measure(TableCalls):F1} ns per call");
+            try
+            {
+                Log($"Host api: P/Invoke {Measure(PInvokeCalls):F1} ns per call, " +
+                    $"P/Invoke without GC transition {Measure(PInvokeNoTransitionCalls):F1} ns per call");
+            }
+            catch (DllNotFoundException e)
+            {
+                Log(HostLogPriority.Warn, $"Host api: P/Invoke baseline unavailable: {e.Message}");
+            }
+        }
+
+        const int BenchmarkCalls = 1000000;
+
+        // the first run warms up and tiers the loop, the second one is timed
+        static double Measure(Func<double> calls)
+        {
+            calls();
+            var stopwatch = Stopwatch.StartNew();
+            calls();
+            return stopwatch.Elapsed.TotalMilliseconds * 1000000.0 / BenchmarkCalls;
+        }
+
+        static double TableCalls()
+        {
+            var timeInSeconds = s_Api->TimeInSeconds;
+            var sum = 0.0;
+            for (var i = 0; i < BenchmarkCalls; i++)
+                sum += timeInSeconds();
+            return sum;
+        }
+
+        static double PInvokeCalls()
+        {
+            var sum = 0.0;
+            for (var i = 0; i < BenchmarkCalls; i++)
+                sum += PInvokeTimeInSeconds();
+            return sum;
+        }
+
+        static double PInvokeNoTransitionCalls()
+        {
+            var sum = 0.0;
+            for (var i = 0; i < BenchmarkCalls; i++)
+                sum += PInvokeTimeInSecondsNoTransition();
+            return sum;
+        }
+    }
+}
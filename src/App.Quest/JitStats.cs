@@ -0,0 +1,56 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Diagnostics.Tracing;
+
+namespace GameEstate.App.Quest
+{
+    // Counts the methods compiled by the JIT and the time spent compiling them. net5.0 has no JitInfo, so this
+    // listens to the runtime's own JIT events; it is only enabled with --jitstats since the listener is not free.
+    public sealed class JitStats : EventListener
+    {
+        const EventKeywords JitKeyword = (EventKeywords)0x10;
+        const int MethodLoadVerbose = 143;
+        const int MethodJittingStarted = 145;
+
+        static JitStats s_Listener;
+        static long s_MethodCount;
+        static long s_Ticks;
+
+        readonly object _lock = new object();
+        readonly Dictionary<ulong, DateTime> _started = new Dictionary<ulong, DateTime>();
+
+        public static bool Enabled => s_Listener != null;
+        public static long MethodCount => s_MethodCount;
+        public static TimeSpan Time => TimeSpan.FromTicks(s_Ticks);
+
+        public static void Enable()
+        {
+            if (s_Listener == null)
+                s_Listener = new JitStats();
+        }
+
+        protected override void OnEventSourceCreated(EventSource eventSource)
+        {
+            if (eventSource.Name == "Microsoft-Windows-DotNETRuntime")
+                EnableEvents(eventSource, EventLevel.Verbose, JitKeyword);
+        }
+
+        protected override void OnEventWritten(EventWrittenEventArgs e)
+        {
+            if (e.EventId != MethodJittingStarted && e.EventId != MethodLoadVerbose)
+                return;
+            var methodId = Convert.ToUInt64(e.Payload[0]);
+            lock (_lock)
+            {
+                if (e.EventId == MethodJittingStarted)
+                    _started[methodId] = e.TimeStamp;
+                else if (_started.TryGetValue(methodId, out var started))
+                {
+                    _started.Remove(methodId);
+                    s_MethodCount++;
+                    s_Ticks += (e.TimeStamp - started).Ticks;
+                }
+            }
+        }
+    }
+}
@@ -38,6 +38,63 @@ namespace GameEstate.App.Quest
         {
             CustomEntryPoint(libArgs);
         }
+
+        // Entry points resolved once by the native host, see DotNetHost.h
+        [UnmanagedCallersOnly]
+        public static int Initialize(int argc, IntPtr argv)
+        {
+            var args = new string[argc];
+            for (var i = 0; i < argc; i++)
+                args[i] = Marshal.PtrToStringUTF8(Marshal.ReadIntPtr(argv, i * IntPtr.Size));
+            if (Array.IndexOf(args, "--jitstats") >= 0)
+                JitStats.Enable();
+            DrawBench.Enable(args);
+            if (Host.Attached && Array.IndexOf(args, "--apibench") >= 0)
+                Host.Benchmark();
+            FrameGC.Configure();
+            AppLoader.Initialize(args);
+            Console.WriteLine($"Initialize: {string.Join(" ", args)}");
+            return 0;
+        }
+
+        [UnmanagedCallersOnly]
+        public static int Frame(long frameIndex, double displayTime)
+        {
+            CommandBuffer.Reset();
+            DrawBench.Frame(displayTime);
+            AppLoader.Current?.Frame(frameIndex, displayTime);
+            return CommandBuffer.Length;
+        }
+
+        [UnmanagedCallersOnly]
+        public static void Shutdown()
+        {
+            AppLoader.Shutdown();
+            Console.WriteLine("Shutdown");
+        }
+
+        [UnmanagedCallersOnly]
+        public static int Reload() => AppLoader.Reload();
+
+        [UnmanagedCallersOnly]
+        public static unsafe int AttachHostApi(HostApiTable* api, int size) => Host.Attach(api, size);
+
+        [UnmanagedCallersOnly]
+        public static unsafe int AttachFrameData(FrameData* data, int size) => FrameChannel.Attach(data, size);
+
+        [UnmanagedCallersOnly]
+        public static unsafe int AttachCommandBuffer(byte* data, int capacity) => CommandBuffer.Attach(data, capacity);
+
+        [UnmanagedCallersOnly]
+        public static unsafe int SafePoint(long frameIndex, GCPause* pause) => FrameGC.OnSafePoint(frameIndex, pause);
+
+        [UnmanagedCallersOnly]
+        public static unsafe int GetJitStats(long* methodCount, double* milliseconds)
+        {
+            *methodCount = JitStats.MethodCount;
+            *milliseconds = JitStats.Time.TotalMilliseconds;
+            return JitStats.Enabled ? 1 : 0;
+        }
 #endif
 
         static void PrintLibArgs(LibArgs libArgs)
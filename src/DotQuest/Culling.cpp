@@ -0,0 +1,244 @@
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "Culling.h"
+
+/*
+================================================================================
+ovrFrustum
+================================================================================
+*/
+
+void ovrFrustum_FromMatrix(ovrFrustum* frustum, const ovrMatrix4f* viewProjection) {
+	// clip space x, y and z each between -w and w: w + x, w - x, w + y, ...
+	for (int axis = 0; axis < 3; axis++)
+		for (int side = 0; side < 2; side++) {
+			float* plane = frustum->Planes[axis * 2 + side];
+			const float sign = side ? -1.0f : 1.0f;
+			for (int j = 0; j < 4; j++)
+				plane[j] = viewProjection->M[3][j] + sign * viewProjection->M[axis][j];
+			const float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			// the far plane of an infinite projection has no normal, it takes everything in
+			if (length < 1e-6f)
+				Math_Vector4Set(plane, 0.0f, 0.0f, 0.0f, 1.0f);
+			else
+				Math_Vector4Set(plane, plane[0] / length, plane[1] / length, plane[2] / length, plane[3] / length);
+		}
+}
+
+void ovrFrustum_FromTracking(ovrFrustum frustums[CULL_VIEWS], const ovrTracking2* tracking, const ovrMatrix4f* projection) {
+	for (int eye = 0; eye < VRAPI_FRAME_LAYER_EYE_MAX; eye++) {
+		const ovrMatrix4f viewProjection = ovrMatrix4f_Multiply(projection, &tracking->Eye[eye].ViewMatrix);
+		ovrFrustum_FromMatrix(&frustums[CULL_LEFT + eye], &viewProjection);
+	}
+	ovrFrustum* stereo = &frustums[CULL_STEREO];
+	Math_Vector4Cpy(frustums[CULL_LEFT].Planes[0], stereo->Planes[0]);
+	Math_Vector4Cpy(frustums[CULL_RIGHT].Planes[1], stereo->Planes[1]);
+	// the other planes face the same way in both eyes, the looser of the two keeps whatever either eye sees
+	for (int p = 2; p < 6; p++) {
+		const float* left = frustums[CULL_LEFT].Planes[p];
+		const float* right = frustums[CULL_RIGHT].Planes[p];
+		Math_Vector4Cpy(left[3] >= right[3] ? left : right, stereo->Planes[p]);
+	}
+}
+
+bool ovrFrustum_BoxVisible(const ovrFrustum* frustum, const vec3_t mins, const vec3_t maxs) {
+	for (int p = 0; p < 6; p++) {
+		const float* plane = frustum->Planes[p];
+		// the distance of the corner furthest along the normal, from the center and half extents
+		float distance = plane[3];
+		for (int j = 0; j < 3; j++)
+			distance += plane[j] * (mins[j] + maxs[j]) * 0.5f + fabsf(plane[j]) * (maxs[j] - mins[j]) * 0.5f;
+		if (distance < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+bool ovrFrustum_SphereVisible(const ovrFrustum* frustum, const vec3_t origin, float radius) {
+	for (int p = 0; p < 6; p++) {
+		const float* plane = frustum->Planes[p];
+		if (Math_DotProduct(plane, origin) + plane[3] + radius < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+#if MATH_SIMD
+// the planes splatted across the lanes, with the normals' magnitudes for the box extents
+typedef struct {
+	simd4f					X[6];
+	simd4f					Y[6];
+	simd4f					Z[6];
+	simd4f					W[6];
+	simd4f					AbsX[6];
+	simd4f					AbsY[6];
+	simd4f					AbsZ[6];
+} ovrFrustumLanes;
+
+static void ovrFrustumLanes_Set(ovrFrustumLanes* lanes, const ovrFrustum* frustum) {
+	for (int p = 0; p < 6; p++) {
+		const float* plane = frustum->Planes[p];
+		lanes->X[p] = Simd_Splat(plane[0]);
+		lanes->Y[p] = Simd_Splat(plane[1]);
+		lanes->Z[p] = Simd_Splat(plane[2]);
+		lanes->W[p] = Simd_Splat(plane[3]);
+		lanes->AbsX[p] = Simd_Splat(fabsf(plane[0]));
+		lanes->AbsY[p] = Simd_Splat(fabsf(plane[1]));
+		lanes->AbsZ[p] = Simd_Splat(fabsf(plane[2]));
+	}
+}
+
+// Appends first + lane for the lanes not set in outside, without a branch per lane.
+static inline int ovrFrustum_Append(int* visible, int n, int first, int outside) {
+	for (int lane = 0; lane < 4; lane++) {
+		visible[n] = first + lane;
+		n += !((outside >> lane) & 1);
+	}
+	return n;
+}
+#endif
+
+// Visible indices in [start, end), written from visible[0].
+static int ovrFrustum_CullBoxRange(const ovrFrustum* frustum, const vec3_t* mins, const vec3_t* maxs, int start, int end, int* visible) {
+	int n = 0;
+	int i = start;
+#if MATH_SIMD
+	ovrFrustumLanes lanes;
+	ovrFrustumLanes_Set(&lanes, frustum);
+	const simd4f zero = Simd_Splat(0.0f);
+	const simd4f half = Simd_Splat(0.5f);
+	for (; i + 4 <= end; i += 4) {
+		simd4f minX = Simd_Load3(mins[i], 0.0f), minY = Simd_Load3(mins[i + 1], 0.0f), minZ = Simd_Load3(mins[i + 2], 0.0f), minW = Simd_Load3(mins[i + 3], 0.0f);
+		simd4f maxX = Simd_Load3(maxs[i], 0.0f), maxY = Simd_Load3(maxs[i + 1], 0.0f), maxZ = Simd_Load3(maxs[i + 2], 0.0f), maxW = Simd_Load3(maxs[i + 3], 0.0f);
+		Simd_Transpose(&minX, &minY, &minZ, &minW);
+		Simd_Transpose(&maxX, &maxY, &maxZ, &maxW);
+		const simd4f centerX = Simd_Mul(Simd_Add(minX, maxX), half), extentX = Simd_Mul(Simd_Sub(maxX, minX), half);
+		const simd4f centerY = Simd_Mul(Simd_Add(minY, maxY), half), extentY = Simd_Mul(Simd_Sub(maxY, minY), half);
+		const simd4f centerZ = Simd_Mul(Simd_Add(minZ, maxZ), half), extentZ = Simd_Mul(Simd_Sub(maxZ, minZ), half);
+		simd4f outside = zero;
+		for (int p = 0; p < 6; p++) {
+			simd4f distance = Simd_MulAdd(lanes.W[p], lanes.X[p], centerX);
+			distance = Simd_MulAdd(distance, lanes.Y[p], centerY);
+			distance = Simd_MulAdd(distance, lanes.Z[p], centerZ);
+			distance = Simd_MulAdd(distance, lanes.AbsX[p], extentX);
+			distance = Simd_MulAdd(distance, lanes.AbsY[p], extentY);
+			distance = Simd_MulAdd(distance, lanes.AbsZ[p], extentZ);
+			outside = Simd_Or(outside, Simd_Greater(zero, distance));
+		}
+		n = ovrFrustum_Append(visible, n, i, Simd_Bits(outside));
+	}
+#endif
+	for (; i < end; i++)
+		if (ovrFrustum_BoxVisible(frustum, mins[i], maxs[i]))
+			visible[n++] = i;
+	return n;
+}
+
+static int ovrFrustum_CullSphereRange(const ovrFrustum* frustum, const vec4_t* spheres, int start, int end, int* visible) {
+	int n = 0;
+	int i = start;
+#if MATH_SIMD
+	ovrFrustumLanes lanes;
+	ovrFrustumLanes_Set(&lanes, frustum);
+	const simd4f zero = Simd_Splat(0.0f);
+	for (; i + 4 <= end; i += 4) {
+		simd4f x = Simd_Load(spheres[i]), y = Simd_Load(spheres[i + 1]), z = Simd_Load(spheres[i + 2]), radius = Simd_Load(spheres[i + 3]);
+		Simd_Transpose(&x, &y, &z, &radius);
+		simd4f outside = zero;
+		for (int p = 0; p < 6; p++) {
+			simd4f distance = Simd_MulAdd(Simd_Add(lanes.W[p], radius), lanes.X[p], x);
+			distance = Simd_MulAdd(distance, lanes.Y[p], y);
+			distance = Simd_MulAdd(distance, lanes.Z[p], z);
+			outside = Simd_Or(outside, Simd_Greater(zero, distance));
+		}
+		n = ovrFrustum_Append(visible, n, i, Simd_Bits(outside));
+	}
+#endif
+	for (; i < end; i++)
+		if (ovrFrustum_SphereVisible(frustum, spheres[i], spheres[i][3]))
+			visible[n++] = i;
+	return n;
+}
+
+int ovrFrustum_CullBoxes(const ovrFrustum* frustum, const vec3_t* mins, const vec3_t* maxs, int count, int* visible) {
+	return ovrFrustum_CullBoxRange(frustum, mins, maxs, 0, count, visible);
+}
+
+int ovrFrustum_CullSpheres(const ovrFrustum* frustum, const vec4_t* spheres, int count, int* visible) {
+	return ovrFrustum_CullSphereRange(frustum, spheres, 0, count, visible);
+}
+
+/*
+================================================================================
+Parallel culling
+================================================================================
+*/
+
+typedef struct {
+	const ovrFrustum*		Frustum;
+	const vec3_t*			Mins;
+	const vec3_t*			Maxs;
+	const vec4_t*			Spheres;
+	int*					Visible;
+	// each chunk writes its list at its own start and records it here, in whatever order the chunks finish
+	int						Starts[JOB_WORKERS + 1];
+	int						Counts[JOB_WORKERS + 1];
+	int						Chunks;
+} ovrCullBatch;
+
+static void ovrCullBatch_Record(const void* batch, int start, int count) {
+	ovrCullBatch* cull = (ovrCullBatch*)batch;
+	const int chunk = __atomic_fetch_add(&cull->Chunks, 1, __ATOMIC_RELAXED);
+	cull->Starts[chunk] = start;
+	cull->Counts[chunk] = count;
+}
+
+// Moves the chunk lists together in start order; returns the total.
+static int ovrCullBatch_Compact(ovrCullBatch* cull) {
+	int total = 0;
+	for (int i = 0; i < cull->Chunks; i++) {
+		int first = i;
+		for (int j = i + 1; j < cull->Chunks; j++)
+			if (cull->Starts[j] < cull->Starts[first])
+				first = j;
+		const int start = cull->Starts[first], count = cull->Counts[first];
+		cull->Starts[first] = cull->Starts[i];
+		cull->Counts[first] = cull->Counts[i];
+		if (total != start)
+			memmove(cull->Visible + total, cull->Visible + start, count * sizeof(int));
+		total += count;
+	}
+	return total;
+}
+
+static void ovrJobQueue_CullBoxesChunk(const void* batch, int start, int count) {
+	const ovrCullBatch* cull = (const ovrCullBatch*)batch;
+	ovrCullBatch_Record(batch, start, ovrFrustum_CullBoxRange(cull->Frustum, cull->Mins, cull->Maxs, start, start + count, cull->Visible + start));
+}
+
+static void ovrJobQueue_CullSpheresChunk(const void* batch, int start, int count) {
+	const ovrCullBatch* cull = (const ovrCullBatch*)batch;
+	ovrCullBatch_Record(batch, start, ovrFrustum_CullSphereRange(cull->Frustum, cull->Spheres, start, start + count, cull->Visible + start));
+}
+
+int ovrJobQueue_CullBoxes(ovrJobQueue* queue, const ovrFrustum* frustum, const vec3_t* mins, const vec3_t* maxs, int count, int* visible) {
+	ovrCullBatch cull;
+	memset(&cull, 0, sizeof(cull));
+	cull.Frustum = frustum;
+	cull.Mins = mins;
+	cull.Maxs = maxs;
+	cull.Visible = visible;
+	ovrJobQueue_Split(queue, count, CULL_JOB_MIN_BOUNDS, ovrJobQueue_CullBoxesChunk, &cull);
+	return ovrCullBatch_Compact(&cull);
+}
+
+int ovrJobQueue_CullSpheres(ovrJobQueue* queue, const ovrFrustum* frustum, const vec4_t* spheres, int count, int* visible) {
+	ovrCullBatch cull;
+	memset(&cull, 0, sizeof(cull));
+	cull.Frustum = frustum;
+	cull.Spheres = spheres;
+	cull.Visible = visible;
+	ovrJobQueue_Split(queue, count, CULL_JOB_MIN_BOUNDS, ovrJobQueue_CullSpheresChunk, &cull);
+	return ovrCullBatch_Compact(&cull);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "VrApi.h"
+#include "HostApi.h"
+
+/*
+================================================================================
+ovrFrustum
+
+Six planes taken from a view projection matrix (Gribb and Hartmann), each
+normalized so that dot(normal, point) + w is the distance of the point, positive
+inside. Bounds are tested four at a time against all six planes, and the
+indices of those at least partly inside are written in order to a compact
+visibility list, so a renderer can skip everything off screen before building
+its draws.
+================================================================================
+*/
+
+enum {
+	CULL_LEFT,
+	CULL_RIGHT,
+	CULL_STEREO,			// both eyes at once
+	CULL_VIEWS
+};
+
+typedef struct {
+	vec4_t					Planes[6];				// left, right, bottom, top, near, far
+} ovrFrustum;
+
+void ovrFrustum_FromMatrix(ovrFrustum* frustum, const ovrMatrix4f* viewProjection);
+// The eye frustums for the projection the frame is rendered with, and one around both. The stereo frustum takes
+// its side planes from the outer eyes, which holds while the eyes only differ by a sideways offset, as on Quest.
+void ovrFrustum_FromTracking(ovrFrustum frustums[CULL_VIEWS], const ovrTracking2* tracking, const ovrMatrix4f* projection);
+
+bool ovrFrustum_BoxVisible(const ovrFrustum* frustum, const vec3_t mins, const vec3_t maxs);
+bool ovrFrustum_SphereVisible(const ovrFrustum* frustum, const vec3_t origin, float radius);
+// Write the indices of the visible boxes or spheres (x, y, z, radius) to visible, which must hold count
+// entries, in increasing order. Return how many were written.
+int ovrFrustum_CullBoxes(const ovrFrustum* frustum, const vec3_t* mins, const vec3_t* maxs, int count, int* visible);
+int ovrFrustum_CullSpheres(const ovrFrustum* frustum, const vec4_t* spheres, int count, int* visible);
+
+// Split over the job queue like the batch math, with the same rule against calling them from a job.
+#define CULL_JOB_MIN_BOUNDS		8192
+
+int ovrJobQueue_CullBoxes(ovrJobQueue* queue, const ovrFrustum* frustum, const vec3_t* mins, const vec3_t* maxs, int count, int* visible);
+int ovrJobQueue_CullSpheres(ovrJobQueue* queue, const ovrFrustum* frustum, const vec4_t* spheres, int count, int* visible);
@@ -2,12 +2,19 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
-#include <iostream>
+#include <stddef.h>
+#include <string>
+#include <atomic>
+#include <time.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
 
 #include "nethost.h"
 #include "coreclr_delegates.h"
 #include "hostfxr.h"
+#include "DotNetHost.h"
 
 #include <dlfcn.h>
 #include <limits.h>
@@ -16,16 +23,6 @@
 #define DIR_SEPARATOR '/'
 #define MAX_PATH PATH_MAX
 
-#define ALOG_TAG "GAMETAG"
-#define ALOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, ALOG_TAG, __VA_ARGS__))
-#define ALOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, ALOG_TAG, __VA_ARGS__))
-#define ALOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, ALOG_TAG, __VA_ARGS__))
-#if _DEBUG
-#define LOGV(...) ((void)__android_log_print(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__))
-#else
-#define ALOGV(...)
-#endif
-
 using string_t = std::basic_string<char_t>;
 
 namespace
@@ -34,94 +31,374 @@ namespace
     hostfxr_initialize_for_runtime_config_fn init_fptr;
     hostfxr_get_runtime_delegate_fn get_delegate_fptr;
     hostfxr_close_fn close_fptr;
+    hostfxr_get_runtime_property_value_fn get_property_fptr;
+    hostfxr_set_runtime_property_value_fn set_property_fptr;
+
+    const int max_plugins = 16;
+
+    enum plugin_state
+    {
+        plugin_pending,
+        plugin_done,
+        plugin_failed,
+    };
+
+    // A plugin from main.cfg, its Initialize runs on its own thread once the plugins it comes after are done
+    struct dotnet_plugin
+    {
+        string_t name;
+        string_t assembly_path;     // relative to the root path
+        string_t type_name;         // assembly qualified
+        bool deferred;
+        int after[max_plugins];
+        int after_count;
+        pthread_t thread;
+        plugin_state state;
+        double seconds;
+    };
+
+    // Everything the host keeps between calls
+    struct dotnet_host
+    {
+        bool started;
+        load_assembly_and_get_function_pointer_fn load_assembly_and_get_function_pointer;
+        string_t assembly_path;
+        dotnet_entry_points entry;
+        dotnet_startup_times startup;
+        // asynchronous start
+        string_t root_path;
+        pthread_t thread;
+        std::atomic<bool> ready;
+        // assembly watch
+        string_t watch_path;
+        pthread_t watch_thread;
+        std::atomic<bool> changed;
+        std::atomic<double> changed_time;
+        // plugins, state changes are signalled on plugin_cond
+        dotnet_plugin plugins[max_plugins];
+        int plugin_count;
+        bool deferred_started;
+    } host;
+
+    pthread_mutex_t plugin_mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t plugin_cond = PTHREAD_COND_INITIALIZER;
+
+    const char_t *app_type = STR("GameEstate.App.Quest.Lib, App.Quest");
+
+    // Methods resolved into the entry point table at startup
+    const struct
+    {
+        const char_t *method_name;
+        size_t offset;
+    } entry_point_table[] =
+    {
+        { STR("Initialize"), offsetof(dotnet_entry_points, initialize) },
+        { STR("AttachHostApi"), offsetof(dotnet_entry_points, attach_host_api) },
+        { STR("Frame"), offsetof(dotnet_entry_points, frame) },
+        { STR("Shutdown"), offsetof(dotnet_entry_points, shutdown) },
+        { STR("Reload"), offsetof(dotnet_entry_points, reload) },
+        { STR("AttachFrameData"), offsetof(dotnet_entry_points, attach_frame_data) },
+        { STR("GetJitStats"), offsetof(dotnet_entry_points, get_jit_stats) },
+        { STR("AttachCommandBuffer"), offsetof(dotnet_entry_points, attach_command_buffer) },
+        { STR("SafePoint"), offsetof(dotnet_entry_points, safe_point) },
+    };
+
+    double now()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    void *start_thread(void *)
+    {
+        prctl(PR_SET_NAME, (long)"DQ::DotNet", 0, 0, 0);
+        dotnet_start(host.root_path.c_str());
+        host.ready = true;
+        return nullptr;
+    }
+
+    void *plugin_thread(void *parm)
+    {
+        prctl(PR_SET_NAME, (long)"DQ::Plugin", 0, 0, 0);
+        dotnet_plugin *plugin = (dotnet_plugin *)parm;
+
+        // dependencies always come from the same phase or an earlier one, so they are running or finished
+        bool ready = true;
+        pthread_mutex_lock(&plugin_mutex);
+        for (int i = 0; i < plugin->after_count; i++)
+        {
+            while (host.plugins[plugin->after[i]].state == plugin_pending)
+                pthread_cond_wait(&plugin_cond, &plugin_mutex);
+            ready &= host.plugins[plugin->after[i]].state == plugin_done;
+        }
+        pthread_mutex_unlock(&plugin_mutex);
+
+        plugin_state state = plugin_failed;
+        const double start = now();
+        if (!ready)
+            ALOGE("dotnet: plugin %s skipped, a plugin it comes after failed", plugin->name.c_str());
+        else
+        {
+            const string_t assembly_path = host.root_path + plugin->assembly_path;
+            int (CORECLR_DELEGATE_CALLTYPE *initialize)() = nullptr;
+            const int rc = host.load_assembly_and_get_function_pointer(
+                assembly_path.c_str(),
+                plugin->type_name.c_str(),
+                STR("Initialize"),
+                UNMANAGEDCALLERSONLY_METHOD,
+                nullptr,
+                (void **)&initialize);
+            if (rc != 0 || initialize == nullptr)
+                ALOGE("dotnet: unable to load plugin %s from %s: 0x%x", plugin->name.c_str(), assembly_path.c_str(), rc);
+            else if (const int result = initialize())
+                ALOGE("dotnet: plugin %s failed to initialize: %d", plugin->name.c_str(), result);
+            else
+                state = plugin_done;
+        }
+
+        pthread_mutex_lock(&plugin_mutex);
+        plugin->seconds = now() - start;
+        plugin->state = state;
+        pthread_cond_broadcast(&plugin_cond);
+        pthread_mutex_unlock(&plugin_mutex);
+        return nullptr;
+    }
+
+    // Starts every plugin of a phase at once and waits for all of them.
+    double run_plugins(bool deferred)
+    {
+        const double start = now();
+        int count = 0;
+        int failed = 0;
+        double longest = 0.0;
+        for (int i = 0; i < host.plugin_count; i++)
+        {
+            dotnet_plugin *plugin = &host.plugins[i];
+            if (plugin->deferred != deferred)
+                continue;
+            const int rc = pthread_create(&plugin->thread, nullptr, plugin_thread, plugin);
+            if (rc != 0)
+            {
+                ALOGE("pthread_create returned %i", rc);
+                pthread_mutex_lock(&plugin_mutex);
+                plugin->thread = 0;
+                plugin->state = plugin_failed;
+                pthread_cond_broadcast(&plugin_cond);
+                pthread_mutex_unlock(&plugin_mutex);
+            }
+        }
+        for (int i = 0; i < host.plugin_count; i++)
+        {
+            dotnet_plugin *plugin = &host.plugins[i];
+            if (plugin->deferred != deferred)
+                continue;
+            if (plugin->thread)
+                pthread_join(plugin->thread, nullptr);
+            ALOGV("dotnet: plugin %s %s in %.1f ms", plugin->name.c_str(), plugin->state == plugin_done ? "initialized" : "failed", plugin->seconds * 1000.0);
+            count++;
+            failed += plugin->state != plugin_done;
+            if (longest < plugin->seconds)
+                longest = plugin->seconds;
+        }
+        const double seconds = now() - start;
+        if (count)
+            ALOGI("dotnet: %d %s plugins in %.1f ms, longest %.1f ms, %d failed", count, deferred ? "deferred" : "startup",
+                seconds * 1000.0, longest * 1000.0, failed);
+        return seconds;
+    }
+
+    void *deferred_plugins_thread(void *)
+    {
+        prctl(PR_SET_NAME, (long)"DQ::Plugins", 0, 0, 0);
+        run_plugins(true);
+        return nullptr;
+    }
+
+    void *watch_thread(void *)
+    {
+        prctl(PR_SET_NAME, (long)"DQ::DotNetWatch", 0, 0, 0);
+        const int fd = inotify_init();
+        if (fd < 0 || inotify_add_watch(fd, host.watch_path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        {
+            ALOGE("dotnet: unable to watch %s", host.watch_path.c_str());
+            if (fd >= 0)
+                close(fd);
+            return nullptr;
+        }
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        for (;;)
+        {
+            const ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+            for (ssize_t offset = 0; offset < length; )
+            {
+                const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+                offset += sizeof(struct inotify_event) + event->len;
+                const size_t name_length = event->len ? strlen(event->name) : 0;
+                if (name_length < 4 || (strcmp(event->name + name_length - 4, ".dll") != 0 && strcmp(event->name + name_length - 4, ".pdb") != 0))
+                    continue;
+                // the host assembly is loaded for good, only the app assembly it loads can be swapped
+                if (strcmp(event->name, "App.Quest.dll") == 0)
+                {
+                    ALOGE("dotnet: App.Quest.dll changed, restart to pick it up");
+                    continue;
+                }
+                ALOGV("dotnet: %s changed", event->name);
+                host.changed_time = now();
+                host.changed = true;
+            }
+        }
+        close(fd);
+        return nullptr;
+    }
 
     // Forward declarations
     bool load_hostfxr();
-    load_assembly_and_get_function_pointer_fn get_dotnet_load_assembly(const char_t *assembly);
+    load_assembly_and_get_function_pointer_fn get_dotnet_load_assembly(const char_t *assembly, const char_t *app_config);
 }
 
-int dotnet(int argc, char *argv[])
+bool dotnet_start(const char_t *root_path)
 {
+    if (host.started)
+        return true;
     ALOGV("DOTNET");
-    // Get the current executable's directory
-    // This sample assumes the managed assembly to load and its runtime configuration file are next to the host
-    char_t host_path[MAX_PATH];
-    auto resolved = realpath(argv[0], host_path);
-    assert(resolved != nullptr);
-
-    string_t root_path = host_path;
-    auto pos = root_path.find_last_of(DIR_SEPARATOR);
-    assert(pos != string_t::npos);
-    root_path = root_path.substr(0, pos + 1);
 
     // STEP 1: Load HostFxr and get exported hosting functions
-    if (!load_hostfxr())
+    double start = now();
+    if (!init_fptr && !load_hostfxr())
     {
-        assert(false && "Failure: load_hostfxr()");
-        return EXIT_FAILURE;
+        ALOGE("dotnet: unable to load hostfxr");
+        return false;
     }
+    host.startup.load_hostfxr = now() - start;
 
     // STEP 2: Initialize and start the .NET Core runtime
-    const string_t config_path = root_path + STR("net5.0\\DotNetLib.runtimeconfig.json");
-    load_assembly_and_get_function_pointer_fn load_assembly_and_get_function_pointer = nullptr;
-    load_assembly_and_get_function_pointer = get_dotnet_load_assembly(config_path.c_str());
-    assert(load_assembly_and_get_function_pointer != nullptr && "Failure: get_dotnet_load_assembly()");
-
-    // STEP 3: Load managed assembly and get function pointer to a managed method
-    const string_t dotnetlib_path = root_path + STR("net5.0\\DotNetLib.dll");
-    const char_t *dotnet_type = STR("DotNetLib.Lib, DotNetLib");
-    const char_t *dotnet_type_method = STR("Hello");
-    // <SnippetLoadAndGet>
-    // Function pointer to managed delegate
-    component_entry_point_fn hello = nullptr;
-    int rc = load_assembly_and_get_function_pointer(
-        dotnetlib_path.c_str(),
-        dotnet_type,
-        dotnet_type_method,
-        nullptr /*delegate_type_name*/,
-        nullptr,
-        (void**)&hello);
-    // </SnippetLoadAndGet>
-    assert(rc == 0 && hello != nullptr && "Failure: load_assembly_and_get_function_pointer()");
+    start = now();
+    const string_t config_path = string_t(root_path) + STR("App.Quest.runtimeconfig.json");
+    const string_t app_config_path = string_t(root_path) + STR("Main/main.cfg");
+    host.load_assembly_and_get_function_pointer = get_dotnet_load_assembly(config_path.c_str(), app_config_path.c_str());
+    if (host.load_assembly_and_get_function_pointer == nullptr)
+        return false;
+    host.startup.initialize_runtime = now() - start;
 
-    // STEP 4: Run managed code
-    struct lib_args
+    // STEP 3: Load the managed assembly and resolve every entry point once, the first one pays for the assembly load
+    start = now();
+    host.assembly_path = string_t(root_path) + STR("App.Quest.dll");
+    for (size_t i = 0; i < sizeof(entry_point_table) / sizeof(entry_point_table[0]); i++)
     {
-        const char_t *message;
-        int number;
-    };
-    for (int i = 0; i < 3; ++i)
-    {
-        // <SnippetCallManaged>
-        lib_args args
+        void *function = nullptr;
+        int rc = host.load_assembly_and_get_function_pointer(
+            host.assembly_path.c_str(),
+            app_type,
+            entry_point_table[i].method_name,
+            UNMANAGEDCALLERSONLY_METHOD,
+            nullptr,
+            &function);
+        if (rc != 0 || function == nullptr)
         {
-            STR("from host!"),
-            i
-        };
-        hello(&args, sizeof(args));
-        // </SnippetCallManaged>
+            ALOGE("dotnet: unable to resolve %s: 0x%x", entry_point_table[i].method_name, rc);
+            memset(&host.entry, 0, sizeof(host.entry));
+            return false;
+        }
+        *(void **)((char *)&host.entry + entry_point_table[i].offset) = function;
     }
+    host.startup.resolve_entry_points = now() - start;
+    host.started = true;
 
-    // Function pointer to managed delegate with non-default signature
-    typedef void (CORECLR_DELEGATE_CALLTYPE *custom_entry_point_fn)(lib_args args);
-    custom_entry_point_fn custom = nullptr;
-    rc = load_assembly_and_get_function_pointer(
-        dotnetlib_path.c_str(),
-        dotnet_type,
-        STR("CustomEntryPointUnmanaged") /*method_name*/,
-        UNMANAGEDCALLERSONLY_METHOD,
-        nullptr,
-        (void**)&custom);
-    assert(rc == 0 && custom != nullptr && "Failure: load_assembly_and_get_function_pointer()");
+    // STEP 4: Initialize the plugins the first frame needs, the others wait for dotnet_start_deferred_plugins
+    host.root_path = string_t(root_path);
+    host.startup.plugins = run_plugins(false);
+    return true;
+}
 
-    lib_args args
+bool dotnet_start_async(const char_t *root_path)
+{
+    if (host.thread)
+        return true;
+    host.root_path = root_path;
+    const int rc = pthread_create(&host.thread, nullptr, start_thread, nullptr);
+    if (rc != 0)
     {
-        STR("from host!"),
-        -1
-    };
-    custom(args);
+        ALOGE("pthread_create returned %i", rc);
+        host.thread = 0;
+        return false;
+    }
+    pthread_detach(host.thread);
+    return true;
+}
+
+bool dotnet_ready()
+{
+    return host.ready;
+}
+
+bool dotnet_watch(const char_t *root_path)
+{
+    if (host.watch_thread)
+        return true;
+    host.watch_path = root_path;
+    const int rc = pthread_create(&host.watch_thread, nullptr, watch_thread, nullptr);
+    if (rc != 0)
+    {
+        ALOGE("pthread_create returned %i", rc);
+        host.watch_thread = 0;
+        return false;
+    }
+    pthread_detach(host.watch_thread);
+    return true;
+}
+
+bool dotnet_reload_pending()
+{
+    if (!host.changed || now() - host.changed_time < 0.5)
+        return false;
+    host.changed = false;
+    return true;
+}
 
-    return EXIT_SUCCESS;
+bool dotnet_start_deferred_plugins()
+{
+    if (!host.started || host.deferred_started)
+        return false;
+    host.deferred_started = true;
+    pthread_t thread;
+    const int rc = pthread_create(&thread, nullptr, deferred_plugins_thread, nullptr);
+    if (rc != 0)
+    {
+        ALOGE("pthread_create returned %i", rc);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+const dotnet_startup_times *dotnet_startup()
+{
+    return &host.startup;
+}
+
+const dotnet_entry_points *dotnet_entry()
+{
+    return host.started ? &host.entry : nullptr;
+}
+
+void *dotnet_get_function(const char_t *type_name, const char_t *method_name)
+{
+    if (host.load_assembly_and_get_function_pointer == nullptr)
+        return nullptr;
+    void *function = nullptr;
+    int rc = host.load_assembly_and_get_function_pointer(
+        host.assembly_path.c_str(),
+        type_name,
+        method_name,
+        UNMANAGEDCALLERSONLY_METHOD,
+        nullptr,
+        &function);
+    if (rc != 0)
+        ALOGE("dotnet: unable to resolve %s: 0x%x", method_name, rc);
+    return rc == 0 ? function : nullptr;
 }
 
 /********************************************************************************************
@@ -137,13 +414,15 @@ namespace
     void *load_library(const char_t *path)
     {
         void *h = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
-        assert(h != nullptr);
+        if (h == nullptr)
+            ALOGE("dotnet: dlopen(%s) failed: %s", path, dlerror());
         return h;
     }
     void *get_export(void *h, const char *name)
     {
         void *f = dlsym(h, name);
-        assert(f != nullptr);
+        if (f == nullptr)
+            ALOGE("dotnet: missing export %s", name);
         return f;
     }
 
@@ -160,17 +439,158 @@ namespace
 
         // Load hostfxr and get desired exports
         void *lib = load_library(buffer);
+        if (lib == nullptr)
+            return false;
         init_fptr = (hostfxr_initialize_for_runtime_config_fn)get_export(lib, "hostfxr_initialize_for_runtime_config");
         get_delegate_fptr = (hostfxr_get_runtime_delegate_fn)get_export(lib, "hostfxr_get_runtime_delegate");
         close_fptr = (hostfxr_close_fn)get_export(lib, "hostfxr_close");
+        get_property_fptr = (hostfxr_get_runtime_property_value_fn)get_export(lib, "hostfxr_get_runtime_property_value");
+        set_property_fptr = (hostfxr_set_runtime_property_value_fn)get_export(lib, "hostfxr_set_runtime_property_value");
 
         return (init_fptr && get_delegate_fptr && close_fptr);
     }
     // </SnippetLoadHostFxr>
 
+    string_t trim(const char_t *s)
+    {
+        const char_t *end = s + strlen(s);
+        while (*s == CH(' ') || *s == CH('\t'))
+            s++;
+        while (end > s && (end[-1] == CH(' ') || end[-1] == CH('\t') || end[-1] == CH('\r') || end[-1] == CH('\n')))
+            end--;
+        return string_t(s, end);
+    }
+
+    int find_plugin(const string_t &name)
+    {
+        for (int i = 0; i < host.plugin_count; i++)
+            if (host.plugins[i].name == name)
+                return i;
+        return -1;
+    }
+
+    // A required plugin cannot wait for a deferred one, so whatever it comes after becomes required too.
+    void require_plugin(int index)
+    {
+        dotnet_plugin *plugin = &host.plugins[index];
+        if (plugin->deferred)
+            ALOGV("dotnet: plugin %s is needed at startup, no longer deferred", plugin->name.c_str());
+        plugin->deferred = false;
+        for (int i = 0; i < plugin->after_count; i++)
+            require_plugin(plugin->after[i]);
+    }
+
+    // plugin.<name> = <assembly> <type> [deferred] [after=<name>,...], the assembly relative to the root path and
+    // the plugins it comes after listed above it, which also rules out cycles.
+    void add_plugin(const string_t &name, const string_t &value)
+    {
+        if (host.plugin_count == max_plugins)
+        {
+            ALOGE("dotnet: more than %d plugins, %s ignored", max_plugins, name.c_str());
+            return;
+        }
+        dotnet_plugin *plugin = &host.plugins[host.plugin_count];
+        *plugin = dotnet_plugin();
+        plugin->name = name;
+        char_t buffer[512];
+        strncpy(buffer, value.c_str(), sizeof(buffer) - 1);
+        buffer[sizeof(buffer) - 1] = 0;
+        char_t *context = nullptr;
+        for (char_t *token = strtok_r(buffer, STR(" \t"), &context); token != nullptr; token = strtok_r(nullptr, STR(" \t"), &context))
+        {
+            if (plugin->assembly_path.empty())
+                plugin->assembly_path = token;
+            else if (plugin->type_name.empty())
+            {
+                // "Namespace.Type, AssemblyName", the assembly name being the file name without its extension
+                const char_t *file_name = strrchr(plugin->assembly_path.c_str(), DIR_SEPARATOR);
+                string_t assembly_name = file_name ? file_name + 1 : plugin->assembly_path;
+                const size_t extension = assembly_name.rfind(CH('.'));
+                if (extension != string_t::npos)
+                    assembly_name.erase(extension);
+                plugin->type_name = string_t(token) + STR(", ") + assembly_name;
+            }
+            else if (strcmp(token, STR("deferred")) == 0)
+                plugin->deferred = true;
+            else if (strncmp(token, STR("after="), 6) == 0)
+            {
+                char_t *after_context = nullptr;
+                for (char_t *after = strtok_r(token + 6, STR(","), &after_context); after != nullptr; after = strtok_r(nullptr, STR(","), &after_context))
+                {
+                    const int index = find_plugin(after);
+                    if (index < 0)
+                    {
+                        ALOGE("dotnet: plugin %s comes after %s, which is not listed above it", name.c_str(), after);
+                        return;
+                    }
+                    // every index is an earlier plugin, so once repeats are dropped the list cannot outgrow after[]
+                    bool listed = false;
+                    for (int i = 0; i < plugin->after_count; i++)
+                        listed |= plugin->after[i] == index;
+                    if (listed)
+                        continue;
+                    if (plugin->after_count == max_plugins)
+                    {
+                        ALOGE("dotnet: plugin %s comes after more than %d plugins, %s ignored", name.c_str(), max_plugins, after);
+                        continue;
+                    }
+                    plugin->after[plugin->after_count++] = index;
+                }
+            }
+            else
+                ALOGE("dotnet: plugin %s has an unknown option %s", name.c_str(), token);
+        }
+        if (plugin->type_name.empty())
+        {
+            ALOGE("dotnet: plugin %s needs an assembly and a type", name.c_str());
+            return;
+        }
+        host.plugin_count++;
+        if (!plugin->deferred)
+            require_plugin(host.plugin_count - 1);
+    }
+
+    // Reads main.cfg, one "key = value" per line and '#' starts a comment. plugin.* keys make up the plugin
+    // manifest. System.GC.* (GC flavour and limits, e.g. System.GC.Server, System.GC.Concurrent,
+    // System.GC.HeapHardLimit) and DotQuest.* keys (read by the app through AppContext.GetData) are applied as
+    // runtime properties, which only take effect before the runtime starts. The rest of the file belongs to the
+    // native side.
+    void apply_app_config(hostfxr_handle cxt, const char_t *app_config)
+    {
+        FILE *file = fopen(app_config, "r");
+        if (file == nullptr)
+            return;
+        char_t line[512];
+        while (fgets(line, sizeof(line), file))
+        {
+            char_t *comment = strchr(line, CH('#'));
+            if (comment != nullptr)
+                *comment = 0;
+            char_t *equals = strchr(line, CH('='));
+            if (equals == nullptr)
+                continue;
+            *equals = 0;
+            const string_t key = trim(line);
+            const string_t value = trim(equals + 1);
+            if (key.compare(0, 7, STR("plugin.")) == 0 && key.size() > 7)
+            {
+                add_plugin(key.substr(7), value);
+                continue;
+            }
+            if (value.empty() || set_property_fptr == nullptr || (key.compare(0, 10, STR("System.GC.")) != 0 && key.compare(0, 9, STR("DotQuest.")) != 0))
+                continue;
+            const int rc = set_property_fptr(cxt, key.c_str(), value.c_str());
+            if (rc != 0)
+                ALOGE("dotnet: unable to set %s: 0x%x", key.c_str(), rc);
+            else
+                ALOGV("dotnet: %s = %s (main.cfg)", key.c_str(), value.c_str());
+        }
+        fclose(file);
+    }
+
     // <SnippetInitialize>
     // Load and initialize .NET Core and get desired function pointer for scenario
-    load_assembly_and_get_function_pointer_fn get_dotnet_load_assembly(const char_t *config_path)
+    load_assembly_and_get_function_pointer_fn get_dotnet_load_assembly(const char_t *config_path, const char_t *app_config)
     {
         // Load .NET Core
         void *load_assembly_and_get_function_pointer = nullptr;
@@ -178,18 +598,39 @@ namespace
         int rc = init_fptr(config_path, nullptr, &cxt);
         if (rc != 0 || cxt == nullptr)
         {
-            std::cerr << "Init failed: " << std::hex << std::showbase << rc << std::endl;
+            ALOGE("dotnet: init failed: 0x%x", rc);
             close_fptr(cxt);
             return nullptr;
         }
 
+        apply_app_config(cxt, app_config);
+
+        // Log the code generation and GC knobs the runtime will start with
+        const char_t *knobs[] =
+        {
+            STR("System.Runtime.TieredCompilation"),
+            STR("System.Runtime.TieredCompilation.QuickJitForLoops"),
+            STR("System.Runtime.TieredPGO"),
+            STR("System.GC.Server"),
+            STR("System.GC.Concurrent"),
+            STR("System.GC.HeapHardLimit"),
+        };
+        for (size_t i = 0; get_property_fptr && i < sizeof(knobs) / sizeof(knobs[0]); i++)
+        {
+            const char_t *value = nullptr;
+            if (get_property_fptr(cxt, knobs[i], &value) == 0 && value != nullptr)
+                ALOGV("dotnet: %s = %s", knobs[i], value);
+            else
+                ALOGV("dotnet: %s is not set", knobs[i]);
+        }
+
         // Get the load assembly function pointer
         rc = get_delegate_fptr(
             cxt,
             hdt_load_assembly_and_get_function_pointer,
             &load_assembly_and_get_function_pointer);
         if (rc != 0 || load_assembly_and_get_function_pointer == nullptr)
-            std::cerr << "Get delegate failed: " << std::hex << std::showbase << rc << std::endl;
+            ALOGE("dotnet: get delegate failed: 0x%x", rc);
 
         close_fptr(cxt);
         return (load_assembly_and_get_function_pointer_fn)load_assembly_and_get_function_pointer;
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "coreclr_delegates.h"
+
+// Collections since the previous safe point, filled in by managed code.
+struct dotnet_gc_pause
+{
+    int collections;
+    int generation;         // highest generation collected
+    double milliseconds;    // total pause time
+};
+
+// Managed entry points, all [UnmanagedCallersOnly] methods on GameEstate.App.Quest.Lib. They are resolved once
+// when the host starts, so a native to managed call through the table is a plain indirect call.
+struct dotnet_entry_points
+{
+    int (CORECLR_DELEGATE_CALLTYPE *initialize)(int argc, char **argv);
+    // hands managed code the ovrHostApi function table, called before initialize; non-zero if the layout does not match
+    int (CORECLR_DELEGATE_CALLTYPE *attach_host_api)(const void *api, int size);
+    // returns the number of bytes written into the attached command buffer
+    int (CORECLR_DELEGATE_CALLTYPE *frame)(long long frame_index, double display_time);
+    void (CORECLR_DELEGATE_CALLTYPE *shutdown)();
+    // shuts the app assembly down and loads it again into a fresh collectible context; returns how many contexts
+    // of earlier reloads are still alive
+    int (CORECLR_DELEGATE_CALLTYPE *reload)();
+    // hands managed code the shared ovrFrameData block; returns non-zero if the layout does not match
+    int (CORECLR_DELEGATE_CALLTYPE *attach_frame_data)(void *data, int size);
+    // methods compiled by the JIT so far and the time spent on them; returns 0 unless started with --jitstats
+    int (CORECLR_DELEGATE_CALLTYPE *get_jit_stats)(long long *method_count, double *milliseconds);
+    // hands managed code the memory it writes render commands into; returns non-zero if it is refused
+    int (CORECLR_DELEGATE_CALLTYPE *attach_command_buffer)(void *data, int capacity);
+    // called at the start of every frame, before any other managed code runs in it, so the app can collect or open
+    // a no GC region at a frame boundary; returns the number of collections since the previous call
+    int (CORECLR_DELEGATE_CALLTYPE *safe_point)(long long frame_index, dotnet_gc_pause *pause);
+};
+
+// Loads hostfxr, starts the runtime and resolves the entry points. The runtime stays loaded for the lifetime of
+// the process, hostfxr cannot start a second one, so this only does work the first time it succeeds.
+// System.GC.* and DotQuest.* keys in <root_path>Main/main.cfg are applied as runtime properties first, and the
+// plugins listed there that are not deferred are initialized last, in parallel.
+bool dotnet_start(const char_t *root_path);
+// Initializes the plugins marked deferred in main.cfg on a background thread, meant for after the first frame.
+bool dotnet_start_deferred_plugins();
+// Runs dotnet_start on its own thread so runtime bring-up overlaps VR mode entry.
+bool dotnet_start_async(const char_t *root_path);
+// True once an asynchronous start has finished, whether it succeeded or not.
+bool dotnet_ready();
+
+// Seconds spent in each startup phase, filled in by dotnet_start.
+struct dotnet_startup_times
+{
+    double load_hostfxr;
+    double initialize_runtime;
+    double resolve_entry_points;
+    double plugins;             // the ones that are not deferred, initialized in parallel
+};
+const dotnet_startup_times *dotnet_startup();
+
+// Watches root_path for rebuilt app assemblies on its own thread.
+bool dotnet_watch(const char_t *root_path);
+// True, once, after assemblies changed and the directory has been quiet for a moment, so a deploy that copies
+// several files only reloads once. Reload between frames.
+bool dotnet_reload_pending();
+
+// The entry point table, or nullptr if the host has not started.
+const dotnet_entry_points *dotnet_entry();
+// Resolves any other [UnmanagedCallersOnly] method of the app assembly. Meant for startup, never per frame.
+void *dotnet_get_function(const char_t *type_name, const char_t *method_name);
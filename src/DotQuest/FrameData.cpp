@@ -0,0 +1,84 @@
+#include "VrApi.h"
+#include "VrApi_Helpers.h"
+#include "VrApi_Input.h"
+
+#include "FrameData.h"
+#include <stddef.h>
+
+/*
+================================================================================
+ovrFrameData
+================================================================================
+*/
+
+void ovrFrameData_Init(ovrFrameData* data) {
+	memset(data, 0, sizeof(ovrFrameData));
+	data->Version = FRAME_DATA_VERSION;
+	data->Size = sizeof(ovrFrameData);
+}
+
+static void ovrFramePose_Set(ovrFramePose* pose, const ovrPosef* source, unsigned int status) {
+	pose->Orientation[0] = source->Orientation.x;
+	pose->Orientation[1] = source->Orientation.y;
+	pose->Orientation[2] = source->Orientation.z;
+	pose->Orientation[3] = source->Orientation.w;
+	pose->Position[0] = source->Position.x;
+	pose->Position[1] = source->Position.y;
+	pose->Position[2] = source->Position.z;
+	pose->Status = status;
+}
+
+void ovrFrameData_Sample(ovrFrameData* frame, ovrMobile* ovr, long long frameIndex, double displayTime, ovrTracking2* tracking, ovrPoseHistory* history) {
+	frame->FrameIndex = frameIndex;
+	frame->DisplayTime = displayTime;
+	frame->SampleTime = vrapi_GetTimeInSeconds();
+
+	const ovrTracking2 head = vrapi_GetPredictedTracking2(ovr, displayTime);
+	ovrFramePose_Set(&frame->Head, &head.HeadPose.Pose, head.Status);
+	if (tracking)
+		*tracking = head;
+	ovrPoseSample poses[POSE_DEVICES] = {};
+	ovrPoseSample_Set(&poses[POSE_HEAD], &head.HeadPose, head.Status);
+
+	memset(frame->Controllers, 0, sizeof(frame->Controllers));
+	for (uint32_t i = 0; ; i++) {
+		ovrInputCapabilityHeader header;
+		if (vrapi_EnumerateInputDevices(ovr, i, &header) < 0)
+			break;
+		if (header.Type != ovrControllerType_TrackedRemote)
+			continue;
+		ovrInputTrackedRemoteCapabilities caps;
+		caps.Header = header;
+		if (vrapi_GetInputDeviceCapabilities(ovr, &caps.Header) < 0)
+			continue;
+		const int hand = (caps.ControllerCapabilities & ovrControllerCaps_LeftHand) ? 0 : 1;
+		ovrFrameController* controller = &frame->Controllers[hand];
+
+		ovrInputStateTrackedRemote state;
+		state.Header.ControllerType = ovrControllerType_TrackedRemote;
+		if (vrapi_GetCurrentInputState(ovr, header.DeviceID, &state.Header) >= 0) {
+			controller->Buttons = state.Buttons;
+			controller->Touches = state.Touches;
+			controller->IndexTrigger = state.IndexTrigger;
+			controller->GripTrigger = state.GripTrigger;
+			controller->Joystick[0] = state.Joystick.x;
+			controller->Joystick[1] = state.Joystick.y;
+		}
+		ovrTracking remoteTracking;
+		if (vrapi_GetInputTrackingState(ovr, header.DeviceID, displayTime, &remoteTracking) >= 0) {
+			ovrFramePose_Set(&controller->Pose, &remoteTracking.HeadPose.Pose, remoteTracking.Status);
+			ovrPoseSample_Set(&poses[POSE_LEFT + hand], &remoteTracking.HeadPose, remoteTracking.Status);
+		}
+	}
+	if (history)
+		ovrPoseHistory_Record(history, displayTime, poses);
+}
+
+void ovrFrameData_Publish(ovrFrameData* data, const ovrFrameData* frame) {
+	const size_t offset = offsetof(ovrFrameData, FrameIndex);
+	// odd sequence first, then the payload, then even again; readers retry if it changed under them
+	__atomic_store_n(&data->Sequence, data->Sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy((char*)data + offset, (const char*)frame + offset, sizeof(ovrFrameData) - offset);
+	__atomic_store_n(&data->Sequence, data->Sequence + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "VrApi.h"
+#include "PoseHistory.h"
+
+/*
+================================================================================
+ovrFrameData
+
+Per-frame state shared with managed code (FrameData.cs mirrors this layout).
+The host is the only writer; readers take a snapshot under the sequence lock,
+so no field is ever marshalled and a reader never sees a half-written frame.
+================================================================================
+*/
+
+#define FRAME_DATA_VERSION		1
+
+typedef struct {
+	float					Orientation[4];			// x, y, z, w
+	float					Position[3];
+	unsigned int			Status;					// ovrTrackingStatus
+} ovrFramePose;
+
+typedef struct {
+	unsigned int			Buttons;				// ovrButton
+	unsigned int			Touches;				// ovrTouch
+	float					IndexTrigger;
+	float					GripTrigger;
+	float					Joystick[2];
+	ovrFramePose			Pose;
+} ovrFrameController;
+
+typedef struct {
+	unsigned int			Version;
+	unsigned int			Size;
+	volatile unsigned int	Sequence;				// odd while the host is writing
+	unsigned int			Reserved;
+	long long				FrameIndex;
+	double					DisplayTime;			// predicted display time
+	double					SampleTime;				// when tracking and input were sampled
+	ovrFramePose			Head;
+	ovrFrameController		Controllers[2];			// left, right
+	// timing of the previous frame
+	float					FrameSeconds;
+	float					ManagedSeconds;
+} ovrFrameData;
+
+void ovrFrameData_Init(ovrFrameData* data);
+// Samples tracking and controller input for the frame into a private copy; tracking, if not NULL, receives the head tracking,
+// and history, if not NULL, the head and controller poses with their velocities.
+void ovrFrameData_Sample(ovrFrameData* frame, ovrMobile* ovr, long long frameIndex, double displayTime, ovrTracking2* tracking, ovrPoseHistory* history);
+// Copies a sampled frame into the shared block under the sequence lock.
+void ovrFrameData_Publish(ovrFrameData* data, const ovrFrameData* frame);
@@ -0,0 +1,251 @@
+#include "VrApi.h"
+
+#include "HostApi.h"
+#include <sys/prctl.h>
+
+/*
+================================================================================
+ovrJobQueue
+================================================================================
+*/
+
+static void* ovrJobQueue_ThreadFunction(void* parm) {
+	prctl(PR_SET_NAME, (long)"DQ::Job", 0, 0, 0);
+	ovrJobQueue* queue = (ovrJobQueue*)parm;
+	pthread_mutex_lock(&queue->Mutex);
+	for (;;) {
+		while (!queue->Exit && queue->Started == queue->Submitted)
+			pthread_cond_wait(&queue->WorkCond, &queue->Mutex);
+		if (queue->Exit)
+			break;
+		ovrJob* job = &queue->Jobs[++queue->Started % JOB_QUEUE_SIZE];
+		pthread_mutex_unlock(&queue->Mutex);
+		job->Function(job->Argument);
+		pthread_mutex_lock(&queue->Mutex);
+		job->Done = true;
+		pthread_cond_broadcast(&queue->DoneCond);
+	}
+	pthread_mutex_unlock(&queue->Mutex);
+	return NULL;
+}
+
+bool ovrJobQueue_Create(ovrJobQueue* queue) {
+	memset(queue, 0, sizeof(ovrJobQueue));
+	pthread_mutex_init(&queue->Mutex, NULL);
+	pthread_cond_init(&queue->WorkCond, NULL);
+	pthread_cond_init(&queue->DoneCond, NULL);
+	for (int i = 0; i < JOB_WORKERS; i++) {
+		const int createError = pthread_create(&queue->Threads[queue->ThreadCount], NULL, ovrJobQueue_ThreadFunction, queue);
+		if (createError != 0) {
+			ALOGE("pthread_create returned %i", createError);
+			break;
+		}
+		queue->ThreadCount++;
+	}
+	return queue->ThreadCount > 0;
+}
+
+void ovrJobQueue_Destroy(ovrJobQueue* queue) {
+	pthread_mutex_lock(&queue->Mutex);
+	queue->Exit = true;
+	pthread_cond_broadcast(&queue->WorkCond);
+	pthread_mutex_unlock(&queue->Mutex);
+	for (int i = 0; i < queue->ThreadCount; i++)
+		pthread_join(queue->Threads[i], NULL);
+	pthread_cond_destroy(&queue->WorkCond);
+	pthread_cond_destroy(&queue->DoneCond);
+	pthread_mutex_destroy(&queue->Mutex);
+	queue->ThreadCount = 0;
+}
+
+long long ovrJobQueue_Submit(ovrJobQueue* queue, void (*function)(void* argument), void* argument) {
+	pthread_mutex_lock(&queue->Mutex);
+	ovrJob* job = &queue->Jobs[(queue->Submitted + 1) % JOB_QUEUE_SIZE];
+	// the slot still holds a job that has not finished, or there is nobody to run it
+	if ((job->Id != 0 && !job->Done) || queue->ThreadCount == 0) {
+		queue->RanInline++;
+		pthread_mutex_unlock(&queue->Mutex);
+		function(argument);
+		return 0;
+	}
+	job->Function = function;
+	job->Argument = argument;
+	const long long id = ++queue->Submitted;
+	job->Id = id;
+	job->Done = false;
+	pthread_cond_signal(&queue->WorkCond);
+	pthread_mutex_unlock(&queue->Mutex);
+	return id;
+}
+
+void ovrJobQueue_Wait(ovrJobQueue* queue, long long id) {
+	if (id <= 0)
+		return;
+	const ovrJob* job = &queue->Jobs[id % JOB_QUEUE_SIZE];
+	pthread_mutex_lock(&queue->Mutex);
+	// once the slot holds a later job, this one finished long ago
+	while (job->Id == id && !job->Done)
+		pthread_cond_wait(&queue->DoneCond, &queue->Mutex);
+	pthread_mutex_unlock(&queue->Mutex);
+}
+
+/*
+================================================================================
+Batch math
+================================================================================
+*/
+
+// one chunk of a batch call
+typedef struct {
+	void					(*Function)(const void* batch, int start, int count);
+	const void*				Batch;
+	int						Start;
+	int						Count;
+} ovrChunkJob;
+
+static void ovrJobQueue_ChunkJob(void* argument) {
+	ovrChunkJob* job = (ovrChunkJob*)argument;
+	job->Function(job->Batch, job->Start, job->Count);
+}
+
+// Only the last chunk can be a size that is not a multiple of 4, so only it has a scalar tail.
+void ovrJobQueue_Split(ovrJobQueue* queue, int count, int minimum, void (*function)(const void* batch, int start, int count), const void* batch) {
+	ovrChunkJob jobs[JOB_WORKERS + 1];
+	long long ids[JOB_WORKERS + 1];
+	const int chunks = count < minimum ? 1 : queue->ThreadCount + 1;
+	const int chunk = ((count + chunks - 1) / chunks + 3) & ~3;
+	int submitted = 0;
+	for (int start = 0; start < count; start += chunk) {
+		ovrChunkJob* job = &jobs[submitted];
+		job->Function = function;
+		job->Batch = batch;
+		job->Start = start;
+		job->Count = count - start < chunk ? count - start : chunk;
+		if (start + chunk >= count) {
+			ovrJobQueue_ChunkJob(job);
+			break;
+		}
+		ids[submitted++] = ovrJobQueue_Submit(queue, ovrJobQueue_ChunkJob, job);
+	}
+	for (int i = 0; i < submitted; i++)
+		ovrJobQueue_Wait(queue, ids[i]);
+}
+
+typedef struct {
+	const vec4_t*			Matrix;
+	const vec3soa_t*		In;
+	vec3soa_t*				Out;
+} ovrPointsBatch;
+
+static void ovrJobQueue_TransformPointsChunk(const void* batch, int start, int count) {
+	const ovrPointsBatch* points = (const ovrPointsBatch*)batch;
+	const vec3soa_t in = { points->In->x + start, points->In->y + start, points->In->z + start };
+	vec3soa_t out = { points->Out->x + start, points->Out->y + start, points->Out->z + start };
+	Math::Matrix3x4_VectorTransformBatch((vec4_t*)points->Matrix, &in, &out, count);
+}
+
+void ovrJobQueue_TransformPoints(ovrJobQueue* queue, cmatrix3x4 matrix, const vec3soa_t* in, vec3soa_t* out, int count) {
+	const ovrPointsBatch batch = { matrix, in, out };
+	ovrJobQueue_Split(queue, count, MATH_JOB_MIN_POINTS, ovrJobQueue_TransformPointsChunk, &batch);
+}
+
+typedef struct {
+	matrix3x4*				Out;
+	const matrix3x4*		M1;
+	const matrix3x4*		M2;
+} ovrConcatBatch;
+
+static void ovrJobQueue_ConcatTransformsChunk(const void* batch, int start, int count) {
+	const ovrConcatBatch* concat = (const ovrConcatBatch*)batch;
+	Math::Matrix3x4_ConcatTransformsBatch(concat->Out + start, concat->M1 + start, concat->M2 + start, count);
+}
+
+void ovrJobQueue_ConcatTransforms(ovrJobQueue* queue, matrix3x4* out, const matrix3x4* m1, const matrix3x4* m2, int count) {
+	const ovrConcatBatch batch = { out, m1, m2 };
+	ovrJobQueue_Split(queue, count, MATH_JOB_MIN_MATRICES, ovrJobQueue_ConcatTransformsChunk, &batch);
+}
+
+typedef struct {
+	vec4_t*					Out;
+	const vec4_t*			P;
+	const vec4_t*			Q;
+	const float*			Weights;
+	int						Mode;
+} ovrBlendBatch;
+
+static void ovrJobQueue_BlendQuaternionsChunk(const void* batch, int start, int count) {
+	const ovrBlendBatch* blend = (const ovrBlendBatch*)batch;
+	Math::QuaternionBlendBatch(blend->P + start, blend->Q + start, blend->Weights + start, blend->Out + start, count, blend->Mode);
+}
+
+void ovrJobQueue_BlendQuaternions(ovrJobQueue* queue, vec4_t* out, const vec4_t* p, const vec4_t* q, const float* weights, int count, int mode) {
+	const ovrBlendBatch batch = { out, p, q, weights, mode };
+	ovrJobQueue_Split(queue, count, MATH_JOB_MIN_QUATERNIONS, ovrJobQueue_BlendQuaternionsChunk, &batch);
+}
+
+/*
+================================================================================
+ovrHostApi
+================================================================================
+*/
+
+static ovrJobQueue* HostJobs;
+
+static void ovrHostApi_Log(int priority, const char* message) {
+	__android_log_print(priority, ALOG_TAG, "%s", message);
+}
+
+static double ovrHostApi_TimeInSeconds() {
+	return vrapi_GetTimeInSeconds();
+}
+
+static long long ovrHostApi_SubmitJob(void (*function)(void* argument), void* argument) {
+	return ovrJobQueue_Submit(HostJobs, function, argument);
+}
+
+static void ovrHostApi_WaitJob(long long job) {
+	ovrJobQueue_Wait(HostJobs, job);
+}
+
+static void ovrHostApi_TransformPoints(const float* matrix, const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, int count) {
+	const vec3soa_t in = { (float*)x, (float*)y, (float*)z };
+	vec3soa_t out = { outX, outY, outZ };
+	ovrJobQueue_TransformPoints(HostJobs, (vec4_t*)matrix, &in, &out, count);
+}
+
+static void ovrHostApi_ConcatTransforms(float* out, const float* m1, const float* m2, int count) {
+	ovrJobQueue_ConcatTransforms(HostJobs, (matrix3x4*)out, (const matrix3x4*)m1, (const matrix3x4*)m2, count);
+}
+
+static void ovrHostApi_BlendQuaternions(float* out, const float* p, const float* q, const float* weights, int count, int mode) {
+	ovrJobQueue_BlendQuaternions(HostJobs, (vec4_t*)out, (const vec4_t*)p, (const vec4_t*)q, weights, count, mode);
+}
+
+static void ovrHostApi_FloatToHalf(unsigned short* out, const float* values, int count) {
+	Math::FloatToHalfBatch(values, out, count);
+}
+
+static void ovrHostApi_HalfToFloat(float* out, const unsigned short* values, int count) {
+	Math::HalfToFloatBatch(values, out, count);
+}
+
+void ovrHostApi_Init(ovrHostApi* api, ovrJobQueue* jobs) {
+	memset(api, 0, sizeof(ovrHostApi));
+	api->Version = HOST_API_VERSION;
+	api->Size = sizeof(ovrHostApi);
+	api->Log = ovrHostApi_Log;
+	api->TimeInSeconds = ovrHostApi_TimeInSeconds;
+	api->SubmitJob = ovrHostApi_SubmitJob;
+	api->WaitJob = ovrHostApi_WaitJob;
+	api->TransformPoints = ovrHostApi_TransformPoints;
+	api->ConcatTransforms = ovrHostApi_ConcatTransforms;
+	api->BlendQuaternions = ovrHostApi_BlendQuaternions;
+	api->FloatToHalf = ovrHostApi_FloatToHalf;
+	api->HalfToFloat = ovrHostApi_HalfToFloat;
+	HostJobs = jobs;
+}
+
+// Exported for the P/Invoke side of --apibench only, the table is the supported way in.
+extern "C" __attribute__((visibility("default"))) double dotquest_time_in_seconds() {
+	return vrapi_GetTimeInSeconds();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <pthread.h>
+#include "lib/Math.h"
+#include "PoseHistory.h"
+
+/*
+================================================================================
+ovrJobQueue
+
+A fixed pool of worker threads taking jobs in submission order. Jobs are
+identified by a sequence number, so waiting on one never needs a handle to
+be released afterwards.
+================================================================================
+*/
+
+#define JOB_QUEUE_SIZE			256
+#define JOB_WORKERS				3
+
+typedef struct {
+	void					(*Function)(void* argument);
+	void*					Argument;
+	long long				Id;
+	bool					Done;
+} ovrJob;
+
+typedef struct {
+	pthread_t				Threads[JOB_WORKERS];
+	int						ThreadCount;
+	pthread_mutex_t			Mutex;
+	pthread_cond_t			WorkCond;
+	pthread_cond_t			DoneCond;
+	bool					Exit;
+	ovrJob					Jobs[JOB_QUEUE_SIZE];
+	long long				Submitted;				// id of the last job queued
+	long long				Started;				// id of the last job a worker took
+	long long				RanInline;				// jobs run by the submitter because the queue was full
+} ovrJobQueue;
+
+bool ovrJobQueue_Create(ovrJobQueue* queue);
+void ovrJobQueue_Destroy(ovrJobQueue* queue);
+// Returns the job id, or 0 if the queue was full and the job already ran on the calling thread.
+long long ovrJobQueue_Submit(ovrJobQueue* queue, void (*function)(void* argument), void* argument);
+void ovrJobQueue_Wait(ovrJobQueue* queue, long long job);
+
+/*
+================================================================================
+Batch math
+
+The lib/Math batch routines split over the job queue, with the caller taking
+the last chunk. Below the minimums the handoff costs more than it saves and
+everything runs on the caller. A job must not call these, a worker waiting on
+its own queue can deadlock.
+================================================================================
+*/
+
+#define MATH_JOB_MIN_POINTS		16384
+#define MATH_JOB_MIN_MATRICES	2048
+#define MATH_JOB_MIN_QUATERNIONS	2048
+
+// Calls function over count items in chunks, in multiples of 4, on the workers and the caller.
+void ovrJobQueue_Split(ovrJobQueue* queue, int count, int minimum, void (*function)(const void* batch, int start, int count), const void* batch);
+
+void ovrJobQueue_TransformPoints(ovrJobQueue* queue, cmatrix3x4 matrix, const vec3soa_t* in, vec3soa_t* out, int count);
+void ovrJobQueue_ConcatTransforms(ovrJobQueue* queue, matrix3x4* out, const matrix3x4* m1, const matrix3x4* m2, int count);
+void ovrJobQueue_BlendQuaternions(ovrJobQueue* queue, vec4_t* out, const vec4_t* p, const vec4_t* q, const float* weights, int count, int mode);
+
+/*
+================================================================================
+ovrHostApi
+
+Native functions handed to managed code once at startup (HostApi.cs mirrors
+this layout). Managed code calls them through unmanaged function pointers,
+so there is no DllImport resolution and no marshalling stub on the way.
+Bump the version on both sides when the layout changes.
+================================================================================
+*/
+
+#define HOST_API_VERSION		8
+
+// layers managed code can ask the host to add to the next frame
+enum {
+	HOST_LAYER_LOADING_ICON = 1
+};
+
+typedef struct {
+	long long				FrameIndex;
+	double					DisplayTime;
+	// command buffer, totals since startup
+	long long				CommandFrames;
+	long long				CommandDraws;
+	double					CommandSeconds;
+	// texture uploads, totals since startup
+	long long				UploadedTextures;
+	long long				UploadedBytes;
+	double					UploadSeconds;
+	long long				JobsSubmitted;
+	long long				JobsRanInline;
+} ovrHostFrameStats;
+
+typedef struct {
+	int						Version;
+	int						Size;
+	void					(*Log)(int priority, const char* message);			// ANDROID_LOG_*
+	double					(*TimeInSeconds)();									// same clock as the display time
+	long long				(*SubmitJob)(void (*function)(void* argument), void* argument);
+	void					(*WaitJob)(long long job);
+	void					(*SubmitLayer)(int layer);							// HOST_LAYER_*
+	void					(*GetFrameStats)(ovrHostFrameStats* stats);
+	// count points by one row major 3x4 matrix, the outputs may be the inputs
+	void					(*TransformPoints)(const float* matrix, const float* x, const float* y, const float* z, float* outX, float* outY, float* outZ, int count);
+	// out[i] = m1[i] * m2[i] over count row major 3x4 matrices
+	void					(*ConcatTransforms)(float* out, const float* m1, const float* m2, int count);
+	// out[i] = p[i] blended toward q[i] by weights[i] over count x, y, z, w quaternions, mode is a QUAT_BLEND_*
+	void					(*BlendQuaternions)(float* out, const float* p, const float* q, const float* weights, int count, int mode);
+	// count values to and from half floats, rounded to nearest even, for packing vertex attributes and 16F textures
+	void					(*FloatToHalf)(unsigned short* out, const float* values, int count);
+	void					(*HalfToFloat)(float* out, const unsigned short* values, int count);
+	// writes the indices of the boxes (x, y, z mins and maxs) or spheres (x, y, z, radius) that a CULL_* view of this
+	// frame can see to visible, in increasing order, and returns how many
+	int						(*CullBoxes)(int view, const float* mins, const float* maxs, int count, int* visible);
+	int						(*CullSpheres)(int view, const float* spheres, int count, int* visible);
+	// the POSE_* device at a display time from the recorded history, interpolated inside it and extrapolated a little
+	// past the newest frame; returns 0 for times older than the history, with the oldest pose
+	int						(*GetPose)(int device, double time, ovrPoseSample* pose);
+	// loads a KTX2 file of ETC2 or ASTC levels and returns its texture handle for draws, -1 if it cannot be loaded;
+	// the coarse levels are resident at once, the finer ones stream in over the next frames. Frame thread only.
+	int						(*LoadTexture)(const char* path);
+	// copies width x height RGBA8 pixels and queues them on the upload thread, returns their texture handle for draws or
+	// -1 when the queue or the handles are full; the handle draws white until the upload has finished. Frame thread only.
+	int						(*UploadTexture)(int width, int height, const void* pixels);
+} ovrHostApi;
+
+// Fills in the version, logging, clock, jobs and batch math; the app provides SubmitLayer, GetFrameStats, culling, poses,
+// LoadTexture and UploadTexture.
+void ovrHostApi_Init(ovrHostApi* api, ovrJobQueue* jobs);
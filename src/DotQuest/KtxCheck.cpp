@@ -0,0 +1,321 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl31.h>
+#include <GLES3/gl3ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+#include "KtxCheck.h"
+
+/*
+================================================================================
+KtxCheck
+================================================================================
+*/
+
+// a 64x64 RGB8 ETC2 texture has seven levels, 2048 bytes down to the 8 of a single block
+#define KTX_CHECK_SIZE			64
+#define KTX_CHECK_LEVELS		7
+#define KTX_CHECK_FORMAT		147			// VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+#define KTX_CHECK_BYTES			4096
+
+// field offsets in the KTX2 header; the level index follows it at 80, three 64 bit values per level
+#define KTX_VK_FORMAT			12
+#define KTX_PIXEL_WIDTH			20
+#define KTX_PIXEL_HEIGHT		24
+#define KTX_LEVEL_COUNT			40
+#define KTX_SUPERCOMPRESSION	44
+#define KTX_LEVEL_INDEX			80
+#define KTX_LEVEL_STRIDE		24
+
+typedef struct {
+	const char*		Name;
+	bool			Valid;				// whether ovrKtxFile_Open must accept the file
+	// changes the generated file in place; returns the number of bytes to write
+	int				(*Mutate)(unsigned char* data, int size);
+} ovrKtxCase;
+
+static void KtxCheck_Put32(unsigned char* data, int offset, unsigned int value) {
+	memcpy(data + offset, &value, sizeof(value));
+}
+
+static void KtxCheck_Put64(unsigned char* data, int offset, unsigned long long value) {
+	memcpy(data + offset, &value, sizeof(value));
+}
+
+static unsigned long long KtxCheck_Get64(const unsigned char* data, int offset) {
+	unsigned long long value;
+	memcpy(&value, data + offset, sizeof(value));
+	return value;
+}
+
+static int KtxCheck_LevelSize(int level) {
+	const int blocks = ((KTX_CHECK_SIZE >> level) + 3) / 4;
+	return blocks * blocks * 8;
+}
+
+// Writes a valid file with the levels stored smallest first, as KTX2 does, each filled with its own number.
+static int KtxCheck_Generate(unsigned char* data) {
+	static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	memset(data, 0, KTX_CHECK_BYTES);
+	memcpy(data, identifier, sizeof(identifier));
+	KtxCheck_Put32(data, KTX_VK_FORMAT, KTX_CHECK_FORMAT);
+	KtxCheck_Put32(data, 16, 1);				// type size
+	KtxCheck_Put32(data, KTX_PIXEL_WIDTH, KTX_CHECK_SIZE);
+	KtxCheck_Put32(data, KTX_PIXEL_HEIGHT, KTX_CHECK_SIZE);
+	KtxCheck_Put32(data, 36, 1);				// face count
+	KtxCheck_Put32(data, KTX_LEVEL_COUNT, KTX_CHECK_LEVELS);
+	int offset = KTX_LEVEL_INDEX + KTX_CHECK_LEVELS * KTX_LEVEL_STRIDE;
+	for (int level = KTX_CHECK_LEVELS - 1; level >= 0; level--) {
+		const int size = KtxCheck_LevelSize(level);
+		KtxCheck_Put64(data, KTX_LEVEL_INDEX + level * KTX_LEVEL_STRIDE, offset);
+		KtxCheck_Put64(data, KTX_LEVEL_INDEX + level * KTX_LEVEL_STRIDE + 8, size);
+		KtxCheck_Put64(data, KTX_LEVEL_INDEX + level * KTX_LEVEL_STRIDE + 16, size);
+		memset(data + offset, level, size);
+		offset += size;
+	}
+	return offset;
+}
+
+static int KtxCheck_Unchanged(unsigned char* data, int size) {
+	return size;
+}
+
+// the loader treats a level count of 0 as a single level
+static int KtxCheck_NoLevelCount(unsigned char* data, int size) {
+	KtxCheck_Put32(data, KTX_LEVEL_COUNT, 0);
+	return size;
+}
+
+static int KtxCheck_Empty(unsigned char* data, int size) {
+	return 0;
+}
+
+static int KtxCheck_ShortHeader(unsigned char* data, int size) {
+	return KTX_LEVEL_INDEX - 1;
+}
+
+static int KtxCheck_BadIdentifier(unsigned char* data, int size) {
+	data[5] = '1';
+	return size;
+}
+
+static int KtxCheck_Supercompressed(unsigned char* data, int size) {
+	KtxCheck_Put32(data, KTX_SUPERCOMPRESSION, 1);
+	return size;
+}
+
+// VK_FORMAT_R8G8B8A8_UNORM, only block compressed formats are loaded
+static int KtxCheck_Uncompressed(unsigned char* data, int size) {
+	KtxCheck_Put32(data, KTX_VK_FORMAT, 37);
+	return size;
+}
+
+static int KtxCheck_ZeroWidth(unsigned char* data, int size) {
+	KtxCheck_Put32(data, KTX_PIXEL_WIDTH, 0);
+	return size;
+}
+
+static int KtxCheck_TooManyLevels(unsigned char* data, int size) {
+	KtxCheck_Put32(data, KTX_LEVEL_COUNT, MAX_TEXTURE_LEVELS + 1);
+	return size;
+}
+
+// a level count so large the index size would wrap if it were multiplied in 32 bits
+static int KtxCheck_HugeLevelCount(unsigned char* data, int size) {
+	KtxCheck_Put32(data, KTX_LEVEL_COUNT, 0xffffffffu);
+	return size;
+}
+
+static int KtxCheck_TruncatedIndex(unsigned char* data, int size) {
+	return KTX_LEVEL_INDEX + KTX_CHECK_LEVELS * KTX_LEVEL_STRIDE - 1;
+}
+
+// level 0 is stored last, so this cuts its final byte
+static int KtxCheck_TruncatedLevel(unsigned char* data, int size) {
+	return size - 1;
+}
+
+static int KtxCheck_OffsetPastEnd(unsigned char* data, int size) {
+	KtxCheck_Put64(data, KTX_LEVEL_INDEX, size + 1);
+	return size;
+}
+
+// offset plus length wraps around to a small value inside the file
+static int KtxCheck_OffsetOverflow(unsigned char* data, int size) {
+	KtxCheck_Put64(data, KTX_LEVEL_INDEX + (KTX_CHECK_LEVELS - 1) * KTX_LEVEL_STRIDE, ~0ull - 7);
+	return size;
+}
+
+static int KtxCheck_LengthOverflow(unsigned char* data, int size) {
+	KtxCheck_Put64(data, KTX_LEVEL_INDEX + 8, ~0ull - KtxCheck_Get64(data, KTX_LEVEL_INDEX) + 1);
+	return size;
+}
+
+// a length that fits in the file but is not what the level's size needs
+static int KtxCheck_WrongLength(unsigned char* data, int size) {
+	KtxCheck_Put64(data, KTX_LEVEL_INDEX + 2 * KTX_LEVEL_STRIDE + 8, KtxCheck_LevelSize(2) - 8);
+	return size;
+}
+
+static const ovrKtxCase KtxCases[] = {
+	{ "valid", true, KtxCheck_Unchanged },
+	{ "no level count", true, KtxCheck_NoLevelCount },
+	{ "empty", false, KtxCheck_Empty },
+	{ "short header", false, KtxCheck_ShortHeader },
+	{ "bad identifier", false, KtxCheck_BadIdentifier },
+	{ "supercompressed", false, KtxCheck_Supercompressed },
+	{ "uncompressed", false, KtxCheck_Uncompressed },
+	{ "zero width", false, KtxCheck_ZeroWidth },
+	{ "too many levels", false, KtxCheck_TooManyLevels },
+	{ "huge level count", false, KtxCheck_HugeLevelCount },
+	{ "truncated index", false, KtxCheck_TruncatedIndex },
+	{ "truncated level", false, KtxCheck_TruncatedLevel },
+	{ "offset past end", false, KtxCheck_OffsetPastEnd },
+	{ "offset overflow", false, KtxCheck_OffsetOverflow },
+	{ "length overflow", false, KtxCheck_LengthOverflow },
+	{ "wrong length", false, KtxCheck_WrongLength },
+};
+
+static bool KtxCheck_Write(const char* path, const unsigned char* data, int size) {
+	FILE* f = fopen(path, "wb");
+	if (!f)
+		return false;
+	const bool written = (int)fwrite(data, 1, size, f) == size;
+	return fclose(f) == 0 && written;
+}
+
+// The levels the file was parsed into must point at the data generated for them.
+static bool KtxCheck_Levels(const ovrKtxFile* file, int levelCount) {
+	if (file->Width != KTX_CHECK_SIZE || file->Height != KTX_CHECK_SIZE || file->LevelCount != levelCount ||
+		file->InternalFormat != GL_COMPRESSED_RGB8_ETC2)
+		return false;
+	for (int level = 0; level < levelCount; level++) {
+		const ovrTextureLevel* l = &file->Levels[level];
+		if (l->Width != KTX_CHECK_SIZE >> level || l->Height != KTX_CHECK_SIZE >> level || l->Size != KtxCheck_LevelSize(level))
+			return false;
+		for (int i = 0; i < l->Size; i++)
+			if (((const unsigned char*)l->Data)[i] != level)
+				return false;
+	}
+	return true;
+}
+
+// Levels at or above the base level are defined at their size, the finer ones are not defined yet.
+static bool KtxCheck_Resident(const ovrKtxTexture* texture, int expectedBase) {
+	GLint base = -1;
+	GL(glBindTexture(GL_TEXTURE_2D, texture->Texture));
+	GL(glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &base));
+	bool result = texture->BaseLevel == expectedBase && base == expectedBase;
+	for (int level = 0; level < KTX_CHECK_LEVELS; level++) {
+		GLint width = -1, height = -1;
+		GL(glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width));
+		GL(glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height));
+		const int expected = level >= expectedBase ? KTX_CHECK_SIZE >> level : 0;
+		result &= width == expected && height == expected;
+	}
+	GL(glBindTexture(GL_TEXTURE_2D, 0));
+	result &= glGetError() == GL_NO_ERROR;
+	if (!result)
+		ALOGE("KtxCheck: base level %d (GL %d), expected %d", texture->BaseLevel, base, expectedBase);
+	return result;
+}
+
+// Three levels resident, then one level per step and two on a budget that fits them, then the rest.
+static bool KtxCheck_UploadOrder(const ovrKtxFile* file) {
+	ovrKtxTexture texture;
+	memset(&texture, 0, sizeof(texture));
+	bool result = ovrKtxTexture_Create(&texture, file, 3) && KtxCheck_Resident(&texture, KTX_CHECK_LEVELS - 3);
+	result = result && !ovrKtxTexture_Stream(&texture, file, 0) && KtxCheck_Resident(&texture, 3);
+	result = result && !ovrKtxTexture_Stream(&texture, file, KtxCheck_LevelSize(2) + KtxCheck_LevelSize(1)) &&
+		KtxCheck_Resident(&texture, 1);
+	result = result && ovrKtxTexture_Stream(&texture, file, 0) && KtxCheck_Resident(&texture, 0);
+	result = result && ovrKtxTexture_Stream(&texture, file, 0) && KtxCheck_Resident(&texture, 0);
+	ovrKtxTexture_Destroy(&texture);
+	// all levels at once
+	result = result && ovrKtxTexture_Create(&texture, file, 0) && KtxCheck_Resident(&texture, 0);
+	ovrKtxTexture_Destroy(&texture);
+	return result;
+}
+
+bool KtxCheck_Run(const char* directory) {
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/ktxcheck.ktx2", directory);
+	unsigned char* data = (unsigned char*)malloc(KTX_CHECK_BYTES);
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(KtxCases) / sizeof(KtxCases[0]); i++) {
+		const ovrKtxCase* c = &KtxCases[i];
+		const int size = c->Mutate(data, KtxCheck_Generate(data));
+		if (!KtxCheck_Write(path, data, size)) {
+			ALOGE("KtxCheck: unable to write %s", path);
+			failed++;
+			break;
+		}
+		ovrKtxFile file;
+		const bool opened = ovrKtxFile_Open(&file, path);
+		bool passed = opened == c->Valid;
+		if (passed && opened)
+			passed = KtxCheck_Levels(&file, file.LevelCount == 1 ? 1 : KTX_CHECK_LEVELS);
+		if (passed && opened && file.LevelCount == KTX_CHECK_LEVELS) {
+			passed = KtxCheck_UploadOrder(&file);
+			ALOGI("KtxCheck: %-18s %s, accepted and uploaded coarsest first", c->Name, passed ? "ok" : "FAILED");
+		} else {
+			ALOGI("KtxCheck: %-18s %s, %s", c->Name, passed ? "ok" : "FAILED", opened ? "accepted" : "refused");
+		}
+		if (opened)
+			ovrKtxFile_Close(&file);
+		failed += !passed;
+	}
+	remove(path);
+	free(data);
+	if (failed)
+		ALOGE("KtxCheck: %d cases failed", failed);
+	return failed == 0;
+}
+
+#ifdef KTX_CHECK_MAIN
+/*
+================================================================================
+Standalone
+
+The same check as a program of its own, on any desktop GLES 3.1 driver; Mesa's
+software rasterizer decodes ETC2, so no GPU is needed. From this directory:
+
+	g++ -std=c++14 -O2 -DKTX_CHECK_MAIN -I. -I../../lib/quest -include pch.h \
+		KtxCheck.cpp VrKtx.cpp -lEGL -lGLESv2 -o ktxcheck
+	EGL_PLATFORM=surfaceless ./ktxcheck
+
+An argument names the directory the files are written to, the current one by
+default. The exit code is 0 when every case passes, 2 without a context.
+================================================================================
+*/
+
+int main(int argc, char* argv[]) {
+	EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL) || !eglBindAPI(EGL_OPENGL_ES_API)) {
+		ALOGE("KtxCheck: no EGL display");
+		return 2;
+	}
+	const EGLint configAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT_KHR, EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_NONE };
+	const EGLint contextAttribs[] = { EGL_CONTEXT_MAJOR_VERSION_KHR, 3, EGL_CONTEXT_MINOR_VERSION_KHR, 1, EGL_NONE };
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	EGLContext context = EGL_NO_CONTEXT;
+	if (eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) && numConfigs > 0)
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	// no surface is needed, nothing is drawn
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		ALOGE("KtxCheck: no GLES 3.1 context");
+		eglTerminate(display);
+		return 2;
+	}
+	ALOGI("KtxCheck: %s", (const char*)glGetString(GL_RENDERER));
+	const bool passed = KtxCheck_Run(argc > 1 ? argv[1] : ".");
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(display, context);
+	eglTerminate(display);
+	return passed ? 0 : 1;
+}
+#endif
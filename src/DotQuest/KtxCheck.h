@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+================================================================================
+KtxCheck
+
+Startup diagnostic for the KTX2 loader, run with --ktxcheck, or on its own on a
+desktop GLES 3.1 driver when built with KTX_CHECK_MAIN (see the end of
+KtxCheck.cpp). A small ETC2 file is generated, then copies of it with a short
+header, a cut off level index or level, offsets and lengths that overflow, and
+so on; each must be accepted or refused by ovrKtxFile_Open as expected. The
+valid file is then uploaded a few levels at a time and the defined levels and
+base level are checked after every step, coarsest first.
+================================================================================
+*/
+
+// Writes its files to directory and removes them again; needs a current GLES 3.1 context. Logs one line per case
+// and returns false if any of them fails.
+bool KtxCheck_Run(const char* directory);
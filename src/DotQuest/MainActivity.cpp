@@ -19,6 +19,13 @@
 #include <../src/gl/loader.h>
 
 #include "VrCompositor.h"
+#include "DotNetHost.h"
+#include "FrameData.h"
+#include "HostApi.h"
+#include "Culling.h"
+#include "Watchdog.h"
+#include "MathCheck.h"
+#include "KtxCheck.h"
 
 // Must use EGLSyncKHR because the VrApi still supports OpenGL ES 2.0
 #define EGL_SYNC
@@ -36,6 +43,11 @@ PFNEGLGETSYNCATTRIBKHRPROC		eglGetSyncAttribKHR;
 int CPU_LEVEL = 4;
 int GPU_LEVEL = 4;
 int NUM_MULTI_SAMPLES = 1;
+bool VALIDATE_COMMANDS = false;
+bool HOT_RELOAD = false;
+int WATCHDOG_MS = 3000;
+bool MATH_CHECK = false;
+bool KTX_CHECK = false;
 float SS_MULTIPLIER = 1.25f;
 float maximumSupportedFramerate = 60.0; //The lowest default framerate
 
@@ -104,17 +116,7 @@ ovrEgl
 ================================================================================
 */
 
-typedef struct {
-	EGLint		MajorVersion;
-	EGLint		MinorVersion;
-	EGLDisplay	Display;
-	EGLConfig	Config;
-	EGLSurface	TinySurface;
-	EGLSurface	MainSurface;
-	EGLContext	Context;
-} ovrEgl;
-
-static void ovrEgl_Clear(ovrEgl* egl) {
+void ovrEgl_Clear(ovrEgl* egl) {
 	egl->MajorVersion = 0;
 	egl->MinorVersion = 0;
 	egl->Display = 0;
@@ -122,11 +124,13 @@ static void ovrEgl_Clear(ovrEgl* egl) {
 	egl->TinySurface = EGL_NO_SURFACE;
 	egl->MainSurface = EGL_NO_SURFACE;
 	egl->Context = EGL_NO_CONTEXT;
+	egl->Shared = false;
 }
 
-static void ovrEgl_CreateContext(ovrEgl* egl, const ovrEgl* shareEgl) {
+void ovrEgl_CreateContext(ovrEgl* egl, const ovrEgl* shareEgl) {
 	if (egl->Display)
 		return;
+	egl->Shared = shareEgl != NULL;
 	egl->Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 	ALOGV("eglInitialize(Display, &MajorVersion, &MinorVersion)");
 	eglInitialize(egl->Display, &egl->MajorVersion, &egl->MinorVersion);
@@ -204,7 +208,7 @@ static void ovrEgl_CreateContext(ovrEgl* egl, const ovrEgl* shareEgl) {
 	}
 }
 
-static void ovrEgl_DestroyContext(ovrEgl* egl) {
+void ovrEgl_DestroyContext(ovrEgl* egl) {
 	if (egl->Display) {
 		ALOGV("eglMakeCurrent(Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT)");
 		if (!eglMakeCurrent(egl->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT))
@@ -222,12 +226,12 @@ static void ovrEgl_DestroyContext(ovrEgl* egl) {
 			ALOGE("eglDestroySurface() failed: %s", EglErrorString(eglGetError()));
 		egl->TinySurface = EGL_NO_SURFACE;
 	}
-	if (egl->Display) {
+	if (egl->Display && !egl->Shared) {
 		ALOGV("eglTerminate(Display)");
 		if (!eglTerminate(egl->Display))
 			ALOGE("eglTerminate() failed: %s", EglErrorString(eglGetError()));
-		egl->Display = 0;
 	}
+	egl->Display = 0;
 }
 
 /*
@@ -446,6 +450,17 @@ ovrApp
 ================================================================================
 */
 
+#define MAX_LOADED_TEXTURES		64
+// levels up to this size are uploaded as a texture is loaded, the finer ones are streamed in a frame at a time
+#define TEXTURE_RESIDENT_SIZE	128
+#define TEXTURE_STREAM_BYTES	(1024 * 1024)
+
+// a texture managed code loaded, its file stays mapped until every level is resident
+typedef struct {
+	ovrKtxFile			File;
+	ovrKtxTexture		Texture;
+} ovrLoadedTexture;
+
 typedef struct {
 	ovrJava				Java;
 	ovrEgl				Egl;
@@ -463,8 +478,43 @@ typedef struct {
 	ovrLayer_Union2		Layers[ovrMaxLayerCount];
 	int					LayerCount;
 	ovrRenderer			Renderer;
+	ovrProgramCache		ProgramCache;
+	ovrTextureUploader	TextureUploader;
+	ovrFrameData		FrameData;				// shared with managed code
+	ovrGeometryHeap		GeometryHeap;
+	ovrCommandBuffer	Commands;				// written by managed code, executed after each managed frame
+	ovrJobQueue			Jobs;
+	ovrHostApi			HostApi;				// native functions for managed code
+	int					RequestedLayers;		// HOST_LAYER_* added to the next frame
+	ovrWatchdog			Watchdog;
+	ovrFrustum			CullFrustums[CULL_VIEWS];	// from the tracking sampled for the managed frame
+	ovrPoseHistory		PoseHistory;			// head and controllers of the last frames
+	ovrLoadedTexture	LoadedTextures[MAX_LOADED_TEXTURES];
+	int					LoadedTextureCount;
+	GLuint				UploadedTextures[MAX_COMMAND_TEXTURES];	// handed over by the uploader, deleted at shutdown
+	int					UploadedTextureCount;
 } ovrApp;
 
+// unit cube, as in VrCubeWorld
+static const ovrVertex CubeVertices[8] = {
+	{ { -0.5f, +0.5f, -0.5f }, { 255, 0, 255, 255 }, { 0.0f, 0.0f } },
+	{ { +0.5f, +0.5f, -0.5f }, { 0, 255, 0, 255 }, { 1.0f, 0.0f } },
+	{ { +0.5f, +0.5f, +0.5f }, { 0, 0, 255, 255 }, { 1.0f, 1.0f } },
+	{ { -0.5f, +0.5f, +0.5f }, { 255, 0, 0, 255 }, { 0.0f, 1.0f } },
+	{ { -0.5f, -0.5f, -0.5f }, { 0, 0, 255, 255 }, { 0.0f, 0.0f } },
+	{ { -0.5f, -0.5f, +0.5f }, { 0, 255, 0, 255 }, { 0.0f, 1.0f } },
+	{ { +0.5f, -0.5f, +0.5f }, { 255, 0, 255, 255 }, { 1.0f, 1.0f } },
+	{ { +0.5f, -0.5f, -0.5f }, { 255, 0, 0, 255 }, { 1.0f, 0.0f } }
+};
+static const unsigned short CubeIndices[36] = {
+	0, 2, 1, 2, 0, 3,	// top
+	4, 6, 5, 6, 4, 7,	// bottom
+	2, 6, 7, 7, 1, 2,	// right
+	0, 4, 5, 5, 3, 0,	// left
+	3, 5, 6, 6, 2, 3,	// front
+	0, 1, 7, 7, 4, 0	// back
+};
+
 static void ovrApp_Clear(ovrApp* app) {
 	app->Java.Vm = NULL;
 	app->Java.Env = NULL;
@@ -477,6 +527,9 @@ static void ovrApp_Clear(ovrApp* app) {
 	app->GpuLevel = 3;
 	app->MainThreadTid = 0;
 	app->RenderThreadTid = 0;
+	app->RequestedLayers = 0;
+	app->LoadedTextureCount = 0;
+	app->UploadedTextureCount = 0;
 	ovrEgl_Clear(&app->Egl);
 	ovrScene_Clear(&app->Scene);
 	ovrRenderer_Clear(&app->Renderer);
@@ -771,16 +824,29 @@ struct arg_dbl* ss;
 struct arg_int* cpu;
 struct arg_int* gpu;
 struct arg_int* msaa;
+struct arg_lit* jitstats;
+struct arg_lit* validate;
+struct arg_int* drawbench;
+struct arg_lit* hotreload;
+struct arg_lit* apibench;
+struct arg_int* watchdog;
+struct arg_lit* mathcheck;
+struct arg_lit* ktxcheck;
 struct arg_end* end;
 char** argv;
 int argc = 0;
 
 extern "C" void initialize_gl4es();
 
+// startup instrumentation, all vrapi_GetTimeInSeconds
+static double _createTime;
+static double _vrEnteredTime;
+
 static int ParseCommandLine(char* cmdline, char** argv);
 
 extern "C" JNIEXPORT jlong JNICALL Java_com_dotquest_quest_MainActivityJNI_onCreate(JNIEnv * env, jclass activityClass, jobject activity, jstring commandLineParams) {
 	ALOGV("::jni::onCreate()");
+	_createTime = vrapi_GetTimeInSeconds();
 
 	// the global arg_xxx structs are initialised within the argtable
 	void* argtable[] = {
@@ -788,6 +854,14 @@ extern "C" JNIEXPORT jlong JNICALL Java_com_dotquest_quest_MainActivityJNI_onCre
 		cpu = arg_int0("c", "cpu", "<int>", "CPU perf index 1-4 (default: 2)"),
 		gpu = arg_int0("g", "gpu", "<int>", "GPU perf index 1-4 (default: 3)"),
 		msaa = arg_int0("m", "msaa", "<int>", "MSAA (default: 1)"),
+		jitstats = arg_lit0(NULL, "jitstats", "log JIT counts per startup phase (read by the managed app)"),
+		validate = arg_lit0(NULL, "validate", "validate every managed command buffer before it is executed"),
+		drawbench = arg_int0(NULL, "drawbench", "<int>", "cubes drawn per frame through the command buffer (read by the managed app)"),
+		hotreload = arg_lit0(NULL, "hotreload", "reload the app assembly when a new build is copied to /sdcard/DotQuest"),
+		apibench = arg_lit0(NULL, "apibench", "log the cost of a host api call next to P/Invoke (read by the managed app)"),
+		watchdog = arg_int0(NULL, "watchdog", "<int>", "report a frame loop stalled this many ms, 0 disables (default: 3000)"),
+		mathcheck = arg_lit0(NULL, "mathcheck", "check the math routines against their references and time them at startup"),
+		ktxcheck = arg_lit0(NULL, "ktxcheck", "check the KTX2 loader against generated valid and broken files at startup"),
 		end = arg_end(20)
 	};
 
@@ -811,10 +885,19 @@ extern "C" JNIEXPORT jlong JNICALL Java_com_dotquest_quest_MainActivityJNI_onCre
 			GPU_LEVEL = gpu->ival[0];
 		if (msaa->count > 0 && msaa->ival[0] > 0 && msaa->ival[0] < 10)
 			NUM_MULTI_SAMPLES = msaa->ival[0];
+		VALIDATE_COMMANDS = validate->count > 0;
+		HOT_RELOAD = hotreload->count > 0;
+		MATH_CHECK = mathcheck->count > 0;
+		KTX_CHECK = ktxcheck->count > 0;
+		if (watchdog->count > 0 && watchdog->ival[0] >= 0)
+			WATCHDOG_MS = watchdog->ival[0];
 	}
 
 	initialize_gl4es();
 
+	// bring the runtime up while the app thread enters vr mode
+	dotnet_start_async("/sdcard/DotQuest/");
+
 	ovrAppThread* appThread = (ovrAppThread*)malloc(sizeof(ovrAppThread));
 	ovrAppThread_Create(appThread, env, activity, activityClass);
 	ovrMessageQueue_Enable(&appThread->MessageQueue, true);
@@ -949,6 +1032,8 @@ void AppProcessMessageQueue() {
 	for (;;) {
 		ovrMessage message;
 		const bool waitForMessages = !_appState.Ovr && !_destroyed;
+		if (waitForMessages)
+			ovrWatchdog_Suspend(&_appState.Watchdog);
 		if (!ovrMessageQueue_GetNextMessage(&_appThread->MessageQueue, &message, waitForMessages))
 			return;
 		switch (message.Id) {
@@ -977,7 +1062,7 @@ void AppIncrementFrameIndex() {
 	_appState.DisplayTime = vrapi_GetPredictedDisplayTime(_appState.Ovr, _appState.FrameIndex);
 }
 
-void AppShowLoadingIcon() {
+static void AppSubmitLoadingIcon(long long frameIndex, double displayTime) {
 	int frameFlags = 0;
 	frameFlags |= VRAPI_FRAME_FLAG_FLUSH;
 	ovrLayerProjection2 blackLayer = vrapi_DefaultLayerBlackProjection2();
@@ -988,25 +1073,286 @@ void AppShowLoadingIcon() {
 	ovrSubmitFrameDescription2 frameDesc = {};
 	frameDesc.Flags = frameFlags;
 	frameDesc.SwapInterval = 1;
+	frameDesc.FrameIndex = frameIndex;
+	frameDesc.DisplayTime = displayTime;
+	frameDesc.LayerCount = 2;
+	frameDesc.Layers = layers;
+	vrapi_SubmitFrame2(_appState.Ovr, &frameDesc);
+}
+
+void AppShowLoadingIcon() {
+	AppSubmitLoadingIcon(_appState.FrameIndex, _appState.DisplayTime);
+}
+
+static void AppApi_SubmitLayer(int layer) {
+	__atomic_fetch_or(&_appState.RequestedLayers, layer, __ATOMIC_RELAXED);
+}
+
+static void AppApi_GetFrameStats(ovrHostFrameStats* stats) {
+	stats->FrameIndex = _appState.FrameIndex;
+	stats->DisplayTime = _appState.DisplayTime;
+	stats->CommandFrames = _appState.Commands.Frames;
+	stats->CommandDraws = _appState.Commands.Draws;
+	stats->CommandSeconds = _appState.Commands.ExecuteSeconds;
+	stats->UploadedTextures = _appState.TextureUploader.Uploaded;
+	stats->UploadedBytes = _appState.TextureUploader.UploadedBytes;
+	stats->UploadSeconds = _appState.TextureUploader.UploadSeconds;
+	stats->JobsSubmitted = _appState.Jobs.Submitted;
+	stats->JobsRanInline = _appState.Jobs.RanInline;
+}
+
+static int AppApi_CullBoxes(int view, const float* mins, const float* maxs, int count, int* visible) {
+	if (view < 0 || view >= CULL_VIEWS)
+		return 0;
+	return ovrJobQueue_CullBoxes(&_appState.Jobs, &_appState.CullFrustums[view], (const vec3_t*)mins, (const vec3_t*)maxs, count, visible);
+}
+
+static int AppApi_CullSpheres(int view, const float* spheres, int count, int* visible) {
+	if (view < 0 || view >= CULL_VIEWS)
+		return 0;
+	return ovrJobQueue_CullSpheres(&_appState.Jobs, &_appState.CullFrustums[view], (const vec4_t*)spheres, count, visible);
+}
+
+static int AppApi_GetPose(int device, double time, ovrPoseSample* pose) {
+	return ovrPoseHistory_Get(&_appState.PoseHistory, device, time, pose);
+}
+
+static int AppApi_LoadTexture(const char* path) {
+	if (_appState.LoadedTextureCount == MAX_LOADED_TEXTURES || _appState.Commands.TextureCount == MAX_COMMAND_TEXTURES) {
+		ALOGE("LoadTexture: no handle left for %s", path);
+		return -1;
+	}
+	ovrLoadedTexture* loaded = &_appState.LoadedTextures[_appState.LoadedTextureCount];
+	if (!ovrKtxFile_Open(&loaded->File, path))
+		return -1;
+	// the coarsest level always, even when it is larger than the resident size
+	int residentLevels = 1;
+	for (int level = loaded->File.LevelCount - 2; level >= 0; level--, residentLevels++) {
+		if (loaded->File.Levels[level].Width > TEXTURE_RESIDENT_SIZE || loaded->File.Levels[level].Height > TEXTURE_RESIDENT_SIZE)
+			break;
+	}
+	if (!ovrKtxTexture_Create(&loaded->Texture, &loaded->File, residentLevels)) {
+		ovrKtxFile_Close(&loaded->File);
+		return -1;
+	}
+	if (loaded->Texture.BaseLevel == 0)
+		ovrKtxFile_Close(&loaded->File);
+	_appState.LoadedTextureCount++;
+	return ovrCommandBuffer_AddTexture(&_appState.Commands, loaded->Texture.Texture);
+}
+
+static void AppUpload_Release(ovrTextureImage* image) {
+	free((void*)image->Levels[0].Data);
+}
+
+// Poll calls this on the frame thread before the commands are executed, so the handle changes between frames.
+static void AppUpload_Ready(void* userData, GLuint texture) {
+	const int handle = (int)(intptr_t)userData;
+	if (!texture) {
+		ALOGE("UploadTexture: upload for handle %d failed, it stays white", handle);
+		return;
+	}
+	_appState.UploadedTextures[_appState.UploadedTextureCount++] = texture;
+	ovrCommandBuffer_ReplaceTexture(&_appState.Commands, handle, texture);
+}
+
+static int AppApi_UploadTexture(int width, int height, const void* pixels) {
+	if (width <= 0 || height <= 0 || width > 16384 || height > 16384 || !pixels)
+		return -1;
+	// white until the upload is ready; every upload takes a handle, so UploadedTextures cannot overflow
+	const int handle = ovrCommandBuffer_AddTexture(&_appState.Commands, _appState.Commands.WhiteTexture);
+	if (handle < 0) {
+		ALOGE("UploadTexture: no handle left for %dx%d", width, height);
+		return -1;
+	}
+	ovrTextureImage image;
+	memset(&image, 0, sizeof(image));
+	image.InternalFormat = GL_RGBA8;
+	image.Format = GL_RGBA;
+	image.Type = GL_UNSIGNED_BYTE;
+	image.LevelCount = 1;
+	image.Levels[0].Width = width;
+	image.Levels[0].Height = height;
+	image.Levels[0].Size = width * height * 4;
+	void* copy = malloc(image.Levels[0].Size);
+	memcpy(copy, pixels, image.Levels[0].Size);
+	image.Levels[0].Data = copy;
+	image.UserData = (void*)(intptr_t)handle;
+	image.Release = AppUpload_Release;
+	image.Ready = AppUpload_Ready;
+	if (!ovrTextureUploader_Submit(&_appState.TextureUploader, &image)) {
+		ALOGE("UploadTexture: the upload queue is full");
+		free(copy);
+		// nothing else was added since, hand the handle back
+		_appState.Commands.TextureCount--;
+		return -1;
+	}
+	return handle;
+}
+
+// Streams finer levels into the oldest loaded texture that still has some, one texture a frame.
+static void AppStreamTextures() {
+	for (int i = 0; i < _appState.LoadedTextureCount; i++) {
+		ovrLoadedTexture* loaded = &_appState.LoadedTextures[i];
+		if (!loaded->File.Mapping)
+			continue;
+		if (ovrKtxTexture_Stream(&loaded->Texture, &loaded->File, TEXTURE_STREAM_BYTES))
+			ovrKtxFile_Close(&loaded->File);
+		return;
+	}
+}
+
+void AppSubmitWorld(const ovrTracking2* tracking) {
+	ovrLayerProjection2 worldLayer = vrapi_DefaultLayerProjection2();
+	worldLayer.HeadPose = tracking->HeadPose;
+	for (int eye = 0; eye < VRAPI_FRAME_LAYER_EYE_MAX; eye++) {
+		const ovrFramebuffer* frameBuffer = &_appState.Renderer.FrameBuffer[_appState.Renderer.NumBuffers == 1 ? 0 : eye];
+		worldLayer.Textures[eye].ColorSwapChain = frameBuffer->ColorTextureSwapChain;
+		worldLayer.Textures[eye].SwapChainIndex = frameBuffer->ReadyTextureSwapChainIndex;
+		worldLayer.Textures[eye].TexCoordsFromTanAngles = ovrMatrix4f_TanAngleMatrixFromProjection(&_appState.Renderer.ProjectionMatrix);
+	}
+	worldLayer.Header.Flags |= VRAPI_FRAME_LAYER_FLAG_CHROMATIC_ABERRATION_CORRECTION;
+	ovrLayerLoadingIcon2 iconLayer = vrapi_DefaultLayerLoadingIcon2();
+	iconLayer.Header.Flags |= VRAPI_FRAME_LAYER_FLAG_INHIBIT_SRGB_FRAMEBUFFER;
+	const ovrLayerHeader2* layers[] = { &worldLayer.Header, &iconLayer.Header };
+	const int requestedLayers = __atomic_exchange_n(&_appState.RequestedLayers, 0, __ATOMIC_RELAXED);
+	ovrSubmitFrameDescription2 frameDesc = {};
+	frameDesc.Flags = 0;
+	frameDesc.SwapInterval = _appState.SwapInterval;
 	frameDesc.FrameIndex = _appState.FrameIndex;
 	frameDesc.DisplayTime = _appState.DisplayTime;
-	frameDesc.LayerCount = 2;
+	frameDesc.LayerCount = requestedLayers & HOST_LAYER_LOADING_ICON ? 2 : 1;
 	frameDesc.Layers = layers;
 	vrapi_SubmitFrame2(_appState.Ovr, &frameDesc);
 }
 
 void AppShutdownVR() {
+	ovrCommandBuffer_Report(&_appState.Commands);
+	ovrCommandBuffer_Destroy(&_appState.Commands);
+	for (int i = 0; i < _appState.LoadedTextureCount; i++) {
+		ovrKtxFile_Close(&_appState.LoadedTextures[i].File);
+		ovrKtxTexture_Destroy(&_appState.LoadedTextures[i].Texture);
+	}
+	if (_appState.UploadedTextureCount > 0) {
+		GL(glDeleteTextures(_appState.UploadedTextureCount, _appState.UploadedTextures));
+	}
+	ovrGeometryHeap_Destroy(&_appState.GeometryHeap);
+	ovrJobQueue_Destroy(&_appState.Jobs);
 	ovrRenderer_Destroy(&_appState.Renderer);
+	ovrTextureUploader_Destroy(&_appState.TextureUploader);
+	ovrProgramCache_Destroy(&_appState.ProgramCache);
 	ovrEgl_DestroyContext(&_appState.Egl);
 	_java.Vm->DetachCurrentThread();
 	vrapi_Shutdown();
 }
 
+// Keeps the compositor fed while the frame loop is stalled, called on the watchdog thread with its own context.
+// The frame index is the watchdog's, the loop's is only written by the loop.
+static void AppWatchdogCover(void* userData, long long* frameIndex, double* displayTime) {
+	if (!_appState.Ovr)
+		return;
+	(*frameIndex)++;
+	*displayTime = vrapi_GetPredictedDisplayTime(_appState.Ovr, *frameIndex);
+	AppSubmitLoadingIcon(*frameIndex, *displayTime);
+}
+
+static void AppLogJitStats(const dotnet_entry_points* dotnet, const char* phase) {
+	long long methods;
+	double milliseconds;
+	if (dotnet->get_jit_stats(&methods, &milliseconds))
+		ALOGI("JIT after %s: %lld methods, %.1f ms", phase, methods, milliseconds);
+}
+
 int AppMain(int argc, char* argv[]) {
-	for (int i = 0; i < 2; i++) {
-		ALOGV("APPMAIN: %d", i);
-		usleep(10);
+	const dotnet_entry_points* dotnet = dotnet_entry();
+	if (!dotnet) {
+		ALOGE("AppMain: the .NET host is not running");
+		return 1;
+	}
+	if (dotnet->attach_host_api(&_appState.HostApi, sizeof(ovrHostApi)))
+		ALOGE("AppMain: managed code rejected host api version %d", HOST_API_VERSION);
+	const int result = dotnet->initialize(argc, argv);
+	if (result) {
+		ALOGE("AppMain: managed initialize returned %d", result);
+		return result;
 	}
+	AppLogJitStats(dotnet, "initialize");
+	ovrFrameData_Init(&_appState.FrameData);
+	if (dotnet->attach_frame_data(&_appState.FrameData, sizeof(ovrFrameData)))
+		ALOGE("AppMain: managed code rejected frame data version %d", FRAME_DATA_VERSION);
+	if (dotnet->attach_command_buffer(_appState.Commands.Data, _appState.Commands.Capacity))
+		ALOGE("AppMain: managed code rejected the command buffer");
+	// the loading layer is kept up until managed code writes its first commands
+	bool firstFrame = true;
+	double firstFrameTime = 0.0;
+	bool settled = false;
+	ovrFrameData frame;
+	ovrFrameData_Init(&frame);
+	if (HOT_RELOAD)
+		dotnet_watch("/sdcard/DotQuest/");
+	ovrWatchdog_Create(&_appState.Watchdog, WATCHDOG_MS, &_appState.Egl, AppWatchdogCover, NULL);
+	double frameStart = vrapi_GetTimeInSeconds();
+	while (!_destroyed) {
+		ovrWatchdog_Heartbeat(&_appState.Watchdog, &_appState.FrameIndex, &_appState.DisplayTime);
+		AppProcessMessageQueue();
+		if (dotnet_reload_pending()) {
+			// between frames: the vr session, egl context and swapchains are untouched, the loading layer covers the stall
+			AppIncrementFrameIndex();
+			AppShowLoadingIcon();
+			const double reloadStart = vrapi_GetTimeInSeconds();
+			const int leaked = dotnet->reload();
+			ALOGI("Hot reload: %.1f ms, %d leaked contexts", (vrapi_GetTimeInSeconds() - reloadStart) * 1000.0, leaked);
+			ovrWatchdog_Heartbeat(&_appState.Watchdog, &_appState.FrameIndex, &_appState.DisplayTime);
+			frameStart = vrapi_GetTimeInSeconds();
+		}
+		AppIncrementFrameIndex();
+		const double sampleTime = vrapi_GetTimeInSeconds();
+		frame.FrameSeconds = (float)(sampleTime - frameStart);
+		frameStart = sampleTime;
+		ovrTracking2 frameTracking;
+		ovrFrameData_Sample(&frame, _appState.Ovr, _appState.FrameIndex, _appState.DisplayTime, &frameTracking, &_appState.PoseHistory);
+		ovrFrustum_FromTracking(_appState.CullFrustums, &frameTracking, &_appState.Renderer.ProjectionMatrix);
+		ovrFrameData_Publish(&_appState.FrameData, &frame);
+		// pauses are logged next to the frame index and the previous frame time, to match them up with dropped frames
+		dotnet_gc_pause pause;
+		if (dotnet->safe_point(_appState.FrameIndex, &pause) > 0)
+			ALOGI("GC before frame %lld: %d collections up to gen%d, %.2f ms paused, previous frame %.2f ms",
+				_appState.FrameIndex, pause.collections, pause.generation, pause.milliseconds, frame.FrameSeconds * 1000.0f);
+		const int commandBytes = dotnet->frame(_appState.FrameIndex, _appState.DisplayTime);
+		frame.ManagedSeconds = (float)(vrapi_GetTimeInSeconds() - sampleTime);
+		if (firstFrame) {
+			firstFrame = false;
+			const dotnet_startup_times* startup = dotnet_startup();
+			ALOGI("Startup: vr entered %.1f ms, first managed frame %.1f ms after onCreate (hostfxr %.1f ms, runtime %.1f ms, entry points %.1f ms, plugins %.1f ms)",
+				(_vrEnteredTime - _createTime) * 1000.0, (vrapi_GetTimeInSeconds() - _createTime) * 1000.0,
+				startup->load_hostfxr * 1000.0, startup->initialize_runtime * 1000.0, startup->resolve_entry_points * 1000.0,
+				startup->plugins * 1000.0);
+			AppLogJitStats(dotnet, "first frame");
+			firstFrameTime = vrapi_GetTimeInSeconds();
+		}
+		else if (!settled && vrapi_GetTimeInSeconds() - firstFrameTime > 10.0) {
+			settled = true;
+			AppLogJitStats(dotnet, "10 seconds");
+			ovrCommandBuffer_Report(&_appState.Commands);
+		}
+		ovrTextureUploader_Poll(&_appState.TextureUploader, 4);
+		AppStreamTextures();
+		ovrGeometryHeap_BeginFrame(&_appState.GeometryHeap);
+		// rendered with the tracking managed code saw and culled against, not a newer prediction
+		const bool rendered = ovrCommandBuffer_Execute(&_appState.Commands, commandBytes, &_appState.Renderer, &frameTracking);
+		ovrGeometryHeap_EndFrame(&_appState.GeometryHeap);
+		// the watchdog submitted frames of its own while this one was stalled
+		if (ovrWatchdog_Heartbeat(&_appState.Watchdog, &_appState.FrameIndex, &_appState.DisplayTime))
+			AppIncrementFrameIndex();
+		if (rendered)
+			AppSubmitWorld(&frameTracking);
+		else
+			AppShowLoadingIcon();
+		// the first frame is on its way, plugins nothing at startup depends on can come up now
+		dotnet_start_deferred_plugins();
+	}
+	dotnet->shutdown();
+	ovrWatchdog_Destroy(&_appState.Watchdog);
 	return 0;
 }
 
@@ -1044,6 +1390,31 @@ void* AppThreadFunction(void* parm) {
 	ovrEgl_CreateContext(&_appState.Egl, NULL);
 	EglInitExtensions();
 
+	// rebuild stale program binaries while vr mode is entered
+	ovrProgramCache_Create(&_appState.ProgramCache, "/sdcard/DotQuest/Programs");
+	const ovrProgramSource programs[] = { ovrDrawBatcher_DefaultProgram, ovrCommandBuffer_DefaultProgram };
+	ovrProgramCache_Precompile(&_appState.ProgramCache, &_appState.Egl, programs, sizeof(programs) / sizeof(programs[0]));
+
+	// textures are uploaded on their own shared context so large loads never stall a frame
+	ovrTextureUploader_Create(&_appState.TextureUploader, &_appState.Egl, 4 * 1024 * 1024);
+
+	// the native functions managed code can call
+	ovrJobQueue_Create(&_appState.Jobs);
+	ovrHostApi_Init(&_appState.HostApi, &_appState.Jobs);
+	_appState.HostApi.SubmitLayer = AppApi_SubmitLayer;
+	_appState.HostApi.GetFrameStats = AppApi_GetFrameStats;
+	_appState.HostApi.CullBoxes = AppApi_CullBoxes;
+	_appState.HostApi.CullSpheres = AppApi_CullSpheres;
+	ovrPoseHistory_Init(&_appState.PoseHistory);
+	_appState.HostApi.GetPose = AppApi_GetPose;
+	_appState.HostApi.LoadTexture = AppApi_LoadTexture;
+	_appState.HostApi.UploadTexture = AppApi_UploadTexture;
+
+	if (MATH_CHECK && !MathCheck_Run(&_appState.Jobs, NULL))
+		ALOGE("Math check failed");
+	if (KTX_CHECK && !KtxCheck_Run("/sdcard/DotQuest"))
+		ALOGE("KTX check failed");
+
 	// first handle any messages in the queue
 	while (!_appState.Ovr)
 		AppProcessMessageQueue();
@@ -1055,12 +1426,22 @@ void* AppThreadFunction(void* parm) {
 	// create the scene if not yet created.
 	ovrScene_Create(vr.width, vr.height, &_appState.Scene, &_java);
 
+	// managed code draws through handles, mesh 0 is a unit cube
+	ovrCommandBuffer_Create(&_appState.Commands, &_appState.ProgramCache, 1024 * 1024, VALIDATE_COMMANDS);
+	ovrGeometryHeap_Create(&_appState.GeometryHeap, 65536, 196608, 4096, 12288);
+	ovrMesh cube;
+	if (ovrGeometryHeap_Upload(&_appState.GeometryHeap, CubeVertices, 8, CubeIndices, 36, &cube))
+		ovrCommandBuffer_AddMesh(&_appState.Commands, &cube);
+
 	chdir("/sdcard/DotQuest");
 
-	// run loading loop until we are initialized
-	while (!_destroyed && !vr.initialized) {
+	_vrEnteredTime = vrapi_GetTimeInSeconds();
+
+	// run loading loop until we are initialized and the runtime is up, submitting keeps the vsync cadence
+	while (!_destroyed && (!vr.initialized || !dotnet_ready())) {
 		AppProcessMessageQueue();
 		AppIncrementFrameIndex();
+		ovrTextureUploader_Poll(&_appState.TextureUploader, 4);
 		AppShowLoadingIcon();
 	}
 
@@ -1079,8 +1460,14 @@ void* AppThreadFunction(void* parm) {
 		maximumSupportedFramerate = 90.0;
 	}
 
+	ovrProgramCache_Report(&_appState.ProgramCache);
+	ovrTextureUploader_Report(&_appState.TextureUploader);
+
 	// start
-	AppMain(argc, argv);
+	if (dotnet_entry())
+		AppMain(argc, argv);
+	else
+		ALOGE("The .NET runtime failed to start");
 
 	// we are done, shutdown cleanly
 	AppShutdownVR();
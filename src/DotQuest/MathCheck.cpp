@@ -0,0 +1,1579 @@
+#include "MathCheck.h"
+#include "lib/Math.h"
+#include "Culling.h"
+#include "VrApi_Helpers.h"
+#include <float.h>
+#include <limits.h>
+#include <time.h>
+
+/*
+================================================================================
+MathCheck
+================================================================================
+*/
+
+#define MATH_CHECK_INPUTS		1024
+#define MATH_CHECK_SECONDS		0.1
+#define MATH_CHECK_POINTS		65536
+#define MATH_CHECK_MATRICES		8192
+#define MATH_CHECK_ANGLES		65536
+#define MATH_CHECK_BONES		16384
+#define MATH_CHECK_HALVES		262144
+#define MATH_CHECK_BOUNDS		65536
+// a dot product of n terms rounded at every step is within about n epsilon of the exact sum of the term magnitudes
+#define MATH_CHECK_TOLERANCE	(4.0f * FLT_EPSILON)
+// sin and cos of a float angle carry its rounding, up to pi epsilon near +-pi, and the products of three add up
+#define MATH_CHECK_TRIG_TOLERANCE	(16.0f * FLT_EPSILON)
+
+typedef struct {
+	const char*		Name;
+	int				SizeA;				// floats per input
+	int				SizeB;
+	int				SizeOut;			// floats checked per output
+	void			(*Run)(const float* a, const float* b, float* out);
+	// plain loops in the scalar summation order, or double precision from the formula; magnitude, if not NULL,
+	// receives what the error of each output scales with, the sum of |term| for a sum, 0 where it must be exact
+	void			(*Reference)(const float* a, const float* b, float* out, float* magnitude);
+	float			Tolerance;			// error allowed per unit of magnitude, MATH_CHECK_TOLERANCE if 0
+	// reshapes the random inputs into the quaternions, transforms or angles in degrees a routine expects
+	void			(*Input)(float* a, float* b, int index);
+} ovrMathCase;
+
+static double MathCheck_Time() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// xorshift, so every run checks the same inputs
+static float MathCheck_Random(unsigned int* state) {
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (x & 0xffffff) * (4.0f / 0xffffff) - 2.0f;
+}
+
+static long long MathCheck_Ulps(float a, float b) {
+	int ia, ib;
+	memcpy(&ia, &a, sizeof(ia));
+	memcpy(&ib, &b, sizeof(ib));
+	// map the sign magnitude floats onto one ordered integer line
+	long long la = ia < 0 ? (long long)INT_MIN - ia : ia;
+	long long lb = ib < 0 ? (long long)INT_MIN - ib : ib;
+	return la > lb ? la - lb : lb - la;
+}
+
+// out = m1 * m2 over rows x 4 outputs, inner terms per output; with 3 inner terms the missing row of m2 is (0, 0, 0, 1)
+static void MathCheck_Concat(const float* m1, const float* m2, float* out, float* magnitude, int rows, int inner) {
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < 4; j++) {
+			float sum = 0.0f, size = 0.0f;
+			for (int k = 0; k < inner; k++) {
+				sum += m1[i * 4 + k] * m2[k * 4 + j];
+				size += fabsf(m1[i * 4 + k] * m2[k * 4 + j]);
+			}
+			if (inner == 3 && j == 3) {
+				sum += m1[i * 4 + 3];
+				size += fabsf(m1[i * 4 + 3]);
+			}
+			out[i * 4 + j] = sum;
+			if (magnitude)
+				magnitude[i * 4 + j] = size;
+		}
+}
+
+static void MathCheck_Transform(const float* m, const float* v, float* out, float* magnitude) {
+	for (int i = 0; i < 3; i++) {
+		float sum = 0.0f, size = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			sum += v[k] * m[i * 4 + k];
+			size += fabsf(v[k] * m[i * 4 + k]);
+		}
+		out[i] = sum + m[i * 4 + 3];
+		if (magnitude)
+			magnitude[i] = size + fabsf(m[i * 4 + 3]);
+	}
+}
+
+// The vector helpers as they were written out before they became wrappers over MathVec.h, in the same order, so
+// the wrappers should match them exactly and time no slower.
+static void MathCheck_Cross(const float* a, const float* b, float* out, float* magnitude) {
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+	if (magnitude)
+		for (int i = 0; i < 3; i++)
+			magnitude[i] = fabsf(a[(i + 1) % 3] * b[(i + 2) % 3]) + fabsf(a[(i + 2) % 3] * b[(i + 1) % 3]);
+}
+
+static void MathCheck_Norm(const float* a, float* out) {
+	float l = (float)sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+	if (l) l = 1.0f / l;
+	out[0] = a[0] * l;
+	out[1] = a[1] * l;
+	out[2] = a[2] * l;
+}
+
+static void MathCheck_VectorsVectors(const float* a, const float* b, float* out, float* magnitude) {
+	float* right = out;
+	right[0] = a[2];
+	right[1] = -a[0];
+	right[2] = a[1];
+	const float d = a[0] * right[0] + a[1] * right[1] + a[2] * right[2];
+	for (int i = 0; i < 3; i++)
+		right[i] = right[i] + a[i] * -d;
+	MathCheck_Norm(right, right);
+	MathCheck_Cross(right, a, out + 3, magnitude ? magnitude + 3 : NULL);
+	if (magnitude)
+		for (int i = 0; i < 3; i++)
+			magnitude[i] = 1.0f;
+}
+
+static const double MathCheck_Pi = 3.14159265358979323846;
+
+// Inputs for the routines that want more than random floats, built from the random values already in place.
+
+static void MathCheck_Quaternion(float* q) {
+	const float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	for (int i = 0; i < 4; i++)
+		q[i] /= length;
+}
+
+// every fourth set of angles is left without roll, then without pitch or without any angle, for the shortcuts
+// CreateFromEntity takes
+static void MathCheck_EntityAngles(float* a, float* b, int index) {
+	for (int i = 0; i < 3; i++)
+		a[i] *= 90.0f;
+	if (index % 4 >= 1)
+		a[M_ROLL] = 0.0f;
+	if (index % 4 >= 2)
+		a[M_PITCH] = 0.0f;
+	if (index % 4 == 3)
+		a[M_YAW] = 0.0f;
+}
+
+// a rotation scaled by 0.5 to 1.5 and moved up to 2 away, from the first 8 random values; the 4 row one ends in 0 0 0 1
+static void MathCheck_Similarity(float* m, int rows) {
+	vec4_t q;
+	vec3_t origin;
+	Math_Vector4Cpy(m, q);
+	Math_Vector3Cpy(m + 4, origin);
+	const float scale = 1.0f + m[7] * 0.25f;
+	MathCheck_Quaternion(q);
+	matrix4x4 t;
+	Math::Matrix4x4_FromOriginQuat(t, q, origin);
+	for (int i = 0; i < 3; i++)
+		for (int j = 0; j < 3; j++)
+			t[i][j] *= scale;
+	memcpy(m, t, rows * 4 * sizeof(float));
+}
+
+static void MathCheck_SortBounds(float* mins, float* maxs) {
+	for (int i = 0; i < 3; i++)
+		if (mins[i] > maxs[i]) {
+			const float swap = mins[i];
+			mins[i] = maxs[i];
+			maxs[i] = swap;
+		}
+}
+
+// The references below are written out in double precision from the formulas, not from the code under test,
+// with magnitude set to what their float error scales with.
+
+// the rotation CreateFromEntity builds from pitch, yaw and roll in degrees
+static void MathCheck_EntityRotation(const float* angles, double m[3][3]) {
+	const double y = angles[M_YAW] * (MathCheck_Pi / 180.0), p = angles[M_PITCH] * (MathCheck_Pi / 180.0), r = angles[M_ROLL] * (MathCheck_Pi / 180.0);
+	const double sy = sin(y), cy = cos(y), sp = sin(p), cp = cos(p), sr = sin(r), cr = cos(r);
+	m[0][0] = cp * cy;
+	m[0][1] = sr * sp * cy - cr * sy;
+	m[0][2] = cr * sp * cy + sr * sy;
+	m[1][0] = cp * sy;
+	m[1][1] = sr * sp * sy + cr * cy;
+	m[1][2] = cr * sp * sy - sr * cy;
+	m[2][0] = -sp;
+	m[2][1] = sr * cp;
+	m[2][2] = cr * cp;
+}
+
+// a holds the angles, b the origin and the scale
+static void MathCheck_CreateFromEntity(const float* a, const float* b, float* out, float* magnitude, int rows) {
+	double m[3][3];
+	MathCheck_EntityRotation(a, m);
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < 4; j++) {
+			out[i * 4 + j] = i == 3 ? (j == 3 ? 1.0f : 0.0f) : j == 3 ? b[i] : (float)(m[i][j] * b[3]);
+			if (magnitude)
+				magnitude[i * 4 + j] = i < 3 && j < 3 ? fabsf(b[3]) : 0.0f;
+		}
+}
+
+static void MathCheck_AnglesVectors(const float* a, const float* b, float* out, float* magnitude) {
+	double m[3][3];
+	MathCheck_EntityRotation(a, m);
+	// forward and up are columns of the entity rotation, right is the middle one negated
+	for (int i = 0; i < 3; i++) {
+		out[i] = (float)m[i][0];
+		out[3 + i] = (float)-m[i][1];
+		out[6 + i] = (float)m[i][2];
+	}
+	if (magnitude)
+		for (int i = 0; i < 9; i++)
+			magnitude[i] = 1.0f;
+}
+
+// a holds the quaternion, b the origin
+static void MathCheck_FromOriginQuat(const float* a, const float* b, float* out, float* magnitude, int rows) {
+	const double x = a[0], y = a[1], z = a[2], w = a[3];
+	const double m[3][3] = {
+		{ 1.0 - 2.0 * y * y - 2.0 * z * z, 2.0 * x * y - 2.0 * w * z, 2.0 * x * z + 2.0 * w * y },
+		{ 2.0 * x * y + 2.0 * w * z, 1.0 - 2.0 * x * x - 2.0 * z * z, 2.0 * y * z - 2.0 * w * x },
+		{ 2.0 * x * z - 2.0 * w * y, 2.0 * y * z + 2.0 * w * x, 1.0 - 2.0 * x * x - 2.0 * y * y },
+	};
+	const double size[3][3] = {
+		{ 1.0 + 2.0 * y * y + 2.0 * z * z, 2.0 * fabs(x * y) + 2.0 * fabs(w * z), 2.0 * fabs(x * z) + 2.0 * fabs(w * y) },
+		{ 2.0 * fabs(x * y) + 2.0 * fabs(w * z), 1.0 + 2.0 * x * x + 2.0 * z * z, 2.0 * fabs(y * z) + 2.0 * fabs(w * x) },
+		{ 2.0 * fabs(x * z) + 2.0 * fabs(w * y), 2.0 * fabs(y * z) + 2.0 * fabs(w * x), 1.0 + 2.0 * x * x + 2.0 * y * y },
+	};
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < 4; j++) {
+			out[i * 4 + j] = i == 3 ? (j == 3 ? 1.0f : 0.0f) : j == 3 ? b[i] : (float)m[i][j];
+			if (magnitude)
+				magnitude[i * 4 + j] = i < 3 && j < 3 ? (float)size[i][j] : 0.0f;
+		}
+}
+
+// Gauss-Jordan with partial pivoting; false if m is singular
+static bool MathCheck_Invert(const float* m, double inverse[4][4]) {
+	double r[4][8];
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 8; j++)
+			r[i][j] = j < 4 ? m[i * 4 + j] : j - 4 == i ? 1.0 : 0.0;
+	for (int c = 0; c < 4; c++) {
+		int pivot = c;
+		for (int i = c + 1; i < 4; i++)
+			if (fabs(r[i][c]) > fabs(r[pivot][c]))
+				pivot = i;
+		if (r[pivot][c] == 0.0)
+			return false;
+		for (int j = 0; j < 8; j++) {
+			const double swap = r[c][j];
+			r[c][j] = r[pivot][j];
+			r[pivot][j] = swap;
+		}
+		const double scale = 1.0 / r[c][c];
+		for (int j = 0; j < 8; j++)
+			r[c][j] *= scale;
+		for (int i = 0; i < 4; i++)
+			if (i != c) {
+				const double f = r[i][c];
+				for (int j = 0; j < 8; j++)
+					r[i][j] -= f * r[c][j];
+			}
+	}
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			inverse[i][j] = r[i][j + 4];
+	return true;
+}
+
+// Gaussian elimination in float loses about the condition number times epsilon, relative to the largest entry
+static void MathCheck_InvertFull(const float* a, const float* b, float* out, float* magnitude) {
+	double inverse[4][4];
+	MathCheck_Invert(a, inverse);
+	double norm = 0.0, inverseNorm = 0.0, largest = 0.0;
+	for (int i = 0; i < 4; i++) {
+		double row = 0.0, inverseRow = 0.0;
+		for (int j = 0; j < 4; j++) {
+			row += fabs(a[i * 4 + j]);
+			inverseRow += fabs(inverse[i][j]);
+			if (fabs(inverse[i][j]) > largest)
+				largest = fabs(inverse[i][j]);
+			out[i * 4 + j] = (float)inverse[i][j];
+		}
+		norm = row > norm ? row : norm;
+		inverseNorm = inverseRow > inverseNorm ? inverseRow : inverseNorm;
+	}
+	if (magnitude)
+		for (int i = 0; i < 16; i++)
+			magnitude[i] = (float)(norm * inverseNorm * largest);
+}
+
+// InvertSimple takes the scale of all rows from the first, which the float input only matches to its rounding, so
+// its error bound is twice that of a sum
+static void MathCheck_InvertSimple(const float* a, const float* b, float* out, float* magnitude, int rows) {
+	const float m[16] = { a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], a[10], a[11], 0.0f, 0.0f, 0.0f, 1.0f };
+	double inverse[4][4];
+	MathCheck_Invert(m, inverse);
+	const double scale = sqrt((double)a[0] * a[0] + (double)a[1] * a[1] + (double)a[2] * a[2]);
+	const double origin = fabs(a[3]) + fabs(a[7]) + fabs(a[11]);
+	for (int i = 0; i < rows * 4; i++) {
+		out[i] = (float)inverse[i / 4][i % 4];
+		if (magnitude)
+			magnitude[i] = i >= 12 ? 0.0f : (float)((i % 4 == 3 ? origin : 1.0) / scale);
+	}
+}
+
+// a holds the transform, b the normal and distance; standard planes subtract the moved origin, positive ones add it
+static void MathCheck_TransformPlane(const float* a, const float* b, float* out, float* magnitude, double sign) {
+	const double scale = sqrt((double)a[0] * a[0] + (double)a[1] * a[1] + (double)a[2] * a[2]);
+	double dist = b[3] * scale, size = fabs(b[3]) * scale;
+	for (int i = 0; i < 3; i++) {
+		const double normal = (b[0] * (double)a[i * 4] + b[1] * (double)a[i * 4 + 1] + b[2] * (double)a[i * 4 + 2]) / scale;
+		out[i] = (float)normal;
+		dist += sign * normal * a[i * 4 + 3];
+		size += fabs(normal * a[i * 4 + 3]);
+		if (magnitude)
+			magnitude[i] = 2.0f;
+	}
+	out[3] = (float)dist;
+	if (magnitude)
+		magnitude[3] = (float)size;
+}
+
+// m * v without the translation, or the transpose of m times v, less the translation when inverse translates
+static void MathCheck_Rotate(const float* m, const float* v, float* out, float* magnitude, bool inverse, bool translate) {
+	float dir[3], dirSize[3];
+	for (int k = 0; k < 3; k++) {
+		dir[k] = translate ? v[k] - m[k * 4 + 3] : v[k];
+		dirSize[k] = translate ? fabsf(v[k]) + fabsf(m[k * 4 + 3]) : fabsf(v[k]);
+	}
+	for (int i = 0; i < 3; i++) {
+		float sum = 0.0f, size = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			const float e = inverse ? m[k * 4 + i] : m[i * 4 + k];
+			sum += dir[k] * e;
+			size += dirSize[k] * fabsf(e);
+		}
+		out[i] = sum;
+		if (magnitude)
+			magnitude[i] = size;
+	}
+}
+
+static void MathCheck_ConvertToEntity(const float* a, const float* b, float* out, float* magnitude) {
+	const double xyDist = sqrt((double)a[0] * a[0] + (double)a[4] * a[4]);
+	const double toDegrees = 180.0 / MathCheck_Pi;
+	out[0] = (float)(atan2(-a[8], xyDist) * toDegrees);
+	out[1] = (float)(xyDist > 0.001 ? atan2(a[4], a[0]) * toDegrees : atan2(-a[1], a[5]) * toDegrees);
+	out[2] = (float)(xyDist > 0.001 ? atan2(a[9], a[10]) * toDegrees : 0.0);
+	for (int i = 0; i < 3; i++) {
+		out[3 + i] = a[i * 4 + 3];
+		if (magnitude) {
+			magnitude[i] = 180.0f;
+			magnitude[3 + i] = 0.0f;
+		}
+	}
+}
+
+// a holds p, b q and the weight
+static void MathCheck_Slerp(const float* a, const float* b, float* out, float* magnitude) {
+	double p[4], q[4], cosom = 0.0;
+	for (int i = 0; i < 4; i++) {
+		p[i] = a[i];
+		q[i] = b[i];
+		cosom += p[i] * q[i];
+	}
+	// the shorter arc
+	if (cosom < 0.0) {
+		for (int i = 0; i < 4; i++)
+			q[i] = -q[i];
+		cosom = -cosom;
+	}
+	const double omega = acos(cosom > 1.0 ? 1.0 : cosom), t = b[4];
+	const double sclp = omega ? sin((1.0 - t) * omega) / sin(omega) : 1.0 - t;
+	const double sclq = omega ? sin(t * omega) / sin(omega) : t;
+	for (int i = 0; i < 4; i++) {
+		out[i] = (float)(sclp * p[i] + sclq * q[i]);
+		if (magnitude)
+			magnitude[i] = 1.0f;
+	}
+}
+
+// the error of (d - c) * (value - a) / (b - a) grows with the operands of each subtraction against its result
+static void MathCheck_RangeRemap(const float* a, const float* b, float* out, float* magnitude) {
+	const double range = (double)a[2] - a[1];
+	const double scaled = ((double)a[4] - a[3]) * ((double)a[0] - a[1]) / range;
+	out[0] = (float)(a[3] + scaled);
+	if (magnitude)
+		magnitude[0] = (float)(fabs(a[3]) + (fabs(a[4]) + fabs(a[3])) * (fabs(a[0]) + fabs(a[1])) * (fabs(a[2]) + fabs(a[1])) / (range * range));
+}
+
+static void MathCheck_Vector3Angles(const float* a, const float* b, float* out, float* magnitude) {
+	const double toDegrees = 180.0 / MathCheck_Pi;
+	double yaw = atan2((double)a[1], (double)a[0]) * toDegrees;
+	double pitch = atan2((double)a[2], sqrt((double)a[0] * a[0] + (double)a[1] * a[1])) * toDegrees;
+	if (yaw < 0.0)
+		yaw += 360.0;
+	if (pitch < 0.0)
+		pitch += 360.0;
+	out[0] = (float)pitch;
+	out[1] = (float)yaw;
+	out[2] = 0.0f;
+	if (magnitude) {
+		magnitude[0] = magnitude[1] = 360.0f;
+		magnitude[2] = 0.0f;
+	}
+}
+
+// a holds forward, right and up
+static void MathCheck_VectorsAngles(const float* a, const float* b, float* out, float* magnitude) {
+	const double toDegrees = 180.0 / MathCheck_Pi;
+	const double pitch = -asin((double)a[2]);
+	if (fabs(cos(pitch)) > EQUAL_EPSILON) {
+		out[M_PITCH] = (float)(pitch * toDegrees);
+		out[M_YAW] = (float)(atan2((double)a[1], (double)a[0]) * toDegrees);
+		out[M_ROLL] = (float)(atan2(-(double)a[5], (double)a[8]) * toDegrees);
+	}
+	else {
+		out[M_PITCH] = a[2] > 0.0f ? -90.0f : 90.0f;
+		out[M_YAW] = (float)(atan2((double)a[3], -(double)a[4]) * toDegrees);
+		out[M_ROLL] = 180.0f;
+	}
+	if (magnitude)
+		for (int i = 0; i < 3; i++)
+			magnitude[i] = 180.0f;
+}
+
+// sines then cosines of the first count angles
+static void MathCheck_SinCosRef(const float* a, float* out, float* magnitude, int count, bool cosines) {
+	for (int i = 0; i < count; i++) {
+		out[i] = (float)sin((double)a[i]);
+		if (cosines)
+			out[count + i] = (float)cos((double)a[i]);
+	}
+	if (magnitude)
+		for (int i = 0; i < count * 2; i++)
+			magnitude[i] = 1.0f;
+}
+
+// the Vec core folds at compile time
+static_assert(Vec_Dot(Vec3(1.0f, 2.0f, 3.0f), Vec3(4.0f, 5.0f, 6.0f)) == 32.0f, "Vec_Dot");
+static_assert(Vec_Cross(Vec3(1.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)) == Vec3(0.0f, 0.0f, 1.0f), "Vec_Cross");
+static_assert(Mat_ConcatTransforms(Mat<3, 4>::Identity(), Mat<3, 4>::Identity())[2][2] == 1.0f, "Mat_ConcatTransforms");
+static_assert(sizeof(Vec<3>) == 16 && alignof(Vec<3>) == 16 && sizeof(Mat<3, 4>) == sizeof(matrix3x4), "Vec layout");
+
+static const ovrMathCase MathCases[] = {
+	{ "Matrix3x4_ConcatTransforms", 12, 12, 12,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_ConcatTransforms((vec4_t*)out, (vec4_t*)a, (vec4_t*)b); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Concat(a, b, out, magnitude, 3, 3); } },
+	{ "Matrix4x4_ConcatTransforms", 16, 16, 12,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_ConcatTransforms((vec4_t*)out, (vec4_t*)a, (vec4_t*)b); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Concat(a, b, out, magnitude, 3, 3); } },
+	{ "Matrix4x4_Concat", 16, 16, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_Concat((vec4_t*)out, (const vec4_t*)a, (const vec4_t*)b); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Concat(a, b, out, magnitude, 4, 4); } },
+	{ "Matrix3x4_VectorTransform", 12, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_VectorTransform((vec4_t*)a, b, out); },
+		MathCheck_Transform },
+	{ "Matrix4x4_VectorTransform", 16, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_VectorTransform((vec4_t*)a, b, out); },
+		MathCheck_Transform },
+	{ "Math_CrossProduct", 3, 3, 3,
+		[](const float* a, const float* b, float* out) { Math_CrossProduct(a, b, out); },
+		MathCheck_Cross },
+	{ "Math_Vector3MA", 3, 4, 3,
+		[](const float* a, const float* b, float* out) { Math_Vector3MA(a, b[3], b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 3; i++) {
+				out[i] = a[i] + b[i] * b[3];
+				if (magnitude)
+					magnitude[i] = fabsf(a[i]) + fabsf(b[i] * b[3]);
+			} } },
+	{ "Math_Vector3Norm", 3, 0, 3,
+		[](const float* a, const float* b, float* out) { Math_Vector3Cpy(a, out); Math_Vector3Norm(out); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			MathCheck_Norm(a, out);
+			if (magnitude)
+				magnitude[0] = magnitude[1] = magnitude[2] = 1.0f; } },
+	{ "VectorsVectors", 3, 0, 6,
+		[](const float* a, const float* b, float* out) { Math::VectorsVectors(a, out, out + 3); },
+		MathCheck_VectorsVectors },
+	{ "Matrix3x4_VectorRotate", 12, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_VectorRotate((vec4_t*)a, b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Rotate(a, b, out, magnitude, false, false); } },
+	{ "Matrix3x4_VectorIRotate", 12, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_VectorIRotate((vec4_t*)a, b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Rotate(a, b, out, magnitude, true, false); } },
+	{ "Matrix3x4_VectorITransform", 12, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_VectorITransform((vec4_t*)a, b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Rotate(a, b, out, magnitude, true, true); } },
+	{ "Matrix4x4_VectorRotate", 16, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_VectorRotate((vec4_t*)a, b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Rotate(a, b, out, magnitude, false, false); } },
+	{ "Matrix4x4_VectorIRotate", 16, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_VectorIRotate((vec4_t*)a, b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Rotate(a, b, out, magnitude, true, false); } },
+	{ "Matrix4x4_VectorITransform", 16, 3, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_VectorITransform((vec4_t*)a, b, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Rotate(a, b, out, magnitude, true, true); } },
+	{ "Matrix4x4_ConcatTransformsBatch", 16, 16, 12,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_ConcatTransformsBatch((matrix4x4*)out, (const matrix4x4*)a, (const matrix4x4*)b, 1); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_Concat(a, b, out, magnitude, 3, 3); } },
+
+	// construction and inversion
+	{ "Matrix3x4_CreateFromEntity", 3, 4, 12,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_CreateFromEntity((vec4_t*)out, a, b, b[3]); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_CreateFromEntity(a, b, out, magnitude, 3); },
+		MATH_CHECK_TRIG_TOLERANCE, MathCheck_EntityAngles },
+	{ "Matrix4x4_CreateFromEntity", 3, 4, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_CreateFromEntity((vec4_t*)out, a, b, b[3]); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_CreateFromEntity(a, b, out, magnitude, 4); },
+		MATH_CHECK_TRIG_TOLERANCE, MathCheck_EntityAngles },
+	{ "Matrix3x4_FromOriginQuat", 4, 3, 12,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_FromOriginQuat((vec4_t*)out, a, b); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_FromOriginQuat(a, b, out, magnitude, 3); },
+		0.0f, [](float* a, float* b, int index) { MathCheck_Quaternion(a); } },
+	{ "Matrix4x4_FromOriginQuat", 4, 3, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_FromOriginQuat((vec4_t*)out, a, b); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_FromOriginQuat(a, b, out, magnitude, 4); },
+		0.0f, [](float* a, float* b, int index) { MathCheck_Quaternion(a); } },
+	{ "Matrix4x4_CreateTranslate", 3, 0, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_CreateTranslate((vec4_t*)out, a[0], a[1], a[2]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 16; i++) {
+				out[i] = i % 4 == 3 && i < 12 ? a[i / 4] : i % 5 == 0 ? 1.0f : 0.0f;
+				if (magnitude)
+					magnitude[i] = 0.0f;
+			} } },
+	{ "Matrix4x4_ConvertToEntity", 16, 0, 6,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_ConvertToEntity((vec4_t*)a, out, out + 3); },
+		MathCheck_ConvertToEntity,
+		MATH_CHECK_TRIG_TOLERANCE, [](float* a, float* b, int index) { MathCheck_Similarity(a, 4); } },
+	{ "Matrix3x4_InvertSimple", 12, 0, 12,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_InvertSimple((vec4_t*)out, (vec4_t*)a); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_InvertSimple(a, b, out, magnitude, 3); },
+		8.0f * FLT_EPSILON, [](float* a, float* b, int index) { MathCheck_Similarity(a, 3); } },
+	{ "Matrix4x4_InvertSimple", 16, 0, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_InvertSimple((vec4_t*)out, (vec4_t*)a); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_InvertSimple(a, b, out, magnitude, 4); },
+		8.0f * FLT_EPSILON, [](float* a, float* b, int index) { MathCheck_Similarity(a, 4); } },
+	{ "Matrix4x4_InvertFull", 16, 0, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_InvertFull((vec4_t*)out, (vec4_t*)a); },
+		MathCheck_InvertFull },
+	{ "Matrix4x4_Transpose", 16, 0, 16,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_Transpose((vec4_t*)out, (vec4_t*)a); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 16; i++) {
+				out[i] = a[(i % 4) * 4 + i / 4];
+				if (magnitude)
+					magnitude[i] = 0.0f;
+			} } },
+	{ "Matrix3x4_OriginFromMatrix", 12, 0, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_OriginFromMatrix((vec4_t*)a, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 3; i++) {
+				out[i] = a[i * 4 + 3];
+				if (magnitude)
+					magnitude[i] = 0.0f;
+			} } },
+	{ "Matrix4x4_OriginFromMatrix", 16, 0, 3,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_OriginFromMatrix((vec4_t*)a, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 3; i++) {
+				out[i] = a[i * 4 + 3];
+				if (magnitude)
+					magnitude[i] = 0.0f;
+			} } },
+	{ "Matrix3x4_SetOrigin", 12, 3, 12,
+		[](const float* a, const float* b, float* out) { memcpy(out, a, sizeof(matrix3x4)); Math::Matrix3x4_SetOrigin((vec4_t*)out, b[0], b[1], b[2]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 12; i++) {
+				out[i] = i % 4 == 3 ? b[i / 4] : a[i];
+				if (magnitude)
+					magnitude[i] = 0.0f;
+			} } },
+	{ "Matrix4x4_SetOrigin", 16, 3, 16,
+		[](const float* a, const float* b, float* out) { memcpy(out, a, sizeof(matrix4x4)); Math::Matrix4x4_SetOrigin((vec4_t*)out, b[0], b[1], b[2]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 16; i++) {
+				out[i] = i % 4 == 3 && i < 12 ? b[i / 4] : a[i];
+				if (magnitude)
+					magnitude[i] = 0.0f;
+			} } },
+
+	// planes, b holds the normal and distance
+	{ "Matrix3x4_TransformPositivePlane", 12, 4, 4,
+		[](const float* a, const float* b, float* out) { Math::Matrix3x4_TransformPositivePlane((vec4_t*)a, b, b[3], out, out + 3); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_TransformPlane(a, b, out, magnitude, 1.0); },
+		0.0f, [](float* a, float* b, int index) { MathCheck_Similarity(a, 3); Math_Vector3Norm(b); } },
+	{ "Matrix4x4_TransformPositivePlane", 16, 4, 4,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_TransformPositivePlane((vec4_t*)a, b, b[3], out, out + 3); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_TransformPlane(a, b, out, magnitude, 1.0); },
+		0.0f, [](float* a, float* b, int index) { MathCheck_Similarity(a, 4); Math_Vector3Norm(b); } },
+	{ "Matrix4x4_TransformStandardPlane", 16, 4, 4,
+		[](const float* a, const float* b, float* out) { Math::Matrix4x4_TransformStandardPlane((vec4_t*)a, b, b[3], out, out + 3); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_TransformPlane(a, b, out, magnitude, -1.0); },
+		0.0f, [](float* a, float* b, int index) { MathCheck_Similarity(a, 4); Math_Vector3Norm(b); } },
+
+	// angles, in degrees unless noted
+	{ "AnglesVectors", 3, 0, 9,
+		[](const float* a, const float* b, float* out) { Math::AnglesVectors(a, out, out + 3, out + 6); },
+		MathCheck_AnglesVectors,
+		MATH_CHECK_TRIG_TOLERANCE, [](float* a, float* b, int index) { for (int i = 0; i < 3; i++) a[i] *= 90.0f; } },
+	{ "AnglesQuaternion", 3, 0, 4,
+		[](const float* a, const float* b, float* out) { Math::AnglesQuaternion(a, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			// radians
+			const double sr = sin(a[0] * 0.5), cr = cos(a[0] * 0.5), sp = sin(a[1] * 0.5), cp = cos(a[1] * 0.5), sy = sin(a[2] * 0.5), cy = cos(a[2] * 0.5);
+			const double q[4] = { sr * cp * cy - cr * sp * sy, cr * sp * cy + sr * cp * sy, cr * cp * sy - sr * sp * cy, cr * cp * cy + sr * sp * sy };
+			for (int i = 0; i < 4; i++) {
+				out[i] = (float)q[i];
+				if (magnitude)
+					magnitude[i] = 1.0f;
+			} },
+		MATH_CHECK_TRIG_TOLERANCE, [](float* a, float* b, int index) { for (int i = 0; i < 3; i++) a[i] *= M_PIF; } },
+	{ "AnglesInterpolate", 3, 4, 3,
+		[](const float* a, const float* b, float* out) { Math::AnglesInterpolate((float*)a, (float*)b, out, b[3]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			for (int i = 0; i < 3; i++) {
+				double d = (double)a[i] - b[i];
+				if (d > 180.0) d -= 360.0;
+				else if (d < -180.0) d += 360.0;
+				out[i] = (float)(b[i] + d * b[3]);
+				if (magnitude)
+					magnitude[i] = fabsf(a[i]) + fabsf(b[i]) + 360.0f;
+			} },
+		0.0f, [](float* a, float* b, int index) {
+			for (int i = 0; i < 3; i++) {
+				a[i] *= 90.0f;
+				b[i] *= 90.0f;
+			}
+			b[3] = fabsf(b[3]) * 0.5f; } },
+	{ "Vector3Angles", 3, 0, 3,
+		[](const float* a, const float* b, float* out) { Math::Vector3Angles(a, out); },
+		MathCheck_Vector3Angles,
+		MATH_CHECK_TRIG_TOLERANCE },
+	{ "VectorsAngles", 9, 0, 3,
+		[](const float* a, const float* b, float* out) { Math::VectorsAngles(a, a + 3, a + 6, out); },
+		MathCheck_VectorsAngles,
+		MATH_CHECK_TRIG_TOLERANCE, [](float* a, float* b, int index) {
+			const vec3_t angles = { a[0] * 90.0f, a[1] * 90.0f, a[2] * 90.0f };
+			Math::AnglesVectors(angles, a, a + 3, a + 6); } },
+	{ "QuaternionSlerp", 4, 5, 4,
+		[](const float* a, const float* b, float* out) { Math::QuaternionSlerp(a, b, b[4], out); },
+		MathCheck_Slerp,
+		MATH_CHECK_TRIG_TOLERANCE, [](float* a, float* b, int index) {
+			MathCheck_Quaternion(a);
+			MathCheck_Quaternion(b);
+			b[4] = fabsf(b[4]) * 0.5f; } },
+
+	// scalars and bounds
+	{ "SinCos", 1, 0, 2,
+		[](const float* a, const float* b, float* out) { Math::SinCos(a[0], out, out + 1); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_SinCosRef(a, out, magnitude, 1, true); },
+		0.0f, [](float* a, float* b, int index) { a[0] *= M_PIF * 0.5f; } },
+#ifdef XASH_VECTORIZE_SINCOS
+	{ "SinCosFastVector2", 2, 0, 4,
+		[](const float* a, const float* b, float* out) { Math::SinCosFastVector2(a[0], a[1], out, out + 1, out + 2, out + 3); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_SinCosRef(a, out, magnitude, 2, true); },
+		0.0f, [](float* a, float* b, int index) { for (int i = 0; i < 2; i++) a[i] *= M_PIF * 0.5f; } },
+	{ "SinCosFastVector3", 3, 0, 6,
+		[](const float* a, const float* b, float* out) { Math::SinCosFastVector3(a[0], a[1], a[2], out, out + 1, out + 2, out + 3, out + 4, out + 5); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_SinCosRef(a, out, magnitude, 3, true); },
+		0.0f, [](float* a, float* b, int index) { for (int i = 0; i < 3; i++) a[i] *= M_PIF * 0.5f; } },
+	{ "SinCosFastVector4", 4, 0, 8,
+		[](const float* a, const float* b, float* out) { Math::SinCosFastVector4(a[0], a[1], a[2], a[3], out, out + 1, out + 2, out + 3, out + 4, out + 5, out + 6, out + 7); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_SinCosRef(a, out, magnitude, 4, true); },
+		0.0f, [](float* a, float* b, int index) { for (int i = 0; i < 4; i++) a[i] *= M_PIF * 0.5f; } },
+	{ "SinFastVector3", 3, 0, 3,
+		[](const float* a, const float* b, float* out) { Math::SinFastVector3(a[0], a[1], a[2], out, out + 1, out + 2); },
+		[](const float* a, const float* b, float* out, float* magnitude) { MathCheck_SinCosRef(a, out, magnitude, 3, false); },
+		0.0f, [](float* a, float* b, int index) { for (int i = 0; i < 3; i++) a[i] *= M_PIF * 0.5f; } },
+#endif
+	// one Newton step from the bit trick estimate, the 0.175% it is known for, over 2^-60 to 2^60
+	{ "Rsqrt", 2, 0, 1,
+		[](const float* a, const float* b, float* out) { out[0] = Math::Rsqrt(a[0]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			out[0] = (float)(1.0 / sqrt((double)a[0]));
+			if (magnitude)
+				magnitude[0] = out[0]; },
+		1.8e-3f, [](float* a, float* b, int index) { a[0] = ldexpf(fabsf(a[0]) + 0.01f, (int)(a[1] * 30.0f)); } },
+	{ "Vector2NormLen", 3, 0, 4,
+		[](const float* a, const float* b, float* out) { out[3] = Math::Vector2NormLen(a, out); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			const double length = sqrt((double)a[0] * a[0] + (double)a[1] * a[1] + (double)a[2] * a[2]);
+			for (int i = 0; i < 3; i++)
+				out[i] = (float)(a[i] / length);
+			out[3] = (float)length;
+			if (magnitude) {
+				magnitude[0] = magnitude[1] = magnitude[2] = 1.0f;
+				magnitude[3] = (float)length;
+			} } },
+	{ "RangeRemapValue", 5, 0, 1,
+		[](const float* a, const float* b, float* out) { out[0] = Math::RangeRemapValue(a[0], a[1], a[2], a[3], a[4]); },
+		MathCheck_RangeRemap },
+	{ "ApproachValue", 3, 0, 1,
+		[](const float* a, const float* b, float* out) { out[0] = Math::ApproachValue(a[0], a[1], a[2]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			const double delta = (double)a[0] - a[1];
+			out[0] = delta > a[2] ? a[1] + a[2] : delta < -a[2] ? a[1] - a[2] : a[0];
+			if (magnitude)
+				magnitude[0] = fabsf(a[1]) + a[2]; },
+		0.0f, [](float* a, float* b, int index) { a[2] = fabsf(a[2]); } },
+	{ "NearestPow", 1, 1, 1,
+		[](const float* a, const float* b, float* out) { out[0] = (float)Math::NearestPow((int)a[0], b[0] > 0.0f); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			long long n = 1;
+			while (n < (long long)a[0])
+				n <<= 1;
+			if (b[0] > 0.0f && n > (long long)a[0] && n > 1)
+				n >>= 1;
+			out[0] = (float)n;
+			if (magnitude)
+				magnitude[0] = 0.0f; },
+		0.0f, [](float* a, float* b, int index) { a[0] = floorf(a[0] * 1000.0f); } },
+	{ "BoundsIntersect", 6, 6, 1,
+		[](const float* a, const float* b, float* out) { out[0] = Math::BoundsIntersect(a, a + 3, b, b + 3); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			out[0] = 1.0f;
+			for (int i = 0; i < 3; i++)
+				if (a[i] > b[3 + i] || a[3 + i] < b[i])
+					out[0] = 0.0f;
+			if (magnitude)
+				magnitude[0] = 0.0f; },
+		0.0f, [](float* a, float* b, int index) { MathCheck_SortBounds(a, a + 3); MathCheck_SortBounds(b, b + 3); } },
+	{ "BoundsAndSphereIntersect", 6, 4, 1,
+		[](const float* a, const float* b, float* out) { out[0] = Math::BoundsAndSphereIntersect(a, a + 3, b, b[3]); },
+		[](const float* a, const float* b, float* out, float* magnitude) {
+			out[0] = 1.0f;
+			for (int i = 0; i < 3; i++)
+				if (a[i] > (double)b[i] + b[3] || a[3 + i] < (double)b[i] - b[3])
+					out[0] = 0.0f;
+			if (magnitude)
+				magnitude[0] = 0.0f; },
+		0.0f, [](float* a, float* b, int index) { MathCheck_SortBounds(a, a + 3); b[3] = fabsf(b[3]) * 0.5f; } },
+};
+
+// calls per second of whichever function is passed, repeated over all inputs for at least MATH_CHECK_SECONDS
+static double MathCheck_Bench(const ovrMathCase* test, bool reference, const float* a, const float* b, float* out) {
+	long long calls = 0;
+	const double start = MathCheck_Time();
+	double elapsed;
+	do {
+		if (reference)
+			for (int i = 0; i < MATH_CHECK_INPUTS; i++)
+				test->Reference(a + i * test->SizeA, b + i * test->SizeB, out + i * 16, NULL);
+		else
+			for (int i = 0; i < MATH_CHECK_INPUTS; i++)
+				test->Run(a + i * test->SizeA, b + i * test->SizeB, out + i * 16);
+		calls += MATH_CHECK_INPUTS;
+		elapsed = MathCheck_Time() - start;
+	} while (elapsed < MATH_CHECK_SECONDS);
+	return calls / elapsed;
+}
+
+/*
+================================================================================
+Batch routines
+================================================================================
+*/
+
+typedef struct {
+	ovrJobQueue*	Jobs;
+	matrix4x4		Matrix;
+	vec3soa_t		In;
+	vec3soa_t		Out;
+	matrix3x4*		M1;
+	matrix3x4*		M2;
+	matrix3x4*		Concat;
+} ovrMathBatch;
+
+static void MathCheck_PointsLoop(ovrMathBatch* batch) {
+	for (int i = 0; i < MATH_CHECK_POINTS; i++) {
+		const vec3_t v = { batch->In.x[i], batch->In.y[i], batch->In.z[i] };
+		vec3_t out;
+		Math::Matrix4x4_VectorTransform(batch->Matrix, v, out);
+		batch->Out.x[i] = out[0];
+		batch->Out.y[i] = out[1];
+		batch->Out.z[i] = out[2];
+	}
+}
+
+// the same loop over the header copy, which the compiler can fold into it
+static void MathCheck_PointsInline(ovrMathBatch* batch) {
+	for (int i = 0; i < MATH_CHECK_POINTS; i++) {
+		const vec3_t v = { batch->In.x[i], batch->In.y[i], batch->In.z[i] };
+		vec3_t out;
+		Math_Matrix4x4_VectorTransform(batch->Matrix, v, out);
+		batch->Out.x[i] = out[0];
+		batch->Out.y[i] = out[1];
+		batch->Out.z[i] = out[2];
+	}
+}
+
+static void MathCheck_PointsBatch(ovrMathBatch* batch) {
+	Math::Matrix4x4_VectorTransformBatch(batch->Matrix, &batch->In, &batch->Out, MATH_CHECK_POINTS);
+}
+
+static void MathCheck_PointsJobs(ovrMathBatch* batch) {
+	ovrJobQueue_TransformPoints(batch->Jobs, batch->Matrix, &batch->In, &batch->Out, MATH_CHECK_POINTS);
+}
+
+static void MathCheck_ConcatLoop(ovrMathBatch* batch) {
+	for (int i = 0; i < MATH_CHECK_MATRICES; i++)
+		Math::Matrix3x4_ConcatTransforms(batch->Concat[i], batch->M1[i], batch->M2[i]);
+}
+
+static void MathCheck_ConcatInline(ovrMathBatch* batch) {
+	for (int i = 0; i < MATH_CHECK_MATRICES; i++)
+		Math_Matrix3x4_ConcatTransforms(batch->Concat[i], batch->M1[i], batch->M2[i]);
+}
+
+static void MathCheck_ConcatBatch(ovrMathBatch* batch) {
+	Math::Matrix3x4_ConcatTransformsBatch(batch->Concat, batch->M1, batch->M2, MATH_CHECK_MATRICES);
+}
+
+static void MathCheck_ConcatJobs(ovrMathBatch* batch) {
+	ovrJobQueue_ConcatTransforms(batch->Jobs, batch->Concat, batch->M1, batch->M2, MATH_CHECK_MATRICES);
+}
+
+// items per second
+static double MathCheck_Rate(void (*run)(ovrMathBatch* batch), ovrMathBatch* batch, int items) {
+	long long done = 0;
+	const double start = MathCheck_Time();
+	double elapsed;
+	do {
+		run(batch);
+		done += items;
+		elapsed = MathCheck_Time() - start;
+	} while (elapsed < MATH_CHECK_SECONDS);
+	return done / elapsed;
+}
+
+static bool MathCheck_Batch(ovrJobQueue* jobs, unsigned int* seed) {
+	ovrMathBatch batch;
+	batch.Jobs = jobs;
+	for (int i = 0; i < 12; i++)
+		batch.Matrix[i / 4][i % 4] = MathCheck_Random(seed);
+	Math_Vector4Set(batch.Matrix[3], 0.0f, 0.0f, 0.0f, 1.0f);
+	float* points = (float*)malloc(MATH_CHECK_POINTS * 6 * sizeof(float));
+	batch.In = { points, points + MATH_CHECK_POINTS, points + MATH_CHECK_POINTS * 2 };
+	batch.Out = { points + MATH_CHECK_POINTS * 3, points + MATH_CHECK_POINTS * 4, points + MATH_CHECK_POINTS * 5 };
+	for (int i = 0; i < MATH_CHECK_POINTS * 3; i++)
+		points[i] = MathCheck_Random(seed);
+	batch.M1 = (matrix3x4*)malloc(MATH_CHECK_MATRICES * 3 * sizeof(matrix3x4));
+	batch.M2 = batch.M1 + MATH_CHECK_MATRICES;
+	batch.Concat = batch.M2 + MATH_CHECK_MATRICES;
+	for (int i = 0; i < MATH_CHECK_MATRICES * 2 * 12; i++)
+		((float*)batch.M1)[i] = MathCheck_Random(seed);
+
+	// the batch transform must hold the single call bound, the batch concat is the single call in a loop
+	int failed = 0;
+	long long maxUlps = 0;
+	MathCheck_PointsJobs(&batch);
+	for (int i = 0; i < MATH_CHECK_POINTS; i++) {
+		const float v[3] = { batch.In.x[i], batch.In.y[i], batch.In.z[i] };
+		const float got[3] = { batch.Out.x[i], batch.Out.y[i], batch.Out.z[i] };
+		float expected[3], magnitude[3];
+		MathCheck_Transform((float*)batch.Matrix, v, expected, magnitude);
+		for (int j = 0; j < 3; j++) {
+			const long long ulps = MathCheck_Ulps(got[j], expected[j]);
+			if (ulps > maxUlps)
+				maxUlps = ulps;
+			if (ulps && fabsf(got[j] - expected[j]) > MATH_CHECK_TOLERANCE * magnitude[j])
+				failed++;
+		}
+	}
+	MathCheck_ConcatJobs(&batch);
+	for (int i = 0; i < MATH_CHECK_MATRICES; i++) {
+		matrix3x4 expected;
+		Math::Matrix3x4_ConcatTransforms(expected, batch.M1[i], batch.M2[i]);
+		if (memcmp(expected, batch.Concat[i], sizeof(matrix3x4)))
+			failed++;
+	}
+
+	// loop is a call into Math.cpp per item, inline the header copy of the same routine
+	const double pointsLoop = MathCheck_Rate(MathCheck_PointsLoop, &batch, MATH_CHECK_POINTS);
+	const double pointsInline = MathCheck_Rate(MathCheck_PointsInline, &batch, MATH_CHECK_POINTS);
+	const double pointsBatch = MathCheck_Rate(MathCheck_PointsBatch, &batch, MATH_CHECK_POINTS);
+	const double pointsJobs = MathCheck_Rate(MathCheck_PointsJobs, &batch, MATH_CHECK_POINTS);
+	ALOGI("Math %d points: Matrix4x4_VectorTransform loop %.2f ns, inline %.2f ns (%.2fx), batch %.2f ns (%.2fx), %d workers %.2f ns (%.2fx) per point | max %lld ulp",
+		MATH_CHECK_POINTS, 1e9 / pointsLoop, 1e9 / pointsInline, pointsInline / pointsLoop, 1e9 / pointsBatch, pointsBatch / pointsLoop,
+		jobs->ThreadCount, 1e9 / pointsJobs, pointsJobs / pointsLoop, maxUlps);
+	const double concatLoop = MathCheck_Rate(MathCheck_ConcatLoop, &batch, MATH_CHECK_MATRICES);
+	const double concatInline = MathCheck_Rate(MathCheck_ConcatInline, &batch, MATH_CHECK_MATRICES);
+	const double concatBatch = MathCheck_Rate(MathCheck_ConcatBatch, &batch, MATH_CHECK_MATRICES);
+	const double concatJobs = MathCheck_Rate(MathCheck_ConcatJobs, &batch, MATH_CHECK_MATRICES);
+	ALOGI("Math %d matrices: Matrix3x4_ConcatTransforms loop %.2f ns, inline %.2f ns (%.2fx), batch %.2f ns (%.2fx), %d workers %.2f ns (%.2fx) per pair",
+		MATH_CHECK_MATRICES, 1e9 / concatLoop, 1e9 / concatInline, concatInline / concatLoop, 1e9 / concatBatch, concatBatch / concatLoop,
+		jobs->ThreadCount, 1e9 / concatJobs, concatJobs / concatLoop);
+	if (failed)
+		ALOGE("Math batch routines: %d results outside the bound", failed);
+	free(points);
+	free(batch.M1);
+	return failed == 0;
+}
+
+/*
+================================================================================
+Sin and cos
+================================================================================
+*/
+
+#if MATH_SIMD
+typedef struct {
+	float*			Angles;
+	float*			Sin;
+	float*			Cos;
+} ovrMathAngles;
+
+static void MathCheck_SinCosLibm(ovrMathAngles* angles) {
+	for (int i = 0; i < MATH_CHECK_ANGLES; i++) {
+		angles->Sin[i] = sinf(angles->Angles[i]);
+		angles->Cos[i] = cosf(angles->Angles[i]);
+	}
+}
+
+static void MathCheck_SinCosSimd(ovrMathAngles* angles) {
+	for (int i = 0; i < MATH_CHECK_ANGLES; i += 4) {
+		simd4f sin, cos;
+		Simd_SinCos(Simd_Load(angles->Angles + i), &sin, &cos);
+		Simd_Store(angles->Sin + i, sin);
+		Simd_Store(angles->Cos + i, cos);
+	}
+}
+
+static double MathCheck_AnglesRate(void (*run)(ovrMathAngles* angles), ovrMathAngles* angles) {
+	long long done = 0;
+	const double start = MathCheck_Time();
+	double elapsed;
+	do {
+		run(angles);
+		done += MATH_CHECK_ANGLES;
+		elapsed = MathCheck_Time() - start;
+	} while (elapsed < MATH_CHECK_SECONDS);
+	return done / elapsed;
+}
+
+// max absolute error and ulps of both outputs against double precision
+static void MathCheck_SinCosError(const ovrMathAngles* angles, double* maxError, long long* maxUlps) {
+	*maxError = 0.0;
+	*maxUlps = 0;
+	for (int i = 0; i < MATH_CHECK_ANGLES; i++) {
+		const float expected[2] = { (float)sin((double)angles->Angles[i]), (float)cos((double)angles->Angles[i]) };
+		const double error[2] = { fabs(angles->Sin[i] - sin((double)angles->Angles[i])), fabs(angles->Cos[i] - cos((double)angles->Angles[i])) };
+		const long long ulps[2] = { MathCheck_Ulps(angles->Sin[i], expected[0]), MathCheck_Ulps(angles->Cos[i], expected[1]) };
+		for (int j = 0; j < 2; j++) {
+			if (error[j] > *maxError)
+				*maxError = error[j];
+			// ulps only mean something away from the zeros
+			if (fabsf(expected[j]) > 0.01f && ulps[j] > *maxUlps)
+				*maxUlps = ulps[j];
+		}
+	}
+}
+
+static bool MathCheck_SinCos(unsigned int* seed) {
+	ovrMathAngles angles;
+	angles.Angles = (float*)malloc(MATH_CHECK_ANGLES * 3 * sizeof(float));
+	angles.Sin = angles.Angles + MATH_CHECK_ANGLES;
+	angles.Cos = angles.Sin + MATH_CHECK_ANGLES;
+	bool passed = true;
+	const float ranges[] = { M_PIF, 8192.0f };
+	for (size_t r = 0; r < sizeof(ranges) / sizeof(ranges[0]); r++) {
+		for (int i = 0; i < MATH_CHECK_ANGLES; i++)
+			angles.Angles[i] = MathCheck_Random(seed) * 0.5f * ranges[r];
+		double libmError, simdError;
+		long long libmUlps, simdUlps;
+		const double libm = MathCheck_AnglesRate(MathCheck_SinCosLibm, &angles);
+		MathCheck_SinCosError(&angles, &libmError, &libmUlps);
+		const double simd = MathCheck_AnglesRate(MathCheck_SinCosSimd, &angles);
+		MathCheck_SinCosError(&angles, &simdError, &simdUlps);
+		ALOGI("Math sincos |x| <= %-6g Simd_SinCos %.2f ns, libm %.2f ns, %.2fx | max error %.2g (%lld ulp), libm %.2g (%lld ulp)",
+			ranges[r], 1e9 / simd, 1e9 / libm, simd / libm, simdError, simdUlps, libmError, libmUlps);
+		// the bound documented in MathSimd.h
+		if (simdError > 7.8e-8) {
+			ALOGE("Math sincos |x| <= %g: error %.3g is above the documented bound", ranges[r], simdError);
+			passed = false;
+		}
+	}
+	free(angles.Angles);
+	return passed;
+}
+#endif
+
+/*
+================================================================================
+Quaternion blending
+================================================================================
+*/
+
+typedef struct {
+	ovrJobQueue*	Jobs;
+	vec4_t*			P;
+	vec4_t*			Q;
+	float*			Weights;
+	vec4_t*			Out;
+	int				Mode;
+} ovrMathBones;
+
+static void MathCheck_BonesSlerpLoop(ovrMathBones* bones) {
+	for (int i = 0; i < MATH_CHECK_BONES; i++)
+		Math::QuaternionSlerp(bones->P[i], bones->Q[i], bones->Weights[i], bones->Out[i]);
+}
+
+static void MathCheck_BonesBatch(ovrMathBones* bones) {
+	Math::QuaternionBlendBatch(bones->P, bones->Q, bones->Weights, bones->Out, MATH_CHECK_BONES, bones->Mode);
+}
+
+static void MathCheck_BonesJobs(ovrMathBones* bones) {
+	ovrJobQueue_BlendQuaternions(bones->Jobs, bones->Out, bones->P, bones->Q, bones->Weights, MATH_CHECK_BONES, bones->Mode);
+}
+
+static double MathCheck_BonesRate(void (*run)(ovrMathBones* bones), ovrMathBones* bones) {
+	long long done = 0;
+	const double start = MathCheck_Time();
+	double elapsed;
+	do {
+		run(bones);
+		done += MATH_CHECK_BONES;
+		elapsed = MathCheck_Time() - start;
+	} while (elapsed < MATH_CHECK_SECONDS);
+	return done / elapsed;
+}
+
+static void MathCheck_RandomQuaternion(unsigned int* seed, vec4_t _) {
+	double length;
+	do {
+		Math_Vector4Set(_, MathCheck_Random(seed), MathCheck_Random(seed), MathCheck_Random(seed), MathCheck_Random(seed));
+		length = sqrt((double)_[0] * _[0] + (double)_[1] * _[1] + (double)_[2] * _[2] + (double)_[3] * _[3]);
+	} while (length < 0.1 || length > 2.0);
+	for (int i = 0; i < 4; i++)
+		_[i] = (float)(_[i] / length);
+}
+
+// largest component error of the blended bones against a double precision slerp along the shorter arc
+static double MathCheck_BonesError(const ovrMathBones* bones) {
+	double maxError = 0.0;
+	for (int i = 0; i < MATH_CHECK_BONES; i++) {
+		const float* p = bones->P[i];
+		const float* q = bones->Q[i];
+		const double t = bones->Weights[i];
+		double d = (double)p[0] * q[0] + (double)p[1] * q[1] + (double)p[2] * q[2] + (double)p[3] * q[3];
+		const double flip = d < 0.0 ? -1.0 : 1.0;
+		d = fmin(fabs(d), 1.0);
+		double sclp = 1.0 - t, sclq = t;
+		if (d < 1.0 - 1e-12) {
+			const double omega = acos(d);
+			sclp = sin((1.0 - t) * omega) / sin(omega);
+			sclq = sin(t * omega) / sin(omega);
+		}
+		for (int j = 0; j < 4; j++) {
+			const double error = fabs(bones->Out[i][j] - (sclp * p[j] + sclq * flip * q[j]));
+			if (error > maxError)
+				maxError = error;
+		}
+	}
+	return maxError;
+}
+
+static bool MathCheck_Bones(ovrJobQueue* jobs, unsigned int* seed) {
+	ovrMathBones bones;
+	bones.Jobs = jobs;
+	bones.P = (vec4_t*)malloc(MATH_CHECK_BONES * 3 * sizeof(vec4_t));
+	bones.Q = bones.P + MATH_CHECK_BONES;
+	bones.Out = bones.Q + MATH_CHECK_BONES;
+	bones.Weights = (float*)malloc(MATH_CHECK_BONES * sizeof(float));
+	for (int i = 0; i < MATH_CHECK_BONES; i++) {
+		MathCheck_RandomQuaternion(seed, bones.P[i]);
+		MathCheck_RandomQuaternion(seed, bones.Q[i]);
+		// every fourth pair a few degrees apart, the common case between animation keys
+		if (i % 4 == 0) {
+			for (int j = 0; j < 4; j++)
+				bones.Q[i][j] = bones.P[i][j] + bones.Q[i][j] * 0.02f;
+			const float length = sqrtf(bones.Q[i][0] * bones.Q[i][0] + bones.Q[i][1] * bones.Q[i][1] + bones.Q[i][2] * bones.Q[i][2] + bones.Q[i][3] * bones.Q[i][3]);
+			Math_Vector4Set(bones.Q[i], bones.Q[i][0] / length, bones.Q[i][1] / length, bones.Q[i][2] / length, bones.Q[i][3] / length);
+		}
+		bones.Weights[i] = MathCheck_Random(seed) * 0.25f + 0.5f;
+	}
+
+	bool passed = true;
+	const double slerpLoop = MathCheck_BonesRate(MathCheck_BonesSlerpLoop, &bones);
+	const double slerpLoopError = MathCheck_BonesError(&bones);
+	ALOGI("Math %d bones: QuaternionSlerp loop %.2f ns per bone | max error %.2g", MATH_CHECK_BONES, 1e9 / slerpLoop, slerpLoopError);
+	static const char* modes[] = { "slerp", "slerp fast", "nlerp" };
+	// what each mode promises, QUAT_BLEND_* in Math.h; nlerp is only timed
+	static const double bounds[] = { 1e-6, 5e-4, 1.0 };
+	for (int mode = QUAT_BLEND_SLERP; mode <= QUAT_BLEND_NLERP; mode++) {
+		bones.Mode = mode;
+		const double batch = MathCheck_BonesRate(MathCheck_BonesBatch, &bones);
+		const double error = MathCheck_BonesError(&bones);
+		const double split = MathCheck_BonesRate(MathCheck_BonesJobs, &bones);
+		ALOGI("Math %d bones: QuaternionBlendBatch %-10s %.2f ns (%.2fx), %d workers %.2f ns (%.2fx) per bone | max error %.2g",
+			MATH_CHECK_BONES, modes[mode], 1e9 / batch, batch / slerpLoop, jobs->ThreadCount, 1e9 / split, split / slerpLoop, error);
+		if (error > bounds[mode]) {
+			ALOGE("Math QuaternionBlendBatch %s: error %.3g is above %.3g", modes[mode], error, bounds[mode]);
+			passed = false;
+		}
+	}
+	free(bones.P);
+	free(bones.Weights);
+	return passed;
+}
+
+/*
+================================================================================
+Half floats
+================================================================================
+*/
+
+typedef struct {
+	float*			Floats;
+	unsigned short*	Halves;
+	int				Count;
+} ovrMathHalves;
+
+// rounded to nearest even in double precision, NaN as the canonical quiet NaN
+static unsigned short MathCheck_FloatToHalf(float value) {
+	const unsigned short sign = signbit(value) ? 0x8000 : 0;
+	if (isnan(value))
+		return sign | 0x7e00;
+	const double a = fabs((double)value);
+	// the rounding may carry into the smallest normal, 0x400, which is still the right encoding
+	if (a < ldexp(1.0, -14))
+		return sign | (unsigned short)nearbyint(ldexp(a, 24));
+	int exponent;
+	frexp(a, &exponent);
+	exponent--;
+	double mantissa = nearbyint((ldexp(a, -exponent) - 1.0) * 1024.0);
+	if (mantissa == 1024.0) {
+		mantissa = 0.0;
+		exponent++;
+	}
+	if (isinf(a) || exponent > 15)
+		return sign | 0x7c00;
+	return sign | (unsigned short)((exponent + 15) << 10) | (unsigned short)mantissa;
+}
+
+static float MathCheck_HalfToFloat(unsigned short value) {
+	const int exponent = (value >> 10) & 0x1f;
+	const int mantissa = value & 0x3ff;
+	const float sign = value & 0x8000 ? -1.0f : 1.0f;
+	if (exponent == 31)
+		return mantissa ? copysignf(NAN, sign) : sign * INFINITY;
+	return sign * (float)(exponent ? ldexp(1024 + mantissa, exponent - 25) : ldexp(mantissa, -24));
+}
+
+// NaNs only have to stay NaNs of the same sign, the hardware conversions keep what they can of the payload
+static bool MathCheck_HalfEqual(unsigned short a, unsigned short b) {
+	if ((a & 0x7fff) > 0x7c00 && (b & 0x7fff) > 0x7c00)
+		return (a & 0x8000) == (b & 0x8000);
+	return a == b;
+}
+
+static bool MathCheck_FloatBitsEqual(float a, float b) {
+	if (isnan(a) && isnan(b))
+		return signbit(a) == signbit(b);
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static void MathCheck_FloatToHalfLoop(ovrMathHalves* halves) {
+	for (int i = 0; i < halves->Count; i++)
+		halves->Halves[i] = Math::FloatToHalf(halves->Floats[i]);
+}
+
+static void MathCheck_FloatToHalfBatch(ovrMathHalves* halves) {
+	Math::FloatToHalfBatch(halves->Floats, halves->Halves, halves->Count);
+}
+
+static void MathCheck_HalfToFloatLoop(ovrMathHalves* halves) {
+	for (int i = 0; i < halves->Count; i++)
+		halves->Floats[i] = Math::HalfToFloat(halves->Halves[i]);
+}
+
+static void MathCheck_HalfToFloatBatch(ovrMathHalves* halves) {
+	Math::HalfToFloatBatch(halves->Halves, halves->Floats, halves->Count);
+}
+
+// bytes read and written per second
+static double MathCheck_HalvesRate(void (*run)(ovrMathHalves* halves), ovrMathHalves* halves) {
+	long long done = 0;
+	const double start = MathCheck_Time();
+	double elapsed;
+	do {
+		run(halves);
+		done += halves->Count;
+		elapsed = MathCheck_Time() - start;
+	} while (elapsed < MATH_CHECK_SECONDS);
+	return done * (sizeof(float) + sizeof(unsigned short)) / elapsed;
+}
+
+static bool MathCheck_Halves(unsigned int* seed) {
+	// every half, the midpoint between each pair of neighbours with the floats either side of it, then random bits
+	const int ties = 0x7c00 * 3;
+	const int count = 0x10000 + ties * 2 + MATH_CHECK_HALVES;
+	ovrMathHalves halves;
+	halves.Floats = (float*)malloc(count * sizeof(float));
+	halves.Halves = (unsigned short*)malloc(count * sizeof(unsigned short));
+	float* expected = (float*)malloc(0x10000 * sizeof(float));
+	unsigned short* expectedHalves = (unsigned short*)malloc(count * sizeof(unsigned short));
+	int n = 0;
+	for (int h = 0; h < 0x10000; h++)
+		halves.Floats[n++] = expected[h] = MathCheck_HalfToFloat((unsigned short)h);
+	for (int h = 0; h < 0x7c00; h++) {
+		// past 65504 the next step would be 65536, so 65520 is the tie with infinity
+		const float mid = h == 0x7bff ? 65520.0f : (float)(((double)expected[h] + expected[h + 1]) * 0.5);
+		const float around[3] = { nextafterf(mid, 0.0f), mid, nextafterf(mid, INFINITY) };
+		for (int j = 0; j < 3; j++) {
+			halves.Floats[n++] = around[j];
+			halves.Floats[n++] = -around[j];
+		}
+	}
+	for (int i = 0; i < MATH_CHECK_HALVES; i++) {
+		unsigned int bits = 0;
+		for (int j = 0; j < 4; j++)
+			bits = (bits << 8) ^ (unsigned int)(MathCheck_Random(seed) * 1e6f);
+		memcpy(&halves.Floats[n++], &bits, sizeof(float));
+	}
+	for (int i = 0; i < count; i++)
+		expectedHalves[i] = MathCheck_FloatToHalf(halves.Floats[i]);
+
+	bool passed = true;
+	const char* names[] = { "FloatToHalf", "FloatToHalfBatch", "HalfToFloat", "HalfToFloatBatch" };
+	void (*runs[])(ovrMathHalves* halves) = { MathCheck_FloatToHalfLoop, MathCheck_FloatToHalfBatch, MathCheck_HalfToFloatLoop, MathCheck_HalfToFloatBatch };
+	for (int r = 0; r < 4; r++) {
+		int failed = 0;
+		if (r < 2) {
+			halves.Count = count;
+			runs[r](&halves);
+			for (int i = 0; i < count; i++)
+				if (!MathCheck_HalfEqual(halves.Halves[i], expectedHalves[i])) {
+					if (!failed)
+						ALOGE("Math %s(%.9g): 0x%04x, expected 0x%04x", names[r], halves.Floats[i], halves.Halves[i], expectedHalves[i]);
+					failed++;
+				}
+		}
+		else {
+			halves.Count = 0x10000;
+			for (int h = 0; h < 0x10000; h++)
+				halves.Halves[h] = (unsigned short)h;
+			runs[r](&halves);
+			for (int h = 0; h < 0x10000; h++)
+				if (!MathCheck_FloatBitsEqual(halves.Floats[h], expected[h])) {
+					if (!failed)
+						ALOGE("Math %s(0x%04x): %.9g, expected %.9g", names[r], h, halves.Floats[h], expected[h]);
+					failed++;
+				}
+		}
+		halves.Count = MATH_CHECK_HALVES;
+		const double rate = MathCheck_HalvesRate(runs[r], &halves);
+		ALOGI("Math %-16s %6.2f GB/s, %.2f ns per value | %d of %d wrong",
+			names[r], rate * 1e-9, 1e9 * (sizeof(float) + sizeof(unsigned short)) / rate, failed, r < 2 ? count : 0x10000);
+		if (failed)
+			passed = false;
+	}
+	free(halves.Floats);
+	free(halves.Halves);
+	free(expected);
+	free(expectedHalves);
+	return passed;
+}
+
+/*
+================================================================================
+Culling
+================================================================================
+*/
+
+typedef struct {
+	ovrJobQueue*	Jobs;
+	ovrFrustum*		Frustum;
+	vec3_t*			Mins;
+	vec3_t*			Maxs;
+	vec4_t*			Spheres;
+	int*			Visible;
+	int				VisibleCount;
+} ovrMathBounds;
+
+static void MathCheck_BoxesLoop(ovrMathBounds* bounds) {
+	int n = 0;
+	for (int i = 0; i < MATH_CHECK_BOUNDS; i++)
+		if (ovrFrustum_BoxVisible(bounds->Frustum, bounds->Mins[i], bounds->Maxs[i]))
+			bounds->Visible[n++] = i;
+	bounds->VisibleCount = n;
+}
+
+static void MathCheck_BoxesBatch(ovrMathBounds* bounds) {
+	bounds->VisibleCount = ovrFrustum_CullBoxes(bounds->Frustum, bounds->Mins, bounds->Maxs, MATH_CHECK_BOUNDS, bounds->Visible);
+}
+
+static void MathCheck_BoxesJobs(ovrMathBounds* bounds) {
+	bounds->VisibleCount = ovrJobQueue_CullBoxes(bounds->Jobs, bounds->Frustum, bounds->Mins, bounds->Maxs, MATH_CHECK_BOUNDS, bounds->Visible);
+}
+
+static void MathCheck_SpheresLoop(ovrMathBounds* bounds) {
+	int n = 0;
+	for (int i = 0; i < MATH_CHECK_BOUNDS; i++)
+		if (ovrFrustum_SphereVisible(bounds->Frustum, bounds->Spheres[i], bounds->Spheres[i][3]))
+			bounds->Visible[n++] = i;
+	bounds->VisibleCount = n;
+}
+
+static void MathCheck_SpheresBatch(ovrMathBounds* bounds) {
+	bounds->VisibleCount = ovrFrustum_CullSpheres(bounds->Frustum, bounds->Spheres, MATH_CHECK_BOUNDS, bounds->Visible);
+}
+
+static void MathCheck_SpheresJobs(ovrMathBounds* bounds) {
+	bounds->VisibleCount = ovrJobQueue_CullSpheres(bounds->Jobs, bounds->Frustum, bounds->Spheres, MATH_CHECK_BOUNDS, bounds->Visible);
+}
+
+static double MathCheck_BoundsRate(void (*run)(ovrMathBounds* bounds), ovrMathBounds* bounds) {
+	long long done = 0;
+	const double start = MathCheck_Time();
+	double elapsed;
+	do {
+		run(bounds);
+		done += MATH_CHECK_BOUNDS;
+		elapsed = MathCheck_Time() - start;
+	} while (elapsed < MATH_CHECK_SECONDS);
+	return done / elapsed;
+}
+
+// The smallest signed distance of the box or sphere's furthest point over the planes, in double precision:
+// negative is outside. Boxes have a w of 0 in spheres, so one function does both.
+static double MathCheck_BoundsMargin(const ovrFrustum* frustum, const float* mins, const float* maxs, float radius) {
+	double margin = DBL_MAX;
+	for (int p = 0; p < 6; p++) {
+		const float* plane = frustum->Planes[p];
+		double distance = (double)plane[3] + radius;
+		for (int j = 0; j < 3; j++)
+			distance += (double)plane[j] * (plane[j] < 0.0f ? mins[j] : maxs[j]);
+		if (distance < margin)
+			margin = distance;
+	}
+	return margin;
+}
+
+// Compares a visibility list with the double precision margins; only inputs within slack of a plane may differ.
+static int MathCheck_BoundsWrong(const ovrMathBounds* bounds, const double* margins, double slack) {
+	int wrong = 0;
+	for (int i = 0, next = 0; i < MATH_CHECK_BOUNDS; i++) {
+		const bool listed = next < bounds->VisibleCount && bounds->Visible[next] == i;
+		if (listed)
+			next++;
+		if (listed != (margins[i] >= 0.0) && fabs(margins[i]) > slack)
+			wrong++;
+	}
+	return wrong;
+}
+
+static bool MathCheck_Cull(ovrJobQueue* jobs, unsigned int* seed) {
+	// a 90 degree infinite projection as the renderer makes it, eyes 64 mm apart and the head turned and tilted
+	const ovrMatrix4f projection = ovrMatrix4f_CreateProjectionFov(90.0f, 90.0f, 0.0f, 0.0f, 0.1f, 0.0f);
+	const ovrMatrix4f head = ovrMatrix4f_CreateRotation(0.3f, 0.8f, 0.1f);
+	ovrTracking2 tracking;
+	memset(&tracking, 0, sizeof(tracking));
+	for (int eye = 0; eye < 2; eye++) {
+		const ovrMatrix4f offset = ovrMatrix4f_CreateTranslation(eye ? -0.032f : 0.032f, 0.0f, 0.0f);
+		tracking.Eye[eye].ViewMatrix = ovrMatrix4f_Multiply(&offset, &head);
+	}
+	ovrFrustum frustums[CULL_VIEWS];
+	ovrFrustum_FromTracking(frustums, &tracking, &projection);
+
+	ovrMathBounds bounds;
+	bounds.Jobs = jobs;
+	bounds.Mins = (vec3_t*)malloc(MATH_CHECK_BOUNDS * 2 * sizeof(vec3_t));
+	bounds.Maxs = bounds.Mins + MATH_CHECK_BOUNDS;
+	bounds.Spheres = (vec4_t*)malloc(MATH_CHECK_BOUNDS * sizeof(vec4_t));
+	bounds.Visible = (int*)malloc(MATH_CHECK_BOUNDS * sizeof(int));
+	double* boxMargins = (double*)malloc(MATH_CHECK_BOUNDS * 2 * sizeof(double));
+	double* sphereMargins = boxMargins + MATH_CHECK_BOUNDS;
+	for (int i = 0; i < MATH_CHECK_BOUNDS; i++) {
+		for (int j = 0; j < 3; j++) {
+			const float center = MathCheck_Random(seed) * 20.0f;
+			const float extent = MathCheck_Random(seed) * 0.5f + 1.0f;
+			bounds.Mins[i][j] = center - extent;
+			bounds.Maxs[i][j] = center + extent;
+			bounds.Spheres[i][j] = center;
+		}
+		bounds.Spheres[i][3] = MathCheck_Random(seed) * 0.5f + 1.0f;
+	}
+
+	bool passed = true;
+	// the planes against clip space, for points either side of them
+	int planeWrong = 0;
+	for (int i = 0; i < MATH_CHECK_BOUNDS; i++) {
+		const ovrMatrix4f viewProjection = ovrMatrix4f_Multiply(&projection, &tracking.Eye[i & 1].ViewMatrix);
+		const float* point = bounds.Spheres[i];
+		double clip[4];
+		for (int r = 0; r < 4; r++)
+			clip[r] = (double)viewProjection.M[r][0] * point[0] + (double)viewProjection.M[r][1] * point[1] + (double)viewProjection.M[r][2] * point[2] + viewProjection.M[r][3];
+		const double inside = fmin(fmin(clip[3] - fabs(clip[0]), clip[3] - fabs(clip[1])), clip[3] - fabs(clip[2]));
+		const double margin = MathCheck_BoundsMargin(&frustums[i & 1], point, point, 0.0f);
+		if (fabs(inside) > 1e-4 && (inside >= 0.0) != (margin >= 0.0))
+			planeWrong++;
+	}
+	ALOGI("Math ovrFrustum_FromTracking: %d of %d points on the wrong side", planeWrong, MATH_CHECK_BOUNDS);
+	if (planeWrong)
+		passed = false;
+
+	static const char* views[] = { "left", "right", "stereo" };
+	for (int view = 0; view < CULL_VIEWS; view++) {
+		bounds.Frustum = &frustums[view];
+		for (int i = 0; i < MATH_CHECK_BOUNDS; i++) {
+			boxMargins[i] = MathCheck_BoundsMargin(bounds.Frustum, bounds.Mins[i], bounds.Maxs[i], 0.0f);
+			sphereMargins[i] = MathCheck_BoundsMargin(bounds.Frustum, bounds.Spheres[i], bounds.Spheres[i], bounds.Spheres[i][3]);
+			// the stereo frustum must keep everything either eye sees
+			if (view == CULL_STEREO && boxMargins[i] < 0.0 && (MathCheck_BoundsMargin(&frustums[CULL_LEFT], bounds.Mins[i], bounds.Maxs[i], 0.0f) > 1e-4
+				|| MathCheck_BoundsMargin(&frustums[CULL_RIGHT], bounds.Mins[i], bounds.Maxs[i], 0.0f) > 1e-4)) {
+				if (passed)
+					ALOGE("Math ovrFrustum stereo: box %d is seen by an eye but culled", i);
+				passed = false;
+			}
+		}
+		const char* names[] = { "boxes", "spheres" };
+		void (*loops[])(ovrMathBounds* bounds) = { MathCheck_BoxesLoop, MathCheck_SpheresLoop };
+		void (*batches[])(ovrMathBounds* bounds) = { MathCheck_BoxesBatch, MathCheck_SpheresBatch };
+		void (*splits[])(ovrMathBounds* bounds) = { MathCheck_BoxesJobs, MathCheck_SpheresJobs };
+		const double* margins[] = { boxMargins, sphereMargins };
+		for (int kind = 0; kind < 2; kind++) {
+			const double loop = MathCheck_BoundsRate(loops[kind], &bounds);
+			const int loopWrong = MathCheck_BoundsWrong(&bounds, margins[kind], 1e-4);
+			const double batch = MathCheck_BoundsRate(batches[kind], &bounds);
+			const int batchWrong = MathCheck_BoundsWrong(&bounds, margins[kind], 1e-4);
+			const int visible = bounds.VisibleCount;
+			const double split = MathCheck_BoundsRate(splits[kind], &bounds);
+			const int splitWrong = MathCheck_BoundsWrong(&bounds, margins[kind], 1e-4);
+			ALOGI("Math cull %-6s %-7s %.2f ns, loop %.2f ns (%.2fx), %d workers %.2f ns per bound | %d of %d visible, %d wrong",
+				views[view], names[kind], 1e9 / batch, 1e9 / loop, batch / loop, jobs->ThreadCount, 1e9 / split,
+				visible, MATH_CHECK_BOUNDS, loopWrong + batchWrong + splitWrong);
+			if (loopWrong + batchWrong + splitWrong) {
+				ALOGE("Math cull %s %s: %d loop, %d batch and %d split results on the wrong side", views[view], names[kind], loopWrong, batchWrong, splitWrong);
+				passed = false;
+			}
+		}
+	}
+	free(bounds.Mins);
+	free(bounds.Spheres);
+	free(bounds.Visible);
+	free(boxMargins);
+	return passed;
+}
+
+// a filter selects the routines whose names contain it, and the sections timing any of the batch routines named
+static bool MathCheck_Selected(const char* filter, const char* name) {
+	return !filter || strstr(name, filter);
+}
+
+bool MathCheck_Run(ovrJobQueue* jobs, const char* filter) {
+	float* a = (float*)malloc(MATH_CHECK_INPUTS * 16 * sizeof(float));
+	float* b = (float*)malloc(MATH_CHECK_INPUTS * 16 * sizeof(float));
+	float* out = (float*)malloc(MATH_CHECK_INPUTS * 16 * sizeof(float));
+	float* caseA = (float*)malloc(MATH_CHECK_INPUTS * 16 * sizeof(float));
+	float* caseB = (float*)malloc(MATH_CHECK_INPUTS * 16 * sizeof(float));
+	unsigned int seed = 0x2545f491;
+	for (int i = 0; i < MATH_CHECK_INPUTS * 16; i++) {
+		a[i] = MathCheck_Random(&seed);
+		b[i] = MathCheck_Random(&seed);
+	}
+	ALOGI("Math check, %s path", MATH_SIMD_NAME);
+	bool passed = true;
+	int routines = 0, failedRoutines = 0;
+	for (size_t c = 0; c < sizeof(MathCases) / sizeof(MathCases[0]); c++) {
+		const ovrMathCase* test = &MathCases[c];
+		if (!MathCheck_Selected(filter, test->Name))
+			continue;
+		memcpy(caseA, a, MATH_CHECK_INPUTS * 16 * sizeof(float));
+		memcpy(caseB, b, MATH_CHECK_INPUTS * 16 * sizeof(float));
+		if (test->Input)
+			for (int i = 0; i < MATH_CHECK_INPUTS; i++)
+				test->Input(caseA + i * test->SizeA, caseB + i * test->SizeB, i);
+		const float tolerance = test->Tolerance ? test->Tolerance : MATH_CHECK_TOLERANCE;
+		long long maxUlps = 0;
+		float maxError = 0.0f;
+		int exact = 0, failed = 0, checked = 0;
+		for (int i = 0; i < MATH_CHECK_INPUTS; i++) {
+			const float* ia = caseA + i * test->SizeA;
+			const float* ib = caseB + i * test->SizeB;
+			float got[16], expected[16], magnitude[16];
+			test->Run(ia, ib, got);
+			test->Reference(ia, ib, expected, magnitude);
+			for (int j = 0; j < test->SizeOut; j++, checked++) {
+				const long long ulps = MathCheck_Ulps(got[j], expected[j]);
+				if (ulps > maxUlps)
+					maxUlps = ulps;
+				if (ulps == 0) {
+					exact++;
+					continue;
+				}
+				// the error in units of the bound, 1 is on it
+				const float error = magnitude[j] ? fabsf(got[j] - expected[j]) / (tolerance * magnitude[j]) : FLT_MAX;
+				if (error > maxError)
+					maxError = error;
+				if (error > 1.0f) {
+					if (!failed)
+						ALOGE("Math %s input %d [%d]: %.9g, expected %.9g", test->Name, i, j, got[j], expected[j]);
+					failed++;
+				}
+			}
+		}
+		const double calls = MathCheck_Bench(test, false, caseA, caseB, out);
+		const double referenceCalls = MathCheck_Bench(test, true, caseA, caseB, out);
+		ALOGI("Math %-32s %7.2f ns, reference %7.2f ns, %.2fx | max %lld ulp, %.2f of the bound, %.1f%% exact, %d failed",
+			test->Name, 1e9 / calls, 1e9 / referenceCalls, calls / referenceCalls,
+			maxUlps, maxError, exact * 100.0 / checked, failed);
+		routines++;
+		if (failed) {
+			failedRoutines++;
+			passed = false;
+		}
+	}
+	if (MathCheck_Selected(filter, "Matrix4x4_VectorTransformBatch Matrix3x4_ConcatTransformsBatch") && !MathCheck_Batch(jobs, &seed))
+		passed = false;
+	if (MathCheck_Selected(filter, "QuaternionBlendBatch") && !MathCheck_Bones(jobs, &seed))
+		passed = false;
+	if (MathCheck_Selected(filter, "FloatToHalfBatch HalfToFloatBatch") && !MathCheck_Halves(&seed))
+		passed = false;
+	if (MathCheck_Selected(filter, "ovrFrustum_CullBoxes ovrFrustum_CullSpheres") && !MathCheck_Cull(jobs, &seed))
+		passed = false;
+#if MATH_SIMD
+	if (MathCheck_Selected(filter, "Simd_SinCos") && !MathCheck_SinCos(&seed))
+		passed = false;
+#endif
+	ALOGI("Math check %s: %d routines, %d outside their bounds", passed ? "passed" : "failed", routines, failedRoutines);
+	free(a);
+	free(b);
+	free(out);
+	free(caseA);
+	free(caseB);
+	return passed;
+}
+
+#ifdef MATH_CHECK_MAIN
+/*
+================================================================================
+Standalone
+
+The same check as a program of its own, so the numbers for a change can be had
+without a headset: on the desktop for the SSE path, under user mode emulation
+for the NEON one, and with -DMATH_NO_SIMD for the scalar code. From this
+directory:
+
+	g++ -std=c++14 -O2 -DMATH_CHECK_MAIN -I. -I../../lib/quest -include pch.h \
+		MathCheck.cpp HostApi.cpp Culling.cpp lib/Math.cpp -lpthread -o mathcheck
+	aarch64-linux-gnu-g++ -static ... && qemu-aarch64 ./mathcheck
+
+Emulated timings only compare routines with each other, ulps and failures are
+exact. An argument runs only the routines whose names contain it. The exit code
+is 0 when everything is within its bound.
+================================================================================
+*/
+
+#ifndef __ANDROID__
+// the job queue's clock, without libvrapi
+extern "C" double vrapi_GetTimeInSeconds() {
+	return MathCheck_Time();
+}
+#endif
+
+int main(int argc, char* argv[]) {
+	ovrJobQueue jobs;
+	if (!ovrJobQueue_Create(&jobs))
+		return 2;
+	const bool passed = MathCheck_Run(&jobs, argc > 1 ? argv[1] : NULL);
+	ovrJobQueue_Destroy(&jobs);
+	return passed ? 0 : 1;
+}
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+
+/*
+================================================================================
+MathCheck
+
+Startup diagnostic for lib/Math, run with --mathcheck, or on its own on a
+desktop or under emulation when built with MATH_CHECK_MAIN (see the end of
+MathCheck.cpp). Every public routine is compared over random inputs with a
+reference, plain loops in the scalar summation order or double precision
+from the formula, then both are timed: one line per routine gives ns per
+call, max ulp, the max error as a fraction of its bound and the failures, so
+a change to either can be judged by numbers. The batch routines are timed
+against a loop of single calls, on the caller and split over the job queue,
+and so is frustum culling against a double precision plane test. The vector
+helpers are timed against the loops they replaced.
+================================================================================
+*/
+
+#include "HostApi.h"
+
+// Logs one line per routine whose name contains filter, all of them if it is NULL; returns false if any result
+// is outside its error bound.
+bool MathCheck_Run(ovrJobQueue* jobs, const char* filter);
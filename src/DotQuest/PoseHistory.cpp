@@ -0,0 +1,143 @@
+#include <VrApi.h>
+
+#include "PoseHistory.h"
+#include "lib/Math.h"
+
+/*
+================================================================================
+ovrPoseHistory
+================================================================================
+*/
+
+void ovrPoseHistory_Init(ovrPoseHistory* history) {
+	memset(history, 0, sizeof(ovrPoseHistory));
+}
+
+void ovrPoseSample_Set(ovrPoseSample* pose, const ovrRigidBodyPosef* source, unsigned int status) {
+	pose->Orientation[0] = source->Pose.Orientation.x;
+	pose->Orientation[1] = source->Pose.Orientation.y;
+	pose->Orientation[2] = source->Pose.Orientation.z;
+	pose->Orientation[3] = source->Pose.Orientation.w;
+	pose->Position[0] = source->Pose.Position.x;
+	pose->Position[1] = source->Pose.Position.y;
+	pose->Position[2] = source->Pose.Position.z;
+	pose->AngularVelocity[0] = source->AngularVelocity.x;
+	pose->AngularVelocity[1] = source->AngularVelocity.y;
+	pose->AngularVelocity[2] = source->AngularVelocity.z;
+	pose->LinearVelocity[0] = source->LinearVelocity.x;
+	pose->LinearVelocity[1] = source->LinearVelocity.y;
+	pose->LinearVelocity[2] = source->LinearVelocity.z;
+	pose->Status = status;
+}
+
+void ovrPoseHistory_Record(ovrPoseHistory* history, double time, const ovrPoseSample poses[POSE_DEVICES]) {
+	const long long index = history->Written;
+	ovrPoseHistorySlot* slot = &history->Slots[index % POSE_HISTORY_SIZE];
+	// the same odd then even order as ovrFrameData_Publish, with the index in the sequence so a reader also
+	// notices when the slot it wanted has since been reused
+	__atomic_store_n(&slot->Sequence, 2 * index + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->Time = time;
+	memcpy(slot->Poses, poses, sizeof(slot->Poses));
+	__atomic_store_n(&slot->Sequence, 2 * index + 2, __ATOMIC_RELEASE);
+	__atomic_store_n(&history->Written, index + 1, __ATOMIC_RELEASE);
+}
+
+// The time of sample index and, if pose is not NULL, the device's pose in it. False if the slot is being
+// written or already holds a later sample.
+static bool ovrPoseHistory_Read(const ovrPoseHistory* history, long long index, int device, double* time, ovrPoseSample* pose) {
+	const ovrPoseHistorySlot* slot = &history->Slots[index % POSE_HISTORY_SIZE];
+	const long long sequence = 2 * index + 2;
+	if (__atomic_load_n(&slot->Sequence, __ATOMIC_ACQUIRE) != sequence)
+		return false;
+	*time = slot->Time;
+	if (pose)
+		*pose = slot->Poses[device];
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&slot->Sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+static void ovrPoseSample_Interpolate(ovrPoseSample* pose, const ovrPoseSample* a, const ovrPoseSample* b, float f) {
+	// a device that lost tracking on either side has nothing to blend toward, keep the nearer sample
+	if (!a->Status || !b->Status) {
+		*pose = f < 0.5f ? *a : *b;
+		return;
+	}
+	Math::QuaternionSlerp(a->Orientation, b->Orientation, f, pose->Orientation);
+	Vec_Lerp(Vec<3>::Load(a->Position), f, Vec<3>::Load(b->Position)).Store(pose->Position);
+	Vec_Lerp(Vec<3>::Load(a->AngularVelocity), f, Vec<3>::Load(b->AngularVelocity)).Store(pose->AngularVelocity);
+	Vec_Lerp(Vec<3>::Load(a->LinearVelocity), f, Vec<3>::Load(b->LinearVelocity)).Store(pose->LinearVelocity);
+	pose->Status = a->Status & b->Status;
+}
+
+// Constant velocities over seconds: the position along the linear one, the orientation turned about the world
+// axis of the angular one.
+static void ovrPoseSample_Extrapolate(ovrPoseSample* pose, const ovrPoseSample* source, float seconds) {
+	*pose = *source;
+	if (!source->Status || seconds <= 0.0f)
+		return;
+	const Vec<3> position = Vec_MA(Vec<3>::Load(source->Position), seconds, Vec<3>::Load(source->LinearVelocity));
+	position.Store(pose->Position);
+	const Vec<3> angular = Vec<3>::Load(source->AngularVelocity);
+	const float speed = Vec_Length(angular);
+	const float angle = speed * seconds;
+	if (angle < 1e-6f)
+		return;
+	// d * q, with d the rotation by angle about the axis
+	const Vec<3> axis = angular * (sinf(angle * 0.5f) / speed);
+	const float dw = cosf(angle * 0.5f);
+	const float* q = source->Orientation;
+	Vec4(dw * q[0] + axis[0] * q[3] + axis[1] * q[2] - axis[2] * q[1],
+		dw * q[1] - axis[0] * q[2] + axis[1] * q[3] + axis[2] * q[0],
+		dw * q[2] + axis[0] * q[1] - axis[1] * q[0] + axis[2] * q[3],
+		dw * q[3] - axis[0] * q[0] - axis[1] * q[1] - axis[2] * q[2]).Store(pose->Orientation);
+}
+
+bool ovrPoseHistory_Get(const ovrPoseHistory* history, int device, double time, ovrPoseSample* pose) {
+	memset(pose, 0, sizeof(ovrPoseSample));
+	if (device < 0 || device >= POSE_DEVICES)
+		return false;
+	// any read that overlaps the writer starts the search over; it writes once a frame, so that is rare
+	for (;;) {
+		const long long written = __atomic_load_n(&history->Written, __ATOMIC_ACQUIRE);
+		if (!written)
+			return false;
+		long long newer = written - 1;
+		double newerTime;
+		ovrPoseSample newerPose;
+		if (!ovrPoseHistory_Read(history, newer, device, &newerTime, &newerPose))
+			continue;
+		if (time >= newerTime) {
+			const double ahead = time - newerTime;
+			ovrPoseSample_Extrapolate(pose, &newerPose, (float)(ahead < POSE_MAX_PREDICTION ? ahead : POSE_MAX_PREDICTION));
+			return true;
+		}
+		// most queries are near the present, so walk back from the newest sample
+		const long long oldest = written > POSE_HISTORY_SIZE ? written - POSE_HISTORY_SIZE : 0;
+		bool torn = false;
+		for (long long older = newer - 1; older >= oldest; older--) {
+			double olderTime;
+			if (!ovrPoseHistory_Read(history, older, device, &olderTime, NULL)) {
+				torn = true;
+				break;
+			}
+			if (olderTime <= time) {
+				ovrPoseSample olderPose;
+				if (!ovrPoseHistory_Read(history, older, device, &olderTime, &olderPose) ||
+					!ovrPoseHistory_Read(history, newer, device, &newerTime, &newerPose)) {
+					torn = true;
+					break;
+				}
+				const double span = newerTime - olderTime;
+				ovrPoseSample_Interpolate(pose, &olderPose, &newerPose, span > 0.0 ? (float)((time - olderTime) / span) : 1.0f);
+				return true;
+			}
+			newer = older;
+		}
+		if (torn)
+			continue;
+		// before the oldest sample kept
+		if (ovrPoseHistory_Read(history, newer, device, &newerTime, pose))
+			return false;
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "VrApi.h"
+
+/*
+================================================================================
+ovrPoseHistory
+
+The head and controller poses of the last frames with the display times they
+were predicted for, in a ring the frame loop fills once a frame from the
+tracking it already samples. Any thread can ask for a pose at a time inside the
+ring, interpolated between the two samples around it, or up to
+POSE_MAX_PREDICTION past the newest, extrapolated from its velocities. Readers
+take no lock: each slot carries its own sequence, odd while the writer is in
+it, and a reader that sees it change under it starts over.
+================================================================================
+*/
+
+#define POSE_HISTORY_SIZE		64						// a little under a second at 72 Hz
+#define POSE_MAX_PREDICTION		0.1						// seconds past the newest sample
+
+enum {
+	POSE_HEAD,
+	POSE_LEFT,
+	POSE_RIGHT,
+	POSE_DEVICES
+};
+
+typedef struct {
+	float					Orientation[4];			// x, y, z, w
+	float					Position[3];
+	float					AngularVelocity[3];		// radians per second, world axes
+	float					LinearVelocity[3];		// meters per second
+	unsigned int			Status;					// ovrTrackingStatus, 0 while the device is not tracked
+} ovrPoseSample;
+
+typedef struct {
+	volatile long long		Sequence;				// 2 * index + 1 while written, 2 * index + 2 once done
+	double					Time;
+	ovrPoseSample			Poses[POSE_DEVICES];
+} ovrPoseHistorySlot;
+
+typedef struct {
+	ovrPoseHistorySlot		Slots[POSE_HISTORY_SIZE];
+	volatile long long		Written;				// samples recorded since Init
+} ovrPoseHistory;
+
+void ovrPoseHistory_Init(ovrPoseHistory* history);
+void ovrPoseSample_Set(ovrPoseSample* pose, const ovrRigidBodyPosef* source, unsigned int status);
+// Only one thread may record, with times that never go backwards.
+void ovrPoseHistory_Record(ovrPoseHistory* history, double time, const ovrPoseSample poses[POSE_DEVICES]);
+// The POSE_* device at time. Times before the oldest sample get the oldest pose and return false, as does an
+// empty history; times past the newest are extrapolated no further than POSE_MAX_PREDICTION.
+bool ovrPoseHistory_Get(const ovrPoseHistory* history, int device, double time, ovrPoseSample* pose);
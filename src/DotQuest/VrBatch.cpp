@@ -0,0 +1,258 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER		0x8F3F
+#endif
+typedef void (GL_APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTEXT)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+static PFNGLMULTIDRAWELEMENTSINDIRECTEXT glMultiDrawElementsIndirectEXT_;
+
+/*
+================================================================================
+ovrDrawBatcher
+================================================================================
+*/
+
+const ovrProgramSource ovrDrawBatcher_DefaultProgram = {
+	"#version 300 es\n"
+	"in vec3 vertexPosition;\n"
+	"in vec4 vertexColor;\n"
+	"in vec2 vertexUv;\n"
+	"in mat4 vertexTransform;\n"
+	"uniform SceneMatrices\n"
+	"{\n"
+	"	uniform mat4 ViewMatrix;\n"
+	"	uniform mat4 ProjectionMatrix;\n"
+	"} sm;\n"
+	"out lowp vec4 fragmentColor;\n"
+	"out highp vec2 fragmentUv;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = sm.ProjectionMatrix * (sm.ViewMatrix * (vertexTransform * vec4(vertexPosition, 1.0)));\n"
+	"	fragmentColor = vertexColor;\n"
+	"	fragmentUv = vertexUv;\n"
+	"}\n",
+
+	"#version 300 es\n"
+	"uniform sampler2D Texture0;\n"
+	"in lowp vec4 fragmentColor;\n"
+	"in highp vec2 fragmentUv;\n"
+	"out lowp vec4 outColor;\n"
+	"void main()\n"
+	"{\n"
+	"	outColor = texture(Texture0, fragmentUv) * fragmentColor;\n"
+	"}\n"
+};
+
+void ovrDrawBatcher_Create(ovrDrawBatcher* batcher, int capacity) {
+	memset(batcher, 0, sizeof(ovrDrawBatcher));
+	batcher->Capacity = capacity;
+	batcher->Draws = (ovrBatchDraw*)malloc(capacity * sizeof(ovrBatchDraw));
+	batcher->Transforms = (ovrMatrix4f*)malloc(capacity * sizeof(ovrMatrix4f));
+	batcher->Commands = (ovrBatchIndirect*)malloc(capacity * sizeof(ovrBatchIndirect));
+	batcher->Runs = (ovrBatchRun*)malloc(capacity * sizeof(ovrBatchRun));
+
+	GL(glGenBuffers(1, &batcher->InstanceBuffer));
+	GL(glBindBuffer(GL_ARRAY_BUFFER, batcher->InstanceBuffer));
+	GL(glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(ovrMatrix4f), NULL, GL_STREAM_DRAW));
+	GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	// Without a base instance every indirect command would read the transforms from instance zero.
+	const char* allExtensions = (const char*)glGetString(GL_EXTENSIONS);
+	if (allExtensions && strstr(allExtensions, "GL_EXT_multi_draw_indirect") && strstr(allExtensions, "GL_EXT_base_instance"))
+		glMultiDrawElementsIndirectEXT_ = (PFNGLMULTIDRAWELEMENTSINDIRECTEXT)eglGetProcAddress("glMultiDrawElementsIndirectEXT");
+	batcher->MultiDrawIndirect = glMultiDrawElementsIndirectEXT_ != NULL;
+	if (batcher->MultiDrawIndirect) {
+		GL(glGenBuffers(1, &batcher->IndirectBuffer));
+		GL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batcher->IndirectBuffer));
+		GL(glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity * sizeof(ovrBatchIndirect), NULL, GL_STREAM_DRAW));
+		GL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+	}
+	ALOGV("ovrDrawBatcher: %d instances, %s", capacity, batcher->MultiDrawIndirect ? "multi-draw indirect" : "instanced");
+}
+
+void ovrDrawBatcher_Destroy(ovrDrawBatcher* batcher) {
+	GL(glDeleteBuffers(1, &batcher->InstanceBuffer));
+	if (batcher->IndirectBuffer) {
+		GL(glDeleteBuffers(1, &batcher->IndirectBuffer));
+	}
+	free(batcher->Draws);
+	free(batcher->Transforms);
+	free(batcher->Commands);
+	free(batcher->Runs);
+	memset(batcher, 0, sizeof(ovrDrawBatcher));
+}
+
+bool ovrDrawBatcher_Add(ovrDrawBatcher* batcher, const ovrProgram* program, const ovrMesh* mesh, GLuint texture, const ovrMatrix4f* transforms, int count) {
+	if (batcher->DrawCount + count > batcher->Capacity) {
+		ALOGE("ovrDrawBatcher: out of space for %d instances", count);
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		ovrBatchDraw* draw = &batcher->Draws[batcher->DrawCount];
+		draw->Program = program;
+		draw->VertexArrayObject = mesh->VertexArrayObject;
+		draw->Texture = texture;
+		draw->FirstIndex = mesh->FirstIndex;
+		draw->IndexCount = mesh->IndexCount;
+		draw->Instance = batcher->DrawCount;
+		batcher->Transforms[batcher->DrawCount] = transforms[i];
+		batcher->DrawCount++;
+	}
+	return true;
+}
+
+static int ovrBatchDraw_Compare(const void* a, const void* b) {
+	const ovrBatchDraw* da = (const ovrBatchDraw*)a;
+	const ovrBatchDraw* db = (const ovrBatchDraw*)b;
+	if (da->Program->Program != db->Program->Program) return da->Program->Program < db->Program->Program ? -1 : 1;
+	if (da->VertexArrayObject != db->VertexArrayObject) return da->VertexArrayObject < db->VertexArrayObject ? -1 : 1;
+	if (da->Texture != db->Texture) return da->Texture < db->Texture ? -1 : 1;
+	if (da->FirstIndex != db->FirstIndex) return da->FirstIndex < db->FirstIndex ? -1 : 1;
+	if (da->IndexCount != db->IndexCount) return da->IndexCount < db->IndexCount ? -1 : 1;
+	return da->Instance - db->Instance;
+}
+
+// Sorts the draws, writes the transforms in draw order so every mesh's instances are contiguous,
+// and builds the indirect commands and the runs that share program, geometry and texture.
+void ovrDrawBatcher_Upload(ovrDrawBatcher* batcher) {
+	batcher->CommandCount = 0;
+	batcher->RunCount = 0;
+	if (batcher->DrawCount == 0)
+		return;
+	qsort(batcher->Draws, batcher->DrawCount, sizeof(ovrBatchDraw), ovrBatchDraw_Compare);
+
+	GL(glBindBuffer(GL_ARRAY_BUFFER, batcher->InstanceBuffer));
+	GL(ovrMatrix4f* instances = (ovrMatrix4f*)glMapBufferRange(GL_ARRAY_BUFFER, 0, batcher->DrawCount * sizeof(ovrMatrix4f),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+	if (!instances) {
+		ALOGE("ovrDrawBatcher: glMapBufferRange failed");
+		GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+		batcher->DrawCount = 0;
+		return;
+	}
+	for (int i = 0; i < batcher->DrawCount; i++) {
+		const ovrBatchDraw* draw = &batcher->Draws[i];
+		// rows become the attribute columns, so the shader sees the transform it expects
+		instances[i] = ovrMatrix4f_Transpose(&batcher->Transforms[draw->Instance]);
+
+		const ovrBatchDraw* prev = i > 0 ? &batcher->Draws[i - 1] : NULL;
+		const bool sameRun = prev && prev->Program->Program == draw->Program->Program
+			&& prev->VertexArrayObject == draw->VertexArrayObject && prev->Texture == draw->Texture;
+		const bool sameMesh = sameRun && prev->FirstIndex == draw->FirstIndex && prev->IndexCount == draw->IndexCount;
+		if (sameMesh) {
+			batcher->Commands[batcher->CommandCount - 1].InstanceCount++;
+			continue;
+		}
+		if (!sameRun) {
+			ovrBatchRun* run = &batcher->Runs[batcher->RunCount++];
+			run->VertexArrayObject = draw->VertexArrayObject;
+			run->Program = draw->Program;
+			run->Texture = draw->Texture;
+			run->FirstCommand = batcher->CommandCount;
+			run->CommandCount = 0;
+		}
+		ovrBatchIndirect* command = &batcher->Commands[batcher->CommandCount++];
+		command->Count = draw->IndexCount;
+		command->InstanceCount = 1;
+		command->FirstIndex = draw->FirstIndex;
+		command->BaseVertex = 0;
+		command->BaseInstance = i;
+		batcher->Runs[batcher->RunCount - 1].CommandCount++;
+	}
+	GL(glUnmapBuffer(GL_ARRAY_BUFFER));
+	GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	if (batcher->MultiDrawIndirect) {
+		GL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batcher->IndirectBuffer));
+		GL(glBufferData(GL_DRAW_INDIRECT_BUFFER, batcher->Capacity * sizeof(ovrBatchIndirect), NULL, GL_STREAM_DRAW));
+		GL(glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, batcher->CommandCount * sizeof(ovrBatchIndirect), batcher->Commands));
+		GL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+	}
+}
+
+// Points the transform attribute of the bound vertex array at the instance buffer, starting at the given instance.
+static void ovrDrawBatcher_BindInstances(ovrDrawBatcher* batcher, int firstInstance) {
+	GL(glBindBuffer(GL_ARRAY_BUFFER, batcher->InstanceBuffer));
+	for (int i = 0; i < 4; i++) {
+		const GLuint location = VERTEX_ATTRIBUTE_LOCATION_TRANSFORM + i;
+		GL(glEnableVertexAttribArray(location));
+		GL(glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(ovrMatrix4f),
+			(const GLvoid*)(firstInstance * sizeof(ovrMatrix4f) + i * 4 * sizeof(float))));
+		GL(glVertexAttribDivisor(location, 1));
+	}
+	GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
+// The vertex arrays are shared by every mesh of a heap, draws without instances read the transform as a constant.
+static void ovrDrawBatcher_UnbindInstances() {
+	for (int i = 0; i < 4; i++) {
+		const GLuint location = VERTEX_ATTRIBUTE_LOCATION_TRANSFORM + i;
+		GL(glVertexAttribDivisor(location, 0));
+		GL(glDisableVertexAttribArray(location));
+	}
+}
+
+void ovrDrawBatcher_Draw(ovrDrawBatcher* batcher, int eye, GLuint sceneMatrices, int sceneMatricesStride) {
+	renderState state;
+	getCurrentRenderState(&state);
+	batcher->DrawCalls = 0;
+	GLuint program = 0;
+	GLuint texture = 0;
+	if (batcher->MultiDrawIndirect) {
+		GL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batcher->IndirectBuffer));
+	}
+	GL(glActiveTexture(GL_TEXTURE0));
+	for (int r = 0; r < batcher->RunCount; r++) {
+		const ovrBatchRun* run = &batcher->Runs[r];
+		if (run->Program->Program != program) {
+			program = run->Program->Program;
+			GL(glUseProgram(program));
+			if (run->Program->UniformBinding[UNIFORM_SCENE_MATRICES] >= 0) {
+				GL(glBindBufferRange(GL_UNIFORM_BUFFER, run->Program->UniformBinding[UNIFORM_SCENE_MATRICES], sceneMatrices,
+					eye * sceneMatricesStride, sizeof(ovrSceneMatrices)));
+			}
+			if (run->Program->UniformLocation[UNIFORM_VIEW_ID] >= 0) {
+				GL(glUniform1i(run->Program->UniformLocation[UNIFORM_VIEW_ID], eye));
+			}
+		}
+		if (run->Texture != texture) {
+			texture = run->Texture;
+			GL(glBindTexture(GL_TEXTURE_2D, texture));
+		}
+		GL(glBindVertexArray(run->VertexArrayObject));
+		if (batcher->MultiDrawIndirect) {
+			ovrDrawBatcher_BindInstances(batcher, 0);
+			GL(glMultiDrawElementsIndirectEXT_(GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*)(run->FirstCommand * sizeof(ovrBatchIndirect)),
+				run->CommandCount, sizeof(ovrBatchIndirect)));
+			batcher->DrawCalls++;
+			ovrDrawBatcher_UnbindInstances();
+			continue;
+		}
+		for (int c = run->FirstCommand; c < run->FirstCommand + run->CommandCount; c++) {
+			const ovrBatchIndirect* command = &batcher->Commands[c];
+			ovrDrawBatcher_BindInstances(batcher, command->BaseInstance);
+			GL(glDrawElementsInstanced(GL_TRIANGLES, command->Count, GL_UNSIGNED_INT, (const GLvoid*)(command->FirstIndex * sizeof(GLuint)), command->InstanceCount));
+			batcher->DrawCalls++;
+		}
+		ovrDrawBatcher_UnbindInstances();
+	}
+	if (batcher->MultiDrawIndirect) {
+		GL(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+	}
+	GL(glBindTexture(GL_TEXTURE_2D, 0));
+	restoreRenderState(&state);
+}
+
+void ovrDrawBatcher_Reset(ovrDrawBatcher* batcher) {
+	batcher->DrawCount = 0;
+	batcher->CommandCount = 0;
+	batcher->RunCount = 0;
+}
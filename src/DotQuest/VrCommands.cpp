@@ -0,0 +1,437 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+#include "Culling.h"
+
+/*
+================================================================================
+ovrCommandBuffer
+================================================================================
+*/
+
+const ovrProgramSource ovrCommandBuffer_DefaultProgram = {
+	"#version 300 es\n"
+	"in vec3 vertexPosition;\n"
+	"in vec4 vertexColor;\n"
+	"in vec2 vertexUv;\n"
+	"in mat4 vertexTransform;\n"
+	"uniform SceneMatrices\n"
+	"{\n"
+	"	uniform mat4 ViewMatrix;\n"
+	"	uniform mat4 ProjectionMatrix;\n"
+	"} sm;\n"
+	"out lowp vec4 fragmentColor;\n"
+	"out highp vec2 fragmentUv;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_Position = sm.ProjectionMatrix * (sm.ViewMatrix * (vertexTransform * vec4(vertexPosition, 1.0)));\n"
+	"	fragmentColor = vertexColor;\n"
+	"	fragmentUv = vertexUv;\n"
+	"}\n",
+
+	"#version 300 es\n"
+	"uniform sampler2D Texture0;\n"
+	"uniform lowp vec4 Color;\n"
+	"in lowp vec4 fragmentColor;\n"
+	"in highp vec2 fragmentUv;\n"
+	"out lowp vec4 outColor;\n"
+	"void main()\n"
+	"{\n"
+	"	outColor = texture(Texture0, fragmentUv) * fragmentColor * Color;\n"
+	"}\n"
+};
+
+// Shorter runs of draws are cheaper drawn one by one than uploaded.
+#define COMMAND_BATCH_MIN_DRAWS	4
+
+static GLint SceneMatricesStride;
+
+// Smallest valid size of each command, header included.
+static int ovrCommand_MinimumSize(int op) {
+	switch (op) {
+		case COMMAND_SET_LAYER: return sizeof(ovrCommand) + 4;
+		case COMMAND_CLEAR: return sizeof(ovrCommand) + 4 + 5 * 4;
+		case COMMAND_SET_PROGRAM: return sizeof(ovrCommand) + 4;
+		case COMMAND_SET_GEOMETRY: return sizeof(ovrCommand) + 4;
+		case COMMAND_SET_TEXTURE: return sizeof(ovrCommand) + 2 * 4;
+		case COMMAND_SET_UNIFORM: return sizeof(ovrCommand) + 4 + 4 * 4;
+		case COMMAND_DRAW: return sizeof(ovrCommand) + 16 * 4;
+		default: return 0;
+	}
+}
+
+bool ovrCommandBuffer_Create(ovrCommandBuffer* commands, ovrProgramCache* cache, int capacity, bool validate) {
+	memset(commands, 0, sizeof(ovrCommandBuffer));
+	commands->Capacity = capacity;
+	commands->Validate = validate;
+	commands->Data = (unsigned char*)malloc(capacity);
+	if (!commands->Data)
+		return false;
+
+	if (!ovrProgram_Create(&commands->DefaultProgram, cache, ovrCommandBuffer_DefaultProgram.VertexSource, ovrCommandBuffer_DefaultProgram.FragmentSource)) {
+		ALOGE("ovrCommandBuffer: unable to create the default program");
+		free(commands->Data);
+		commands->Data = NULL;
+		return false;
+	}
+	GL(glUseProgram(commands->DefaultProgram.Program));
+	GL(glUniform4f(commands->DefaultProgram.UniformLocation[UNIFORM_COLOR], 1.0f, 1.0f, 1.0f, 1.0f));
+	GL(glUseProgram(0));
+	ovrCommandBuffer_AddProgram(commands, &commands->DefaultProgram);
+
+	const unsigned char white[4] = { 255, 255, 255, 255 };
+	GL(glGenTextures(1, &commands->WhiteTexture));
+	GL(glBindTexture(GL_TEXTURE_2D, commands->WhiteTexture));
+	GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white));
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GL(glBindTexture(GL_TEXTURE_2D, 0));
+	ovrCommandBuffer_AddTexture(commands, commands->WhiteTexture);
+
+	// one range per eye, each aligned for glBindBufferRange
+	GLint alignment = 256;
+	GL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+	SceneMatricesStride = ((GLint)sizeof(ovrSceneMatrices) + alignment - 1) / alignment * alignment;
+	GL(glGenBuffers(1, &commands->SceneMatrices));
+	GL(glBindBuffer(GL_UNIFORM_BUFFER, commands->SceneMatrices));
+	GL(glBufferData(GL_UNIFORM_BUFFER, VRAPI_FRAME_LAYER_EYE_MAX * SceneMatricesStride, NULL, GL_DYNAMIC_DRAW));
+	GL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+
+	// a run can be as long as a buffer full of draws
+	ovrDrawBatcher_Create(&commands->Batcher, capacity / ovrCommand_MinimumSize(COMMAND_DRAW));
+	return true;
+}
+
+void ovrCommandBuffer_Destroy(ovrCommandBuffer* commands) {
+	if (commands->Batcher.Capacity)
+		ovrDrawBatcher_Destroy(&commands->Batcher);
+	if (commands->SceneMatrices) {
+		GL(glDeleteBuffers(1, &commands->SceneMatrices));
+	}
+	if (commands->WhiteTexture) {
+		GL(glDeleteTextures(1, &commands->WhiteTexture));
+	}
+	ovrProgram_Destroy(&commands->DefaultProgram);
+	free(commands->Data);
+	memset(commands, 0, sizeof(ovrCommandBuffer));
+}
+
+int ovrCommandBuffer_AddProgram(ovrCommandBuffer* commands, const ovrProgram* program) {
+	if (commands->ProgramCount == MAX_COMMAND_PROGRAMS)
+		return -1;
+	commands->Programs[commands->ProgramCount] = program;
+	return commands->ProgramCount++;
+}
+
+int ovrCommandBuffer_AddMesh(ovrCommandBuffer* commands, const ovrMesh* mesh) {
+	if (commands->MeshCount == MAX_COMMAND_MESHES)
+		return -1;
+	commands->Meshes[commands->MeshCount] = *mesh;
+	return commands->MeshCount++;
+}
+
+int ovrCommandBuffer_AddTexture(ovrCommandBuffer* commands, GLuint texture) {
+	if (commands->TextureCount == MAX_COMMAND_TEXTURES)
+		return -1;
+	commands->Textures[commands->TextureCount] = texture;
+	return commands->TextureCount++;
+}
+
+void ovrCommandBuffer_ReplaceTexture(ovrCommandBuffer* commands, int handle, GLuint texture) {
+	// handle 0 is the white texture every unbound unit falls back to
+	if (handle > 0 && handle < commands->TextureCount)
+		commands->Textures[handle] = texture;
+}
+
+// Walks the whole stream before anything is executed, so a bad stream never leaves a half-rendered frame.
+static bool ovrCommandBuffer_Check(const ovrCommandBuffer* commands, int size) {
+	bool program = false;
+	bool geometry = false;
+	for (int offset = 0; offset < size; ) {
+		if (size - offset < (int)sizeof(ovrCommand)) {
+			ALOGE("ovrCommandBuffer: truncated command at %d", offset);
+			return false;
+		}
+		const ovrCommand* command = (const ovrCommand*)(commands->Data + offset);
+		const unsigned int* args = (const unsigned int*)(command + 1);
+		const int minimum = ovrCommand_MinimumSize(command->Op);
+		const char* error = NULL;
+		if (minimum == 0)
+			error = "unknown command";
+		else if (command->Size < minimum || (command->Size & 3) || command->Size > size - offset)
+			error = "bad size";
+		else if (command->Op == COMMAND_SET_LAYER && args[0] != COMMAND_LAYER_WORLD)
+			error = "unknown layer";
+		else if (command->Op == COMMAND_SET_PROGRAM && args[0] >= (unsigned int)commands->ProgramCount)
+			error = "bad program handle";
+		else if (command->Op == COMMAND_SET_GEOMETRY && args[0] >= (unsigned int)commands->MeshCount)
+			error = "bad mesh handle";
+		else if (command->Op == COMMAND_SET_TEXTURE && (args[0] >= MAX_PROGRAM_TEXTURES || args[1] >= (unsigned int)commands->TextureCount))
+			error = "bad texture unit or handle";
+		else if (command->Op == COMMAND_SET_UNIFORM && (args[0] >= MAX_PROGRAM_UNIFORMS || !program))
+			error = "bad uniform, or no program set";
+		else if (command->Op == COMMAND_SET_UNIFORM && args[0] == UNIFORM_MODEL_MATRIX && command->Size < (int)sizeof(ovrCommand) + 4 + 16 * 4)
+			error = "matrix uniform too small";
+		else if (command->Op == COMMAND_DRAW && (!program || !geometry))
+			error = "draw without program or geometry";
+		if (error) {
+			ALOGE("ovrCommandBuffer: %s (op %d, size %d) at %d", error, command->Op, command->Size, offset);
+			return false;
+		}
+		program |= command->Op == COMMAND_SET_PROGRAM;
+		geometry |= command->Op == COMMAND_SET_GEOMETRY;
+		offset += command->Size;
+	}
+	return true;
+}
+
+// Moves the mesh bounds by the column-major model matrix (Arvo) and tests the result against the eye.
+static bool ovrCommandBuffer_DrawVisible(const ovrFrustum* frustum, const ovrMesh* mesh, const float* model) {
+	vec3_t mins, maxs;
+	for (int i = 0; i < 3; i++) {
+		mins[i] = maxs[i] = model[12 + i];
+		for (int j = 0; j < 3; j++) {
+			const float a = model[j * 4 + i] * mesh->Mins[j];
+			const float b = model[j * 4 + i] * mesh->Maxs[j];
+			mins[i] += a < b ? a : b;
+			maxs[i] += a < b ? b : a;
+		}
+	}
+	return ovrFrustum_BoxVisible(frustum, mins, maxs);
+}
+
+// The end of the run of draws that starts at offset, which share program, mesh and texture because no other
+// command comes between them.
+static int ovrCommandBuffer_DrawRunEnd(const ovrCommandBuffer* commands, int offset, int size, int* count) {
+	const int minimum = ovrCommand_MinimumSize(COMMAND_DRAW);
+	*count = 0;
+	while (size - offset >= minimum) {
+		const ovrCommand* command = (const ovrCommand*)(commands->Data + offset);
+		if (command->Op != COMMAND_DRAW || command->Size < minimum || command->Size > size - offset)
+			break;
+		offset += command->Size;
+		(*count)++;
+	}
+	return offset;
+}
+
+// Draws the run of draws between begin and end for one eye as instances. Returns the number of draws.
+static int ovrCommandBuffer_DrawBatch(ovrCommandBuffer* commands, const ovrProgram* program, const ovrMesh* mesh, GLuint texture,
+	int begin, int end, int eye, const ovrFrustum* frustum, int* culled) {
+	ovrDrawBatcher* batcher = &commands->Batcher;
+	ovrDrawBatcher_Reset(batcher);
+	for (int offset = begin; offset < end; ) {
+		const ovrCommand* command = (const ovrCommand*)(commands->Data + offset);
+		const float* values = (const float*)(command + 1);
+		offset += command->Size;
+		if (mesh->Bounded && !ovrCommandBuffer_DrawVisible(frustum, mesh, values)) {
+			(*culled)++;
+			continue;
+		}
+		// the command holds the columns, ovrMatrix4f the rows
+		ovrMatrix4f transform;
+		memcpy(transform.M, values, sizeof(transform.M));
+		transform = ovrMatrix4f_Transpose(&transform);
+		ovrDrawBatcher_Add(batcher, program, mesh, texture, &transform, 1);
+	}
+	const int draws = batcher->DrawCount;
+	ovrDrawBatcher_Upload(batcher);
+	ovrDrawBatcher_Draw(batcher, eye, commands->SceneMatrices, SceneMatricesStride);
+	return draws;
+}
+
+// Replays the stream for one eye. Returns the number of draws, culled counts the ones skipped and batched the ones
+// drawn as instances.
+static int ovrCommandBuffer_Replay(ovrCommandBuffer* commands, int size, int eye, const ovrFrustum* frustum, int* culled, int* batched) {
+	const ovrProgram* program = NULL;
+	const ovrMesh* mesh = NULL;
+	// every eye starts from the white texture on all units, not from whatever the previous eye left bound
+	for (int i = MAX_PROGRAM_TEXTURES - 1; i >= 0; i--) {
+		GL(glActiveTexture(GL_TEXTURE0 + i));
+		GL(glBindTexture(GL_TEXTURE_2D, commands->Textures[0]));
+	}
+	GLuint texture = commands->Textures[0];	// unit 0, the one batches draw with
+	GLenum unit = GL_TEXTURE0;
+	bool world = true;
+	int draws = 0;
+	for (int offset = 0; offset < size; ) {
+		if (size - offset < (int)sizeof(ovrCommand))
+			break;
+		const ovrCommand* command = (const ovrCommand*)(commands->Data + offset);
+		const unsigned int* args = (const unsigned int*)(command + 1);
+		const float* values = (const float*)(command + 1);
+		if (command->Size < sizeof(ovrCommand) || command->Size > size - offset)
+			break;
+		offset += command->Size;
+		// checked even without Validate, a command too small for its arguments would read past it
+		if (command->Size < ovrCommand_MinimumSize(command->Op))
+			continue;
+		if (command->Op == COMMAND_SET_LAYER) {
+			world = args[0] == COMMAND_LAYER_WORLD;
+			continue;
+		}
+		if (!world)
+			continue;
+		switch (command->Op) {
+			case COMMAND_CLEAR:
+				GL(glClearColor(values[1], values[2], values[3], values[4]));
+				GL(glClearDepthf(values[5]));
+				GL(glClear(args[0] & (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT)));
+				break;
+			case COMMAND_SET_PROGRAM:
+				if (args[0] >= (unsigned int)commands->ProgramCount)
+					break;
+				program = commands->Programs[args[0]];
+				GL(glUseProgram(program->Program));
+				if (program->UniformBinding[UNIFORM_SCENE_MATRICES] >= 0) {
+					GL(glBindBufferRange(GL_UNIFORM_BUFFER, program->UniformBinding[UNIFORM_SCENE_MATRICES], commands->SceneMatrices,
+						eye * SceneMatricesStride, sizeof(ovrSceneMatrices)));
+				}
+				if (program->UniformLocation[UNIFORM_VIEW_ID] >= 0) {
+					GL(glUniform1i(program->UniformLocation[UNIFORM_VIEW_ID], eye));
+				}
+				break;
+			case COMMAND_SET_GEOMETRY:
+				if (args[0] < (unsigned int)commands->MeshCount)
+					mesh = &commands->Meshes[args[0]];
+				break;
+			case COMMAND_SET_TEXTURE:
+				if (args[0] >= MAX_PROGRAM_TEXTURES || args[1] >= (unsigned int)commands->TextureCount)
+					break;
+				unit = GL_TEXTURE0 + args[0];
+				GL(glActiveTexture(unit));
+				GL(glBindTexture(GL_TEXTURE_2D, commands->Textures[args[1]]));
+				if (args[0] == 0)
+					texture = commands->Textures[args[1]];
+				break;
+			case COMMAND_SET_UNIFORM: {
+				if (!program || args[0] >= MAX_PROGRAM_UNIFORMS)
+					break;
+				const GLint location = program->UniformLocation[args[0]];
+				if (location < 0)
+					break;
+				if (args[0] == UNIFORM_MODEL_MATRIX) {
+					if (command->Size < (int)sizeof(ovrCommand) + 4 + 16 * 4)
+						break;
+					GL(glUniformMatrix4fv(location, 1, GL_FALSE, values + 1));
+				}
+				else if (args[0] == UNIFORM_VIEW_ID) {
+					GL(glUniform1i(location, (GLint)args[1]));
+				}
+				else {
+					GL(glUniform4fv(location, 1, values + 1));
+				}
+				break;
+			}
+			case COMMAND_DRAW: {
+				if (!program || !mesh)
+					break;
+				if (program->Instanced) {
+					const int begin = offset - command->Size;
+					int count;
+					const int end = ovrCommandBuffer_DrawRunEnd(commands, begin, size, &count);
+					if (count >= COMMAND_BATCH_MIN_DRAWS) {
+						const int batch = ovrCommandBuffer_DrawBatch(commands, program, mesh, texture, begin, end, eye, frustum, culled);
+						draws += batch;
+						*batched += batch;
+						offset = end;
+						// the batcher leaves unit 0 unbound
+						GL(glActiveTexture(GL_TEXTURE0));
+						GL(glBindTexture(GL_TEXTURE_2D, texture));
+						GL(glActiveTexture(unit));
+						break;
+					}
+				}
+				if (mesh->Bounded && !ovrCommandBuffer_DrawVisible(frustum, mesh, values)) {
+					(*culled)++;
+					break;
+				}
+				if (program->Instanced) {
+					// the columns of vertexTransform, read as constants while its arrays are disabled
+					for (int i = 0; i < 4; i++) {
+						GL(glVertexAttrib4fv(VERTEX_ATTRIBUTE_LOCATION_TRANSFORM + i, values + i * 4));
+					}
+				}
+				else if (program->UniformLocation[UNIFORM_MODEL_MATRIX] >= 0) {
+					GL(glUniformMatrix4fv(program->UniformLocation[UNIFORM_MODEL_MATRIX], 1, GL_FALSE, values));
+				}
+				ovrMesh_Draw(mesh);
+				draws++;
+				break;
+			}
+		}
+	}
+	return draws;
+}
+
+bool ovrCommandBuffer_Execute(ovrCommandBuffer* commands, int size, ovrRenderer* renderer, const ovrTracking2* tracking) {
+	if (size <= 0)
+		return false;
+	if (size > commands->Capacity) {
+		ALOGE("ovrCommandBuffer: %d bytes submitted into a %d byte buffer", size, commands->Capacity);
+		return false;
+	}
+	if (commands->Validate && !ovrCommandBuffer_Check(commands, size))
+		return false;
+	const double start = vrapi_GetTimeInSeconds();
+
+	GL(glBindBuffer(GL_UNIFORM_BUFFER, commands->SceneMatrices));
+	for (int eye = 0; eye < renderer->NumBuffers; eye++) {
+		ovrSceneMatrices matrices;
+		matrices.ViewMatrix = ovrMatrix4f_Transpose(&tracking->Eye[eye].ViewMatrix);
+		matrices.ProjectionMatrix = ovrMatrix4f_Transpose(&renderer->ProjectionMatrix);
+		GL(glBufferSubData(GL_UNIFORM_BUFFER, eye * SceneMatricesStride, sizeof(matrices), &matrices));
+	}
+	GL(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	ovrFrustum frustums[CULL_VIEWS];
+	ovrFrustum_FromTracking(frustums, tracking, &renderer->ProjectionMatrix);
+
+	renderState state;
+	getCurrentRenderState(&state);
+	int draws = 0;
+	int culled = 0;
+	int batched = 0;
+	for (int eye = 0; eye < renderer->NumBuffers; eye++) {
+		ovrFramebuffer* frameBuffer = &renderer->FrameBuffer[eye];
+		ovrFramebuffer_SetCurrent(frameBuffer);
+		GL(glViewport(0, 0, frameBuffer->Width, frameBuffer->Height));
+		GL(glScissor(0, 0, frameBuffer->Width, frameBuffer->Height));
+		GL(glEnable(GL_DEPTH_TEST));
+		GL(glDepthFunc(GL_LEQUAL));
+		GL(glEnable(GL_CULL_FACE));
+		GL(glCullFace(GL_BACK));
+		// a single buffer holds both views
+		const ovrFrustum* frustum = &frustums[renderer->NumBuffers == 1 ? CULL_STEREO : CULL_LEFT + eye];
+		draws += ovrCommandBuffer_Replay(commands, size, eye, frustum, &culled, &batched);
+		GL(glBindVertexArray(0));
+		GL(glUseProgram(0));
+		ovrFramebuffer_ClearEdgeTexels(frameBuffer);
+		ovrFramebuffer_Resolve(frameBuffer);
+		ovrFramebuffer_Advance(frameBuffer);
+	}
+	ovrFramebuffer_SetNone();
+	restoreRenderState(&state);
+
+	commands->Frames++;
+	commands->Draws += draws;
+	commands->Culled += culled;
+	commands->Batched += batched;
+	commands->ExecuteSeconds += vrapi_GetTimeInSeconds() - start;
+	return true;
+}
+
+void ovrCommandBuffer_Report(ovrCommandBuffer* commands) {
+	if (!commands->Frames)
+		return;
+	ALOGI("ovrCommandBuffer: %lld frames, %.1f draws (%.1f culled, %.1f batched) and %.3f ms per frame, %.3f ms per 1000 draws%s",
+		commands->Frames, (double)commands->Draws / commands->Frames, (double)commands->Culled / commands->Frames,
+		(double)commands->Batched / commands->Frames,
+		commands->ExecuteSeconds * 1000.0 / commands->Frames,
+		commands->Draws ? commands->ExecuteSeconds * 1000.0 * 1000.0 / commands->Draws : 0.0, commands->Validate ? " (validated)" : "");
+}
@@ -2,6 +2,8 @@
 #ifndef VRCOMPOSITOR_H
 #define VRCOMPOSITOR_H
 
+#include <pthread.h>
+
 #include "VrApi_Input.h"
 #include "VrClientInfo.h"
 
@@ -33,6 +35,27 @@ static void GLCheckErrors(int line) {
 #define GL(func) func;
 #endif // CHECK_GL_ERRORS
 
+/*
+================================================================================
+ovrEgl
+================================================================================
+*/
+
+typedef struct {
+	EGLint		MajorVersion;
+	EGLint		MinorVersion;
+	EGLDisplay	Display;
+	EGLConfig	Config;
+	EGLSurface	TinySurface;
+	EGLSurface	MainSurface;
+	EGLContext	Context;
+	bool		Shared;		// created against another context; must not terminate the display
+} ovrEgl;
+
+void ovrEgl_Clear(ovrEgl* egl);
+void ovrEgl_CreateContext(ovrEgl* egl, const ovrEgl* shareEgl);
+void ovrEgl_DestroyContext(ovrEgl* egl);
+
 /*
 ================================================================================
 ovrFramebuffer
@@ -107,7 +130,7 @@ typedef struct {
 	const GLvoid* Pointer;
 } ovrVertexAttribPointer;
 
-#define MAX_VERTEX_ATTRIB_POINTERS		3
+#define MAX_VERTEX_ATTRIB_POINTERS		7	// position, color, uv and a per-instance 4x4 transform
 
 typedef struct {
 	GLuint					VertexBuffer;
@@ -118,6 +141,93 @@ typedef struct {
 	ovrVertexAttribPointer	VertexAttribs[MAX_VERTEX_ATTRIB_POINTERS];
 } ovrGeometry;
 
+/*
+================================================================================
+ovrGeometryHeap
+================================================================================
+*/
+
+// Vertex layout shared by every mesh in a heap, so all of them can be drawn through one vertex array object.
+typedef struct {
+	float					Position[3];
+	unsigned char			Color[4];
+	float					Uv[2];
+} ovrVertex;
+
+typedef struct {
+	GLuint					Offset;
+	GLuint					Size;
+} ovrHeapBlock;
+
+// Free ranges sorted by offset; allocation is first-fit and frees coalesce with their neighbours.
+typedef struct {
+	ovrHeapBlock*			Blocks;
+	int						Count;
+	int						Capacity;
+	GLuint					Size;
+} ovrHeapFreeList;
+
+typedef struct {
+	ovrHeapBlock			Block;
+	bool					Index;
+	long long				Frame;
+} ovrHeapRetired;
+
+// A mesh is a range of vertices and a range of indices inside a heap. Indices are stored rebased, as
+// absolute GL_UNSIGNED_INT vertex numbers, so no base vertex is needed when drawing.
+typedef struct {
+	GLuint					VertexArrayObject;
+	GLuint					FirstVertex;
+	int						VertexCount;
+	GLuint					FirstIndex;
+	int						IndexCount;
+	// object space bounds, for culling draws; streamed meshes are written after the fact and have none
+	bool					Bounded;
+	float					Mins[3];
+	float					Maxs[3];
+} ovrMesh;
+
+#define GEOMETRY_HEAP_FRAMES	3
+
+typedef struct {
+	GLuint					VertexBuffer;
+	GLuint					IndexBuffer;
+	GLuint					VertexArrayObject;
+	ovrHeapFreeList			VertexFree;
+	ovrHeapFreeList			IndexFree;
+	// freed blocks are only reused once the frames that could still read them have completed
+	ovrHeapRetired*			Retired;
+	int						RetiredCount;
+	int						RetiredCapacity;
+	// per-frame ring for dynamic data, one region per frame in flight
+	GLuint					StreamVertexBuffer;
+	GLuint					StreamIndexBuffer;
+	GLuint					StreamVertexArrayObject;
+	int						StreamVertexCapacity;	// per region
+	int						StreamIndexCapacity;	// per region
+	int						StreamVertexHead;
+	int						StreamIndexHead;
+	int						StreamVertexFlushed;
+	int						StreamIndexFlushed;
+	bool					StreamPersistent;		// GL_EXT_buffer_storage, otherwise written through a CPU shadow
+	ovrVertex*				StreamVertices;			// region for the current frame
+	GLuint*					StreamIndices;
+	GLsync					StreamFences[GEOMETRY_HEAP_FRAMES];
+	long long				FrameSerial;
+	long long				CompletedFrame;
+} ovrGeometryHeap;
+
+bool ovrGeometryHeap_Create(ovrGeometryHeap* heap, int vertexCapacity, int indexCapacity, int streamVertexCapacity, int streamIndexCapacity);
+void ovrGeometryHeap_Destroy(ovrGeometryHeap* heap);
+bool ovrGeometryHeap_Upload(ovrGeometryHeap* heap, const ovrVertex* vertices, int vertexCount, const unsigned short* indices, int indexCount, ovrMesh* mesh);
+void ovrGeometryHeap_Free(ovrGeometryHeap* heap, ovrMesh* mesh);
+void ovrGeometryHeap_BeginFrame(ovrGeometryHeap* heap);
+// Indices written through ovrGeometryHeap_Stream must already be offset by mesh->FirstVertex.
+bool ovrGeometryHeap_Stream(ovrGeometryHeap* heap, int vertexCount, int indexCount, ovrVertex** vertices, GLuint** indices, ovrMesh* mesh);
+void ovrGeometryHeap_Flush(ovrGeometryHeap* heap);
+void ovrGeometryHeap_EndFrame(ovrGeometryHeap* heap);
+void ovrMesh_Draw(const ovrMesh* mesh);
+
 /*
 ================================================================================
 ovrProgram
@@ -127,6 +237,20 @@ ovrProgram
 #define MAX_PROGRAM_UNIFORMS	8
 #define MAX_PROGRAM_TEXTURES	8
 
+enum {
+	VERTEX_ATTRIBUTE_LOCATION_POSITION,
+	VERTEX_ATTRIBUTE_LOCATION_COLOR,
+	VERTEX_ATTRIBUTE_LOCATION_UV,
+	VERTEX_ATTRIBUTE_LOCATION_TRANSFORM		// mat4, uses four consecutive locations
+};
+
+enum {
+	UNIFORM_MODEL_MATRIX,
+	UNIFORM_VIEW_ID,
+	UNIFORM_SCENE_MATRICES,
+	UNIFORM_COLOR
+};
+
 typedef struct {
 	GLuint	Program;
 	GLuint	VertexShader;
@@ -135,8 +259,286 @@ typedef struct {
 	GLint	UniformLocation[MAX_PROGRAM_UNIFORMS];	// ProgramUniforms[].name
 	GLint	UniformBinding[MAX_PROGRAM_UNIFORMS];	// ProgramUniforms[].name
 	GLint	Textures[MAX_PROGRAM_TEXTURES];			// Texture%i
+	bool	Instanced;								// takes its model matrix from vertexTransform, not ModelMatrix
 } ovrProgram;
 
+// The SceneMatrices uniform block. Renderers keep one range per eye in a uniform buffer.
+typedef struct {
+	ovrMatrix4f				ViewMatrix;
+	ovrMatrix4f				ProjectionMatrix;
+} ovrSceneMatrices;
+
+/*
+================================================================================
+ovrProgramCache
+================================================================================
+*/
+
+typedef struct {
+	const char*				VertexSource;
+	const char*				FragmentSource;
+} ovrProgramSource;
+
+// Linked program binaries are kept on disk, keyed by a hash of the sources and validated against the driver that produced them.
+typedef struct {
+	char					Path[256];
+	unsigned long long		DriverHash;
+	bool					Enabled;				// false if the driver exposes no program binary formats
+	pthread_mutex_t			Mutex;
+	int						Hits;
+	int						Misses;
+	int						Rejected;				// binaries the driver refused to load
+	int						Precompiled;
+	double					CreateSeconds;			// time spent in ovrProgram_Create
+	const ovrEgl*			ShareEgl;
+	ovrProgramSource*		PendingSources;
+	int						PendingCount;
+	pthread_t				PrecompileThread;
+	bool					Precompiling;			// under Mutex, Report reads it from the render thread
+} ovrProgramCache;
+
+void ovrProgramCache_Create(ovrProgramCache* cache, const char* path);
+void ovrProgramCache_Destroy(ovrProgramCache* cache);
+void ovrProgramCache_Precompile(ovrProgramCache* cache, const ovrEgl* shareEgl, const ovrProgramSource* sources, int count);
+void ovrProgramCache_Report(ovrProgramCache* cache);
+
+bool ovrProgram_Create(ovrProgram* program, ovrProgramCache* cache, const char* vertexSource, const char* fragmentSource);
+void ovrProgram_Destroy(ovrProgram* program);
+
+/*
+================================================================================
+ovrDrawBatcher
+================================================================================
+*/
+
+typedef struct {
+	const ovrProgram*		Program;
+	GLuint					VertexArrayObject;
+	GLuint					Texture;
+	GLuint					FirstIndex;
+	int						IndexCount;
+	int						Instance;				// index into Transforms
+} ovrBatchDraw;
+
+// Matches DrawElementsIndirectCommand.
+typedef struct {
+	GLuint					Count;
+	GLuint					InstanceCount;
+	GLuint					FirstIndex;
+	GLint					BaseVertex;
+	GLuint					BaseInstance;
+} ovrBatchIndirect;
+
+typedef struct {
+	GLuint					VertexArrayObject;
+	const ovrProgram*		Program;
+	GLuint					Texture;
+	int						FirstCommand;
+	int						CommandCount;
+} ovrBatchRun;
+
+// Collects draws for a frame, groups them by program, geometry and texture, and issues one instanced draw per mesh,
+// or one multi-draw per program/geometry/texture run when the driver supports indirect draws with a base instance.
+typedef struct {
+	ovrBatchDraw*			Draws;
+	ovrMatrix4f*			Transforms;
+	int						DrawCount;
+	int						Capacity;
+	ovrBatchIndirect*		Commands;
+	int						CommandCount;
+	ovrBatchRun*			Runs;
+	int						RunCount;
+	GLuint					InstanceBuffer;
+	GLuint					IndirectBuffer;
+	bool					MultiDrawIndirect;		// GL_EXT_multi_draw_indirect + GL_EXT_base_instance
+	int						DrawCalls;				// issued by the last ovrDrawBatcher_Draw
+} ovrDrawBatcher;
+
+extern const ovrProgramSource ovrDrawBatcher_DefaultProgram;
+
+void ovrDrawBatcher_Create(ovrDrawBatcher* batcher, int capacity);
+void ovrDrawBatcher_Destroy(ovrDrawBatcher* batcher);
+bool ovrDrawBatcher_Add(ovrDrawBatcher* batcher, const ovrProgram* program, const ovrMesh* mesh, GLuint texture, const ovrMatrix4f* transforms, int count);
+void ovrDrawBatcher_Upload(ovrDrawBatcher* batcher);
+// Draws for one eye, with the eye's range of a uniform buffer of ovrSceneMatrices. Can be called once per eye after
+// a single upload.
+void ovrDrawBatcher_Draw(ovrDrawBatcher* batcher, int eye, GLuint sceneMatrices, int sceneMatricesStride);
+void ovrDrawBatcher_Reset(ovrDrawBatcher* batcher);
+
+/*
+================================================================================
+ovrTextureUploader
+================================================================================
+*/
+
+#define MAX_TEXTURE_LEVELS		16
+
+typedef struct {
+	int						Width;
+	int						Height;
+	const void*				Data;
+	int						Size;
+} ovrTextureLevel;
+
+// A decoded image. Uncompressed levels are uploaded with Format/Type, compressed levels with InternalFormat alone.
+// GL_FLOAT levels of a GL_*16F texture are converted to half floats on the upload thread.
+typedef struct ovrTextureImage {
+	GLenum					InternalFormat;			// sized format for glTexStorage2D
+	GLenum					Format;					// 0 for compressed formats
+	GLenum					Type;
+	int						LevelCount;
+	ovrTextureLevel			Levels[MAX_TEXTURE_LEVELS];
+	void*					UserData;
+	// called on the upload thread once the level data is no longer needed, or by ovrTextureUploader_Destroy on the
+	// thread destroying the uploader for an image that was still queued
+	void					(*Release)(struct ovrTextureImage* image);
+	// called on the render thread once the texture can be sampled; texture is 0 if the upload failed
+	void					(*Ready)(void* userData, GLuint texture);
+} ovrTextureImage;
+
+typedef struct {
+	ovrTextureImage			Image;
+	GLuint					Texture;
+	GLsync					Fence;
+} ovrTextureUpload;
+
+#define TEXTURE_UPLOAD_QUEUE	64
+#define TEXTURE_UPLOAD_PBOS		4
+
+// Uploads on its own thread and shared context. Level data is staged through a ring of pixel buffers, and
+// a finished texture is only handed to the render thread once the fence inserted after its upload has signaled.
+typedef struct {
+	const ovrEgl*			ShareEgl;
+	pthread_t				Thread;
+	pthread_mutex_t			Mutex;
+	pthread_cond_t			Cond;
+	bool					Exit;
+	ovrTextureUpload		Pending[TEXTURE_UPLOAD_QUEUE];
+	int						PendingHead;
+	int						PendingCount;
+	ovrTextureUpload		Completed[TEXTURE_UPLOAD_QUEUE];
+	int						CompletedCount;
+	GLuint					PixelBuffers[TEXTURE_UPLOAD_PBOS];	// owned by the upload thread
+	GLsync					PixelBufferFences[TEXTURE_UPLOAD_PBOS];
+	int						PixelBufferSize;
+	int						PixelBufferIndex;
+	// statistics
+	int						Uploaded;
+	long long				UploadedBytes;
+	double					UploadSeconds;
+} ovrTextureUploader;
+
+bool ovrTextureUploader_Create(ovrTextureUploader* uploader, const ovrEgl* shareEgl, int pixelBufferSize);
+void ovrTextureUploader_Destroy(ovrTextureUploader* uploader);
+// Queues an image; returns false when the queue is full. The image is copied, the level data it points to is not.
+bool ovrTextureUploader_Submit(ovrTextureUploader* uploader, const ovrTextureImage* image);
+// Hands at most maxCount finished textures to their Ready callbacks. Render thread only.
+int ovrTextureUploader_Poll(ovrTextureUploader* uploader, int maxCount);
+void ovrTextureUploader_Report(ovrTextureUploader* uploader);
+
+/*
+================================================================================
+ovrKtxTexture
+================================================================================
+*/
+
+// A KTX2 file mapped into memory. Levels point straight into the mapping, level 0 being the largest.
+typedef struct {
+	void*					Mapping;
+	size_t					MappingSize;
+	GLenum					InternalFormat;			// ETC2/EAC or ASTC
+	int						Width;
+	int						Height;
+	int						LevelCount;
+	ovrTextureLevel			Levels[MAX_TEXTURE_LEVELS];
+} ovrKtxFile;
+
+// A texture whose coarse levels are resident first; finer levels are streamed in later by lowering the base level.
+typedef struct {
+	GLuint					Texture;
+	int						BaseLevel;				// finest level uploaded so far
+} ovrKtxTexture;
+
+bool ovrKtxFile_Open(ovrKtxFile* file, const char* path);
+void ovrKtxFile_Close(ovrKtxFile* file);
+// Uploads the residentLevels coarsest levels, all of them when residentLevels is 0.
+bool ovrKtxTexture_Create(ovrKtxTexture* texture, const ovrKtxFile* file, int residentLevels);
+// Uploads finer levels until byteBudget is spent, always at least one. Returns true once there is nothing left to upload.
+bool ovrKtxTexture_Stream(ovrKtxTexture* texture, const ovrKtxFile* file, int byteBudget);
+void ovrKtxTexture_Destroy(ovrKtxTexture* texture);
+
+/*
+================================================================================
+ovrCommandBuffer
+================================================================================
+*/
+
+// Commands written by managed code (CommandBuffer.cs). Every command starts with an ovrCommand header
+// and is a multiple of four bytes; Size includes the header.
+enum {
+	COMMAND_SET_LAYER = 1,		// unsigned int Layer
+	COMMAND_CLEAR,				// unsigned int Mask (GL_*_BUFFER_BIT), float Color[4], float Depth
+	COMMAND_SET_PROGRAM,		// unsigned int Program handle
+	COMMAND_SET_GEOMETRY,		// unsigned int Mesh handle
+	COMMAND_SET_TEXTURE,		// unsigned int Unit, unsigned int Texture handle
+	COMMAND_SET_UNIFORM,		// unsigned int Uniform (UNIFORM_*), float Values[4 or 16]
+	COMMAND_DRAW				// float ModelMatrix[16], column-major; consecutive draws of an instanced program are batched
+};
+
+enum {
+	COMMAND_LAYER_WORLD			// the eye buffers of the projection layer
+};
+
+typedef struct {
+	unsigned short			Op;
+	unsigned short			Size;
+} ovrCommand;
+
+#define MAX_COMMAND_PROGRAMS	16
+#define MAX_COMMAND_MESHES		256
+#define MAX_COMMAND_TEXTURES	256
+
+// The command memory is plain native memory, so managed code writes it through a pointer without pinning.
+// The host replays it once per eye after the managed frame returns. Without Validate a command with a bad
+// size or handle is skipped as it is replayed, rather than the whole stream refused up front. A draw of a mesh
+// with bounds is skipped for an eye that cannot see them, so a program that moves vertices outside their mesh's
+// bounds has to draw streamed meshes.
+typedef struct {
+	unsigned char*			Data;
+	int						Capacity;
+	bool					Validate;				// check sizes and handles before executing anything
+	// resources managed code refers to by handle
+	const ovrProgram*		Programs[MAX_COMMAND_PROGRAMS];
+	int						ProgramCount;
+	ovrMesh					Meshes[MAX_COMMAND_MESHES];
+	int						MeshCount;
+	GLuint					Textures[MAX_COMMAND_TEXTURES];
+	int						TextureCount;
+	ovrProgram				DefaultProgram;			// handle 0
+	GLuint					WhiteTexture;			// handle 0
+	GLuint					SceneMatrices;			// uniform buffer, view and projection per eye
+	ovrDrawBatcher			Batcher;				// runs of consecutive draws, replayed instanced
+	// statistics
+	long long				Frames;
+	long long				Draws;
+	long long				Batched;				// draws issued through Batcher
+	long long				Culled;					// draws of bounded meshes outside the eye's frustum
+	double					ExecuteSeconds;
+} ovrCommandBuffer;
+
+extern const ovrProgramSource ovrCommandBuffer_DefaultProgram;
+
+bool ovrCommandBuffer_Create(ovrCommandBuffer* commands, ovrProgramCache* cache, int capacity, bool validate);
+void ovrCommandBuffer_Destroy(ovrCommandBuffer* commands);
+int ovrCommandBuffer_AddProgram(ovrCommandBuffer* commands, const ovrProgram* program);
+int ovrCommandBuffer_AddMesh(ovrCommandBuffer* commands, const ovrMesh* mesh);
+int ovrCommandBuffer_AddTexture(ovrCommandBuffer* commands, GLuint texture);
+// Points a handle at another texture, such as one that was still being uploaded when the handle was handed out.
+void ovrCommandBuffer_ReplaceTexture(ovrCommandBuffer* commands, int handle, GLuint texture);
+// Replays the first size bytes into the renderer's eye buffers. Returns true if anything was drawn to the world layer.
+bool ovrCommandBuffer_Execute(ovrCommandBuffer* commands, int size, ovrRenderer* renderer, const ovrTracking2* tracking);
+void ovrCommandBuffer_Report(ovrCommandBuffer* commands);
+
 /*
 ================================================================================
 ovrScene
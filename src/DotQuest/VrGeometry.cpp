@@ -0,0 +1,371 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <GLES2/gl2ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+#include <stddef.h>
+
+#ifndef GL_MAP_PERSISTENT_BIT_EXT
+#define GL_MAP_PERSISTENT_BIT_EXT	0x0040
+#define GL_MAP_COHERENT_BIT_EXT		0x0080
+#endif
+typedef void (GL_APIENTRYP PFNGLBUFFERSTORAGEEXT)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+/*
+================================================================================
+ovrHeapFreeList
+================================================================================
+*/
+
+static void ovrHeapFreeList_Create(ovrHeapFreeList* list, GLuint size) {
+	list->Capacity = 16;
+	list->Blocks = (ovrHeapBlock*)malloc(list->Capacity * sizeof(ovrHeapBlock));
+	list->Blocks[0].Offset = 0;
+	list->Blocks[0].Size = size;
+	list->Count = 1;
+	list->Size = size;
+}
+
+static void ovrHeapFreeList_Destroy(ovrHeapFreeList* list) {
+	free(list->Blocks);
+	list->Blocks = NULL;
+	list->Count = 0;
+	list->Capacity = 0;
+}
+
+static bool ovrHeapFreeList_Alloc(ovrHeapFreeList* list, GLuint size, GLuint* offset) {
+	for (int i = 0; i < list->Count; i++) {
+		ovrHeapBlock* block = &list->Blocks[i];
+		if (block->Size < size)
+			continue;
+		*offset = block->Offset;
+		block->Offset += size;
+		block->Size -= size;
+		if (block->Size == 0) {
+			memmove(&list->Blocks[i], &list->Blocks[i + 1], (list->Count - i - 1) * sizeof(ovrHeapBlock));
+			list->Count--;
+		}
+		return true;
+	}
+	return false;
+}
+
+static void ovrHeapFreeList_Free(ovrHeapFreeList* list, ovrHeapBlock block) {
+	int i = 0;
+	while (i < list->Count && list->Blocks[i].Offset < block.Offset)
+		i++;
+	const bool joinPrev = i > 0 && list->Blocks[i - 1].Offset + list->Blocks[i - 1].Size == block.Offset;
+	const bool joinNext = i < list->Count && block.Offset + block.Size == list->Blocks[i].Offset;
+	if (joinPrev && joinNext) {
+		list->Blocks[i - 1].Size += block.Size + list->Blocks[i].Size;
+		memmove(&list->Blocks[i], &list->Blocks[i + 1], (list->Count - i - 1) * sizeof(ovrHeapBlock));
+		list->Count--;
+	}
+	else if (joinPrev)
+		list->Blocks[i - 1].Size += block.Size;
+	else if (joinNext) {
+		list->Blocks[i].Offset = block.Offset;
+		list->Blocks[i].Size += block.Size;
+	}
+	else {
+		if (list->Count == list->Capacity) {
+			list->Capacity *= 2;
+			list->Blocks = (ovrHeapBlock*)realloc(list->Blocks, list->Capacity * sizeof(ovrHeapBlock));
+		}
+		memmove(&list->Blocks[i + 1], &list->Blocks[i], (list->Count - i) * sizeof(ovrHeapBlock));
+		list->Blocks[i] = block;
+		list->Count++;
+	}
+}
+
+/*
+================================================================================
+ovrGeometryHeap
+================================================================================
+*/
+
+static const ovrVertexAttribPointer HeapVertexAttribs[] = {
+	{ VERTEX_ATTRIBUTE_LOCATION_POSITION,	3, GL_FLOAT,			GL_FALSE,	sizeof(ovrVertex), (const GLvoid*)offsetof(ovrVertex, Position) },
+	{ VERTEX_ATTRIBUTE_LOCATION_COLOR,		4, GL_UNSIGNED_BYTE,	GL_TRUE,	sizeof(ovrVertex), (const GLvoid*)offsetof(ovrVertex, Color) },
+	{ VERTEX_ATTRIBUTE_LOCATION_UV,			2, GL_FLOAT,			GL_FALSE,	sizeof(ovrVertex), (const GLvoid*)offsetof(ovrVertex, Uv) },
+};
+
+static GLuint ovrGeometryHeap_CreateVertexArray(GLuint vertexBuffer, GLuint indexBuffer) {
+	GLuint vertexArrayObject;
+	GL(glGenVertexArrays(1, &vertexArrayObject));
+	GL(glBindVertexArray(vertexArrayObject));
+	GL(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+	for (size_t i = 0; i < sizeof(HeapVertexAttribs) / sizeof(HeapVertexAttribs[0]); i++) {
+		const ovrVertexAttribPointer* attrib = &HeapVertexAttribs[i];
+		GL(glEnableVertexAttribArray(attrib->Index));
+		GL(glVertexAttribPointer(attrib->Index, attrib->Size, attrib->Type, attrib->Normalized, attrib->Stride, attrib->Pointer));
+	}
+	GL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+	GL(glBindVertexArray(0));
+	GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	return vertexArrayObject;
+}
+
+// The copy-write target is used for all writes so the element array binding of whatever vertex array is bound stays intact.
+static void* ovrGeometryHeap_MapRange(GLuint buffer, GLintptr offset, GLsizeiptr length) {
+	GL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+	// The range is known not to be in use by the GPU, either freshly allocated, retired past its fence, or this frame's stream region.
+	GL(void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, length, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	if (!data)
+		ALOGE("ovrGeometryHeap: glMapBufferRange failed");
+	return data;
+}
+
+static void ovrGeometryHeap_Unmap() {
+	GL(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+	GL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+static GLuint ovrGeometryHeap_CreateBuffer(GLsizeiptr size, GLenum usage) {
+	GLuint buffer;
+	GL(glGenBuffers(1, &buffer));
+	GL(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+	GL(glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, usage));
+	GL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	return buffer;
+}
+
+static void* ovrGeometryHeap_CreatePersistentBuffer(PFNGLBUFFERSTORAGEEXT glBufferStorageEXT, GLsizeiptr size, GLuint* buffer) {
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+	GL(glGenBuffers(1, buffer));
+	GL(glBindBuffer(GL_COPY_WRITE_BUFFER, *buffer));
+	GL(glBufferStorageEXT(GL_COPY_WRITE_BUFFER, size, NULL, flags));
+	GL(void* data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+	GL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+	return data;
+}
+
+bool ovrGeometryHeap_Create(ovrGeometryHeap* heap, int vertexCapacity, int indexCapacity, int streamVertexCapacity, int streamIndexCapacity) {
+	memset(heap, 0, sizeof(ovrGeometryHeap));
+	ovrHeapFreeList_Create(&heap->VertexFree, vertexCapacity);
+	ovrHeapFreeList_Create(&heap->IndexFree, indexCapacity);
+	heap->RetiredCapacity = 64;
+	heap->Retired = (ovrHeapRetired*)malloc(heap->RetiredCapacity * sizeof(ovrHeapRetired));
+
+	heap->VertexBuffer = ovrGeometryHeap_CreateBuffer(vertexCapacity * sizeof(ovrVertex), GL_STATIC_DRAW);
+	heap->IndexBuffer = ovrGeometryHeap_CreateBuffer(indexCapacity * sizeof(GLuint), GL_STATIC_DRAW);
+	heap->VertexArrayObject = ovrGeometryHeap_CreateVertexArray(heap->VertexBuffer, heap->IndexBuffer);
+
+	heap->StreamVertexCapacity = streamVertexCapacity;
+	heap->StreamIndexCapacity = streamIndexCapacity;
+	const GLsizeiptr streamVertexSize = GEOMETRY_HEAP_FRAMES * streamVertexCapacity * sizeof(ovrVertex);
+	const GLsizeiptr streamIndexSize = GEOMETRY_HEAP_FRAMES * streamIndexCapacity * sizeof(GLuint);
+	const char* allExtensions = (const char*)glGetString(GL_EXTENSIONS);
+	PFNGLBUFFERSTORAGEEXT glBufferStorageEXT = allExtensions && strstr(allExtensions, "GL_EXT_buffer_storage")
+		? (PFNGLBUFFERSTORAGEEXT)eglGetProcAddress("glBufferStorageEXT") : NULL;
+	if (glBufferStorageEXT) {
+		heap->StreamPersistent = true;
+		heap->StreamVertices = (ovrVertex*)ovrGeometryHeap_CreatePersistentBuffer(glBufferStorageEXT, streamVertexSize, &heap->StreamVertexBuffer);
+		heap->StreamIndices = (GLuint*)ovrGeometryHeap_CreatePersistentBuffer(glBufferStorageEXT, streamIndexSize, &heap->StreamIndexBuffer);
+		heap->StreamPersistent = heap->StreamVertices && heap->StreamIndices;
+		if (!heap->StreamPersistent) {
+			GL(glDeleteBuffers(1, &heap->StreamVertexBuffer));
+			GL(glDeleteBuffers(1, &heap->StreamIndexBuffer));
+		}
+	}
+	if (!heap->StreamPersistent) {
+		heap->StreamVertexBuffer = ovrGeometryHeap_CreateBuffer(streamVertexSize, GL_DYNAMIC_DRAW);
+		heap->StreamIndexBuffer = ovrGeometryHeap_CreateBuffer(streamIndexSize, GL_DYNAMIC_DRAW);
+		heap->StreamVertices = (ovrVertex*)malloc(streamVertexCapacity * sizeof(ovrVertex));
+		heap->StreamIndices = (GLuint*)malloc(streamIndexCapacity * sizeof(GLuint));
+	}
+	heap->StreamVertexArrayObject = ovrGeometryHeap_CreateVertexArray(heap->StreamVertexBuffer, heap->StreamIndexBuffer);
+	ALOGV("ovrGeometryHeap: %d vertices, %d indices, %d/%d streamed per frame%s", vertexCapacity, indexCapacity,
+		streamVertexCapacity, streamIndexCapacity, heap->StreamPersistent ? " (persistent)" : "");
+	return heap->VertexBuffer && heap->IndexBuffer && heap->StreamVertexBuffer && heap->StreamIndexBuffer;
+}
+
+void ovrGeometryHeap_Destroy(ovrGeometryHeap* heap) {
+	for (int i = 0; i < GEOMETRY_HEAP_FRAMES; i++)
+		if (heap->StreamFences[i]) {
+			GL(glDeleteSync(heap->StreamFences[i]));
+		}
+	if (!heap->StreamPersistent) {
+		free(heap->StreamVertices);
+		free(heap->StreamIndices);
+	}
+	GL(glDeleteVertexArrays(1, &heap->VertexArrayObject));
+	GL(glDeleteVertexArrays(1, &heap->StreamVertexArrayObject));
+	// deleting a persistently mapped buffer implicitly unmaps it
+	GL(glDeleteBuffers(1, &heap->VertexBuffer));
+	GL(glDeleteBuffers(1, &heap->IndexBuffer));
+	GL(glDeleteBuffers(1, &heap->StreamVertexBuffer));
+	GL(glDeleteBuffers(1, &heap->StreamIndexBuffer));
+	ovrHeapFreeList_Destroy(&heap->VertexFree);
+	ovrHeapFreeList_Destroy(&heap->IndexFree);
+	free(heap->Retired);
+	memset(heap, 0, sizeof(ovrGeometryHeap));
+}
+
+bool ovrGeometryHeap_Upload(ovrGeometryHeap* heap, const ovrVertex* vertices, int vertexCount, const unsigned short* indices, int indexCount, ovrMesh* mesh) {
+	GLuint firstVertex, firstIndex;
+	if (!ovrHeapFreeList_Alloc(&heap->VertexFree, vertexCount, &firstVertex)) {
+		ALOGE("ovrGeometryHeap: out of vertex space for %d vertices", vertexCount);
+		return false;
+	}
+	if (!ovrHeapFreeList_Alloc(&heap->IndexFree, indexCount, &firstIndex)) {
+		ALOGE("ovrGeometryHeap: out of index space for %d indices", indexCount);
+		ovrHeapBlock block = { firstVertex, (GLuint)vertexCount };
+		ovrHeapFreeList_Free(&heap->VertexFree, block);
+		return false;
+	}
+
+	ovrVertex* vertexData = (ovrVertex*)ovrGeometryHeap_MapRange(heap->VertexBuffer, firstVertex * sizeof(ovrVertex), vertexCount * sizeof(ovrVertex));
+	if (vertexData)
+		memcpy(vertexData, vertices, vertexCount * sizeof(ovrVertex));
+	ovrGeometryHeap_Unmap();
+	GLuint* indexData = (GLuint*)ovrGeometryHeap_MapRange(heap->IndexBuffer, firstIndex * sizeof(GLuint), indexCount * sizeof(GLuint));
+	if (indexData)
+		for (int i = 0; i < indexCount; i++)
+			indexData[i] = firstVertex + indices[i];
+	ovrGeometryHeap_Unmap();
+
+	mesh->VertexArrayObject = heap->VertexArrayObject;
+	mesh->FirstVertex = firstVertex;
+	mesh->VertexCount = vertexCount;
+	mesh->FirstIndex = firstIndex;
+	mesh->IndexCount = indexCount;
+	mesh->Bounded = vertexCount > 0;
+	for (int j = 0; j < 3; j++) {
+		mesh->Mins[j] = vertexCount > 0 ? vertices[0].Position[j] : 0.0f;
+		mesh->Maxs[j] = mesh->Mins[j];
+	}
+	for (int i = 1; i < vertexCount; i++)
+		for (int j = 0; j < 3; j++) {
+			const float value = vertices[i].Position[j];
+			if (value < mesh->Mins[j])
+				mesh->Mins[j] = value;
+			if (value > mesh->Maxs[j])
+				mesh->Maxs[j] = value;
+		}
+	return vertexData && indexData;
+}
+
+static void ovrGeometryHeap_Retire(ovrGeometryHeap* heap, GLuint offset, int size, bool index) {
+	if (heap->RetiredCount == heap->RetiredCapacity) {
+		heap->RetiredCapacity *= 2;
+		heap->Retired = (ovrHeapRetired*)realloc(heap->Retired, heap->RetiredCapacity * sizeof(ovrHeapRetired));
+	}
+	ovrHeapRetired* retired = &heap->Retired[heap->RetiredCount++];
+	retired->Block.Offset = offset;
+	retired->Block.Size = size;
+	retired->Index = index;
+	retired->Frame = heap->FrameSerial;
+}
+
+void ovrGeometryHeap_Free(ovrGeometryHeap* heap, ovrMesh* mesh) {
+	if (mesh->VertexArrayObject != heap->VertexArrayObject)
+		return; // streamed meshes are recycled with their frame
+	ovrGeometryHeap_Retire(heap, mesh->FirstVertex, mesh->VertexCount, false);
+	ovrGeometryHeap_Retire(heap, mesh->FirstIndex, mesh->IndexCount, true);
+	memset(mesh, 0, sizeof(ovrMesh));
+}
+
+void ovrGeometryHeap_BeginFrame(ovrGeometryHeap* heap) {
+	heap->FrameSerial++;
+	const int region = heap->FrameSerial % GEOMETRY_HEAP_FRAMES;
+
+	// Wait for the frame that last used this region, which also completes everything retired up to it.
+	GLsync fence = heap->StreamFences[region];
+	if (fence) {
+		// a timeout only means the GPU is behind, and the region must not be written before it is done with it
+		GLenum status;
+		while ((status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 50)) == GL_TIMEOUT_EXPIRED)
+			ALOGE("ovrGeometryHeap: frame %lld is still on the GPU after 50 ms", heap->FrameSerial - GEOMETRY_HEAP_FRAMES);
+		if (status == GL_WAIT_FAILED) {
+			// the fence says nothing, so the GPU is drained to make the region safe; the frame is not counted as
+			// completed and its fence stays until EndFrame replaces it with one that covers it
+			ALOGE("ovrGeometryHeap: glClientWaitSync failed with 0x%x", glGetError());
+			GL(glFinish());
+		}
+		else {
+			GL(glDeleteSync(fence));
+			heap->StreamFences[region] = 0;
+			heap->CompletedFrame = heap->FrameSerial - GEOMETRY_HEAP_FRAMES;
+		}
+	}
+	int kept = 0;
+	for (int i = 0; i < heap->RetiredCount; i++) {
+		const ovrHeapRetired* retired = &heap->Retired[i];
+		if (retired->Frame <= heap->CompletedFrame)
+			ovrHeapFreeList_Free(retired->Index ? &heap->IndexFree : &heap->VertexFree, retired->Block);
+		else
+			heap->Retired[kept++] = *retired;
+	}
+	heap->RetiredCount = kept;
+
+	heap->StreamVertexHead = heap->StreamVertexFlushed = 0;
+	heap->StreamIndexHead = heap->StreamIndexFlushed = 0;
+}
+
+bool ovrGeometryHeap_Stream(ovrGeometryHeap* heap, int vertexCount, int indexCount, ovrVertex** vertices, GLuint** indices, ovrMesh* mesh) {
+	if (heap->StreamVertexHead + vertexCount > heap->StreamVertexCapacity || heap->StreamIndexHead + indexCount > heap->StreamIndexCapacity) {
+		ALOGE("ovrGeometryHeap: stream overflow (%d vertices, %d indices)", vertexCount, indexCount);
+		return false;
+	}
+	const int region = heap->FrameSerial % GEOMETRY_HEAP_FRAMES;
+	const int vertexBase = heap->StreamPersistent ? region * heap->StreamVertexCapacity : 0;
+	const int indexBase = heap->StreamPersistent ? region * heap->StreamIndexCapacity : 0;
+	*vertices = &heap->StreamVertices[vertexBase + heap->StreamVertexHead];
+	*indices = &heap->StreamIndices[indexBase + heap->StreamIndexHead];
+	mesh->VertexArrayObject = heap->StreamVertexArrayObject;
+	mesh->FirstVertex = region * heap->StreamVertexCapacity + heap->StreamVertexHead;
+	mesh->VertexCount = vertexCount;
+	mesh->FirstIndex = region * heap->StreamIndexCapacity + heap->StreamIndexHead;
+	mesh->IndexCount = indexCount;
+	mesh->Bounded = false;
+	heap->StreamVertexHead += vertexCount;
+	heap->StreamIndexHead += indexCount;
+	return true;
+}
+
+// Makes everything streamed so far visible to draws. Nothing to do with a coherent persistent mapping,
+// otherwise the new part of the CPU shadow is copied into this frame's region.
+void ovrGeometryHeap_Flush(ovrGeometryHeap* heap) {
+	if (heap->StreamPersistent)
+		return;
+	const int region = heap->FrameSerial % GEOMETRY_HEAP_FRAMES;
+	const int vertexCount = heap->StreamVertexHead - heap->StreamVertexFlushed;
+	if (vertexCount > 0) {
+		const GLintptr offset = (region * heap->StreamVertexCapacity + heap->StreamVertexFlushed) * sizeof(ovrVertex);
+		void* data = ovrGeometryHeap_MapRange(heap->StreamVertexBuffer, offset, vertexCount * sizeof(ovrVertex));
+		if (data)
+			memcpy(data, &heap->StreamVertices[heap->StreamVertexFlushed], vertexCount * sizeof(ovrVertex));
+		ovrGeometryHeap_Unmap();
+		heap->StreamVertexFlushed = heap->StreamVertexHead;
+	}
+	const int indexCount = heap->StreamIndexHead - heap->StreamIndexFlushed;
+	if (indexCount > 0) {
+		const GLintptr offset = (region * heap->StreamIndexCapacity + heap->StreamIndexFlushed) * sizeof(GLuint);
+		void* data = ovrGeometryHeap_MapRange(heap->StreamIndexBuffer, offset, indexCount * sizeof(GLuint));
+		if (data)
+			memcpy(data, &heap->StreamIndices[heap->StreamIndexFlushed], indexCount * sizeof(GLuint));
+		ovrGeometryHeap_Unmap();
+		heap->StreamIndexFlushed = heap->StreamIndexHead;
+	}
+}
+
+void ovrGeometryHeap_EndFrame(ovrGeometryHeap* heap) {
+	ovrGeometryHeap_Flush(heap);
+	const int region = heap->FrameSerial % GEOMETRY_HEAP_FRAMES;
+	// left by a failed wait, the new fence signals after it anyway
+	if (heap->StreamFences[region]) {
+		GL(glDeleteSync(heap->StreamFences[region]));
+	}
+	GL(heap->StreamFences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void ovrMesh_Draw(const ovrMesh* mesh) {
+	GL(glBindVertexArray(mesh->VertexArrayObject));
+	GL(glDrawElements(GL_TRIANGLES, mesh->IndexCount, GL_UNSIGNED_INT, (const GLvoid*)(mesh->FirstIndex * sizeof(GLuint))));
+}
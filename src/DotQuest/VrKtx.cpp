@@ -0,0 +1,238 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+================================================================================
+ovrKtxTexture
+================================================================================
+*/
+
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR				0x93B0
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR		0x93D0
+#endif
+
+static const unsigned char KtxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+typedef struct {
+	unsigned char			Identifier[12];
+	unsigned int			VkFormat;
+	unsigned int			TypeSize;
+	unsigned int			PixelWidth;
+	unsigned int			PixelHeight;
+	unsigned int			PixelDepth;
+	unsigned int			LayerCount;
+	unsigned int			FaceCount;
+	unsigned int			LevelCount;
+	unsigned int			SupercompressionScheme;
+	unsigned int			DfdByteOffset;
+	unsigned int			DfdByteLength;
+	unsigned int			KvdByteOffset;
+	unsigned int			KvdByteLength;
+	unsigned long long		SgdByteOffset;
+	unsigned long long		SgdByteLength;
+} ovrKtxHeader;
+
+typedef struct {
+	unsigned long long		ByteOffset;
+	unsigned long long		ByteLength;
+	unsigned long long		UncompressedByteLength;
+} ovrKtxLevelIndex;
+
+typedef struct {
+	GLenum					InternalFormat;
+	int						BlockWidth;
+	int						BlockHeight;
+	int						BlockBytes;
+} ovrKtxFormat;
+
+static const int AstcBlockSizes[][2] = {
+	{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+	{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+};
+
+// Maps the Vulkan format stored in the file to its GLES equivalent; only block compressed formats are accepted.
+static bool ovrKtxFormat_FromVkFormat(unsigned int vkFormat, ovrKtxFormat* format) {
+	format->BlockWidth = 4;
+	format->BlockHeight = 4;
+	switch (vkFormat) {
+		case 147: format->InternalFormat = GL_COMPRESSED_RGB8_ETC2; format->BlockBytes = 8; return true;
+		case 148: format->InternalFormat = GL_COMPRESSED_SRGB8_ETC2; format->BlockBytes = 8; return true;
+		case 149: format->InternalFormat = GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2; format->BlockBytes = 8; return true;
+		case 150: format->InternalFormat = GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2; format->BlockBytes = 8; return true;
+		case 151: format->InternalFormat = GL_COMPRESSED_RGBA8_ETC2_EAC; format->BlockBytes = 16; return true;
+		case 152: format->InternalFormat = GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC; format->BlockBytes = 16; return true;
+		case 153: format->InternalFormat = GL_COMPRESSED_R11_EAC; format->BlockBytes = 8; return true;
+		case 154: format->InternalFormat = GL_COMPRESSED_SIGNED_R11_EAC; format->BlockBytes = 8; return true;
+		case 155: format->InternalFormat = GL_COMPRESSED_RG11_EAC; format->BlockBytes = 16; return true;
+		case 156: format->InternalFormat = GL_COMPRESSED_SIGNED_RG11_EAC; format->BlockBytes = 16; return true;
+	}
+	// VK_FORMAT_ASTC_4x4_UNORM_BLOCK through VK_FORMAT_ASTC_12x12_SRGB_BLOCK, alternating unorm and srgb
+	if (vkFormat >= 157 && vkFormat <= 184) {
+		const int index = (vkFormat - 157) / 2;
+		const bool srgb = ((vkFormat - 157) & 1) != 0;
+		format->InternalFormat = (srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR : GL_COMPRESSED_RGBA_ASTC_4x4_KHR) + index;
+		format->BlockWidth = AstcBlockSizes[index][0];
+		format->BlockHeight = AstcBlockSizes[index][1];
+		format->BlockBytes = 16;
+		return true;
+	}
+	return false;
+}
+
+bool ovrKtxFile_Open(ovrKtxFile* file, const char* path) {
+	memset(file, 0, sizeof(ovrKtxFile));
+	const int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		ALOGE("ovrKtxFile: unable to open %s", path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ovrKtxHeader)) {
+		ALOGE("ovrKtxFile: %s is too small", path);
+		close(fd);
+		return false;
+	}
+	// the mapping outlives the descriptor; pages are only faulted in as levels are uploaded
+	void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		ALOGE("ovrKtxFile: unable to map %s", path);
+		return false;
+	}
+	file->Mapping = mapping;
+	file->MappingSize = st.st_size;
+
+	const ovrKtxHeader* header = (const ovrKtxHeader*)mapping;
+	ovrKtxFormat format;
+	const char* error = NULL;
+	if (memcmp(header->Identifier, KtxIdentifier, sizeof(KtxIdentifier)))
+		error = "not a KTX2 file";
+	else if (header->SupercompressionScheme != 0)
+		error = "supercompressed files are not supported";
+	else if (header->PixelDepth > 1 || header->LayerCount > 1 || header->FaceCount != 1)
+		error = "only 2D textures are supported";
+	else if (!ovrKtxFormat_FromVkFormat(header->VkFormat, &format))
+		error = "unsupported format";
+	else if (header->PixelWidth == 0 || header->PixelHeight == 0)
+		error = "invalid size";
+	else if (header->LevelCount > MAX_TEXTURE_LEVELS)
+		error = "too many levels";
+	if (error) {
+		ALOGE("ovrKtxFile: %s: %s", path, error);
+		ovrKtxFile_Close(file);
+		return false;
+	}
+
+	file->InternalFormat = format.InternalFormat;
+	file->Width = header->PixelWidth;
+	file->Height = header->PixelHeight;
+	// a level count of zero asks the loader to generate mips, which compressed formats cannot do
+	file->LevelCount = header->LevelCount > 0 ? header->LevelCount : 1;
+	if (sizeof(ovrKtxHeader) + file->LevelCount * sizeof(ovrKtxLevelIndex) > file->MappingSize) {
+		ALOGE("ovrKtxFile: %s: truncated level index", path);
+		ovrKtxFile_Close(file);
+		return false;
+	}
+	const ovrKtxLevelIndex* index = (const ovrKtxLevelIndex*)((const unsigned char*)mapping + sizeof(ovrKtxHeader));
+	for (int i = 0; i < file->LevelCount; i++) {
+		const int width = file->Width >> i > 0 ? file->Width >> i : 1;
+		const int height = file->Height >> i > 0 ? file->Height >> i : 1;
+		const unsigned long long expected = (unsigned long long)((width + format.BlockWidth - 1) / format.BlockWidth)
+			* ((height + format.BlockHeight - 1) / format.BlockHeight) * format.BlockBytes;
+		// offset and length come from the file, their sum could wrap
+		if (index[i].ByteOffset > file->MappingSize || index[i].ByteLength > file->MappingSize - index[i].ByteOffset ||
+			index[i].ByteLength != expected) {
+			ALOGE("ovrKtxFile: %s: level %d is %llu bytes at %llu, expected %llu", path, i, index[i].ByteLength, index[i].ByteOffset, expected);
+			ovrKtxFile_Close(file);
+			return false;
+		}
+		file->Levels[i].Width = width;
+		file->Levels[i].Height = height;
+		file->Levels[i].Data = (const unsigned char*)mapping + index[i].ByteOffset;
+		file->Levels[i].Size = (int)index[i].ByteLength;
+	}
+	ALOGV("ovrKtxFile: %s %dx%d, %d levels, format 0x%x", path, file->Width, file->Height, file->LevelCount, file->InternalFormat);
+	return true;
+}
+
+void ovrKtxFile_Close(ovrKtxFile* file) {
+	if (file->Mapping)
+		munmap(file->Mapping, file->MappingSize);
+	memset(file, 0, sizeof(ovrKtxFile));
+}
+
+static bool ovrKtxTexture_UploadLevel(ovrKtxTexture* texture, const ovrKtxFile* file, int level) {
+	const ovrTextureLevel* l = &file->Levels[level];
+	// page the level in ahead of the driver reading it, and let it go again once the driver has its copy
+	const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+	void* start = (void*)((uintptr_t)l->Data & ~(page - 1));
+	const size_t length = (const unsigned char*)l->Data + l->Size - (const unsigned char*)start;
+	madvise(start, length, MADV_WILLNEED);
+	while (glGetError() != GL_NO_ERROR) {}
+	glCompressedTexImage2D(GL_TEXTURE_2D, level, file->InternalFormat, l->Width, l->Height, 0, l->Size, l->Data);
+	const GLenum error = glGetError();
+	madvise(start, length, MADV_DONTNEED);
+	if (error != GL_NO_ERROR) {
+		ALOGE("ovrKtxTexture: level %d (%dx%d, format 0x%x) failed with 0x%x", level, l->Width, l->Height, file->InternalFormat, error);
+		return false;
+	}
+	ALOGV("ovrKtxTexture: uploaded level %d, %dx%d, %d bytes", level, l->Width, l->Height, l->Size);
+	texture->BaseLevel = level;
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level));
+	return true;
+}
+
+bool ovrKtxTexture_Create(ovrKtxTexture* texture, const ovrKtxFile* file, int residentLevels) {
+	texture->BaseLevel = file->LevelCount;
+	if (residentLevels <= 0 || residentLevels > file->LevelCount)
+		residentLevels = file->LevelCount;
+
+	GL(glGenTextures(1, &texture->Texture));
+	GL(glBindTexture(GL_TEXTURE_2D, texture->Texture));
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, file->LevelCount - 1));
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, file->LevelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	// coarsest first, so the texture is complete after the first level and only gets sharper from there
+	bool result = true;
+	for (int level = file->LevelCount - 1; level >= file->LevelCount - residentLevels && result; level--)
+		result = ovrKtxTexture_UploadLevel(texture, file, level);
+	GL(glBindTexture(GL_TEXTURE_2D, 0));
+	if (!result)
+		ovrKtxTexture_Destroy(texture);
+	return result;
+}
+
+bool ovrKtxTexture_Stream(ovrKtxTexture* texture, const ovrKtxFile* file, int byteBudget) {
+	if (!texture->Texture || texture->BaseLevel == 0)
+		return true;
+	GL(glBindTexture(GL_TEXTURE_2D, texture->Texture));
+	// a level the driver refuses ends streaming; the texture stays usable at the levels it already has
+	bool failed = false;
+	do {
+		const int level = texture->BaseLevel - 1;
+		byteBudget -= file->Levels[level].Size;
+		failed = !ovrKtxTexture_UploadLevel(texture, file, level);
+	} while (!failed && texture->BaseLevel > 0 && byteBudget >= file->Levels[texture->BaseLevel - 1].Size);
+	GL(glBindTexture(GL_TEXTURE_2D, 0));
+	return failed || texture->BaseLevel == 0;
+}
+
+void ovrKtxTexture_Destroy(ovrKtxTexture* texture) {
+	if (texture->Texture) {
+		GL(glDeleteTextures(1, &texture->Texture));
+	}
+	texture->Texture = 0;
+	texture->BaseLevel = 0;
+}
@@ -0,0 +1,469 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/prctl.h>
+
+/*
+================================================================================
+ovrProgram
+================================================================================
+*/
+
+typedef struct {
+	int				Location;
+	const char*		Name;
+} ovrVertexAttribute;
+
+static ovrVertexAttribute ProgramVertexAttributes[] = {
+	{ VERTEX_ATTRIBUTE_LOCATION_POSITION,	"vertexPosition" },
+	{ VERTEX_ATTRIBUTE_LOCATION_COLOR,		"vertexColor" },
+	{ VERTEX_ATTRIBUTE_LOCATION_UV,			"vertexUv" },
+	{ VERTEX_ATTRIBUTE_LOCATION_TRANSFORM,	"vertexTransform" },
+};
+
+typedef enum {
+	UNIFORM_TYPE_VECTOR4,
+	UNIFORM_TYPE_MATRIX4X4,
+	UNIFORM_TYPE_INT,
+	UNIFORM_TYPE_BUFFER,
+} ovrUniformType;
+
+typedef struct {
+	int				Index;
+	ovrUniformType	Type;
+	const char*		Name;
+} ovrUniform;
+
+static ovrUniform ProgramUniforms[] = {
+	{ UNIFORM_MODEL_MATRIX,		UNIFORM_TYPE_MATRIX4X4,	"ModelMatrix" },
+	{ UNIFORM_VIEW_ID,			UNIFORM_TYPE_INT,		"ViewID" },
+	{ UNIFORM_SCENE_MATRICES,	UNIFORM_TYPE_BUFFER,	"SceneMatrices" },
+	{ UNIFORM_COLOR,			UNIFORM_TYPE_VECTOR4,	"Color" },
+};
+
+static void ovrProgram_Clear(ovrProgram* program) {
+	program->Program = 0;
+	program->VertexShader = 0;
+	program->FragmentShader = 0;
+	memset(program->UniformLocation, -1, sizeof(program->UniformLocation));
+	memset(program->UniformBinding, -1, sizeof(program->UniformBinding));
+	memset(program->Textures, -1, sizeof(program->Textures));
+}
+
+static bool ovrProgram_CompileShader(GLuint shader, const char* source) {
+	GLint r;
+	GL(glShaderSource(shader, 1, &source, 0));
+	GL(glCompileShader(shader));
+	GL(glGetShaderiv(shader, GL_COMPILE_STATUS, &r));
+	if (r == GL_FALSE) {
+		GLchar msg[4096];
+		GL(glGetShaderInfoLog(shader, sizeof(msg), 0, msg));
+		ALOGE("%s\n%s\n", source, msg);
+		return false;
+	}
+	return true;
+}
+
+// Compiles and links from source. The binary retrievable hint is set so the result can be written to the cache.
+static bool ovrProgram_Link(ovrProgram* program, const char* vertexSource, const char* fragmentSource) {
+	GLint r;
+	GL(program->VertexShader = glCreateShader(GL_VERTEX_SHADER));
+	if (!ovrProgram_CompileShader(program->VertexShader, vertexSource))
+		return false;
+	GL(program->FragmentShader = glCreateShader(GL_FRAGMENT_SHADER));
+	if (!ovrProgram_CompileShader(program->FragmentShader, fragmentSource))
+		return false;
+
+	GL(program->Program = glCreateProgram());
+	GL(glAttachShader(program->Program, program->VertexShader));
+	GL(glAttachShader(program->Program, program->FragmentShader));
+
+	// Bind the vertex attribute locations.
+	for (size_t i = 0; i < sizeof(ProgramVertexAttributes) / sizeof(ProgramVertexAttributes[0]); i++) {
+		GL(glBindAttribLocation(program->Program, ProgramVertexAttributes[i].Location, ProgramVertexAttributes[i].Name));
+	}
+
+	GL(glProgramParameteri(program->Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	GL(glLinkProgram(program->Program));
+	GL(glGetProgramiv(program->Program, GL_LINK_STATUS, &r));
+	if (r == GL_FALSE) {
+		GLchar msg[4096];
+		GL(glGetProgramInfoLog(program->Program, sizeof(msg), 0, msg));
+		ALOGE("Linking program failed: %s\n", msg);
+		return false;
+	}
+	return true;
+}
+
+// Fills in the uniform locations, buffer bindings and texture units. Needed for both linked and cached programs,
+// because a program loaded through glProgramBinary comes back with its default uniform state.
+static void ovrProgram_Reflect(ovrProgram* program) {
+	int numBufferBindings = 0;
+	for (size_t i = 0; i < sizeof(ProgramUniforms) / sizeof(ProgramUniforms[0]); i++) {
+		const int uniformIndex = ProgramUniforms[i].Index;
+		if (ProgramUniforms[i].Type == UNIFORM_TYPE_BUFFER) {
+			GL(program->UniformLocation[uniformIndex] = glGetUniformBlockIndex(program->Program, ProgramUniforms[i].Name));
+			if (program->UniformLocation[uniformIndex] == (GLint)GL_INVALID_INDEX) {
+				program->UniformLocation[uniformIndex] = -1;
+				continue;
+			}
+			program->UniformBinding[uniformIndex] = numBufferBindings++;
+			GL(glUniformBlockBinding(program->Program, program->UniformLocation[uniformIndex], program->UniformBinding[uniformIndex]));
+		}
+		else {
+			GL(program->UniformLocation[uniformIndex] = glGetUniformLocation(program->Program, ProgramUniforms[i].Name));
+			program->UniformBinding[uniformIndex] = program->UniformLocation[uniformIndex];
+		}
+	}
+
+	GL(program->Instanced = glGetAttribLocation(program->Program, "vertexTransform") >= 0);
+
+	GL(glUseProgram(program->Program));
+	// Get the texture locations.
+	for (int i = 0; i < MAX_PROGRAM_TEXTURES; i++) {
+		char name[32];
+		sprintf(name, "Texture%i", i);
+		program->Textures[i] = glGetUniformLocation(program->Program, name);
+		if (program->Textures[i] != -1) {
+			GL(glUniform1i(program->Textures[i], i));
+		}
+	}
+	GL(glUseProgram(0));
+}
+
+void ovrProgram_Destroy(ovrProgram* program) {
+	if (program->Program != 0) {
+		GL(glDeleteProgram(program->Program));
+	}
+	if (program->VertexShader != 0) {
+		GL(glDeleteShader(program->VertexShader));
+	}
+	if (program->FragmentShader != 0) {
+		GL(glDeleteShader(program->FragmentShader));
+	}
+	ovrProgram_Clear(program);
+}
+
+/*
+================================================================================
+ovrProgramCache
+================================================================================
+*/
+
+#define PROGRAM_BINARY_MAGIC	0x42505144	// 'DQPB'
+#define PROGRAM_BINARY_VERSION	1
+
+// A cache file is this header followed by the vertex source, the fragment source and the program binary.
+// The sources are kept so stale entries can be rebuilt in the background after a driver update.
+typedef struct {
+	unsigned int		Magic;
+	unsigned int		Version;
+	unsigned long long	SourceHash;
+	unsigned long long	DriverHash;
+	unsigned int		VertexLength;
+	unsigned int		FragmentLength;
+	unsigned int		BinaryFormat;
+	unsigned int		BinaryLength;
+} ovrProgramBinaryHeader;
+
+// 64-bit FNV-1a
+static unsigned long long HashString(unsigned long long hash, const char* s) {
+	if (!s)
+		return hash;
+	for (; *s; s++) {
+		hash ^= (unsigned char)*s;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static unsigned long long HashSources(const char* vertexSource, const char* fragmentSource) {
+	unsigned long long hash = HashString(0xcbf29ce484222325ULL, vertexSource);
+	hash ^= 0xff; hash *= 0x100000001b3ULL; // keep "ab"+"c" distinct from "a"+"bc"
+	return HashString(hash, fragmentSource);
+}
+
+static void ovrProgramCache_EntryPath(const ovrProgramCache* cache, unsigned long long sourceHash, char* path, size_t size) {
+	snprintf(path, size, "%s/%016llx.bin", cache->Path, sourceHash);
+}
+
+// Returns a malloc'd buffer holding the whole entry, or NULL if the file is missing or malformed.
+static unsigned char* ovrProgramCache_ReadEntry(const char* path, ovrProgramBinaryHeader** header) {
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return NULL;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (size < (long)sizeof(ovrProgramBinaryHeader)) {
+		fclose(f);
+		return NULL;
+	}
+	unsigned char* data = (unsigned char*)malloc(size);
+	size_t read = fread(data, 1, size, f);
+	fclose(f);
+	ovrProgramBinaryHeader* h = (ovrProgramBinaryHeader*)data;
+	if (read != (size_t)size || h->Magic != PROGRAM_BINARY_MAGIC || h->Version != PROGRAM_BINARY_VERSION
+		|| sizeof(ovrProgramBinaryHeader) + (size_t)h->VertexLength + h->FragmentLength + h->BinaryLength != (size_t)size) {
+		free(data);
+		return NULL;
+	}
+	*header = h;
+	return data;
+}
+
+// Writes to a temporary file first so a crash or a concurrent writer never leaves a truncated entry behind.
+static void ovrProgramCache_WriteEntry(ovrProgramCache* cache, const ovrProgram* program, unsigned long long sourceHash, const char* vertexSource, const char* fragmentSource) {
+	if (!cache->Enabled)
+		return;
+	GLint length = 0;
+	GL(glGetProgramiv(program->Program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+		return;
+	ovrProgramBinaryHeader header;
+	header.Magic = PROGRAM_BINARY_MAGIC;
+	header.Version = PROGRAM_BINARY_VERSION;
+	header.SourceHash = sourceHash;
+	header.DriverHash = cache->DriverHash;
+	header.VertexLength = (unsigned int)strlen(vertexSource);
+	header.FragmentLength = (unsigned int)strlen(fragmentSource);
+	void* binary = malloc(length);
+	GLenum format = 0;
+	GL(glGetProgramBinary(program->Program, length, &length, &format, binary));
+	header.BinaryFormat = format;
+	header.BinaryLength = length;
+
+	char path[320], tempPath[340];
+	ovrProgramCache_EntryPath(cache, sourceHash, path, sizeof(path));
+	snprintf(tempPath, sizeof(tempPath), "%s.%d", path, gettid());
+	FILE* f = fopen(tempPath, "wb");
+	if (!f) {
+		ALOGE("ovrProgramCache: unable to write %s", tempPath);
+		free(binary);
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(vertexSource, 1, header.VertexLength, f) == header.VertexLength
+		&& fwrite(fragmentSource, 1, header.FragmentLength, f) == header.FragmentLength
+		&& fwrite(binary, 1, length, f) == (size_t)length;
+	ok = fclose(f) == 0 && ok;
+	free(binary);
+	if (!ok || rename(tempPath, path) != 0) {
+		ALOGE("ovrProgramCache: unable to write %s", path);
+		unlink(tempPath);
+	}
+}
+
+// Tries to create the program from a cached binary. A rejected binary is deleted so it is rebuilt on the next miss.
+static bool ovrProgramCache_Load(ovrProgramCache* cache, ovrProgram* program, unsigned long long sourceHash) {
+	char path[320];
+	ovrProgramCache_EntryPath(cache, sourceHash, path, sizeof(path));
+	ovrProgramBinaryHeader* header;
+	unsigned char* data = ovrProgramCache_ReadEntry(path, &header);
+	if (!data)
+		return false;
+	if (header->SourceHash != sourceHash || header->DriverHash != cache->DriverHash) {
+		free(data);
+		return false;
+	}
+	const unsigned char* binary = data + sizeof(ovrProgramBinaryHeader) + header->VertexLength + header->FragmentLength;
+	GLint r;
+	GL(program->Program = glCreateProgram());
+	GL(glProgramBinary(program->Program, header->BinaryFormat, binary, header->BinaryLength));
+	GL(glGetProgramiv(program->Program, GL_LINK_STATUS, &r));
+	free(data);
+	if (r == GL_FALSE) {
+		ALOGW("ovrProgramCache: driver rejected %s", path);
+		GL(glDeleteProgram(program->Program));
+		program->Program = 0;
+		unlink(path);
+		pthread_mutex_lock(&cache->Mutex);
+		cache->Rejected++;
+		pthread_mutex_unlock(&cache->Mutex);
+		return false;
+	}
+	return true;
+}
+
+bool ovrProgram_Create(ovrProgram* program, ovrProgramCache* cache, const char* vertexSource, const char* fragmentSource) {
+	const double start = vrapi_GetTimeInSeconds();
+	ovrProgram_Clear(program);
+	const unsigned long long sourceHash = HashSources(vertexSource, fragmentSource);
+	const bool hit = cache && cache->Enabled && ovrProgramCache_Load(cache, program, sourceHash);
+	if (!hit) {
+		if (!ovrProgram_Link(program, vertexSource, fragmentSource)) {
+			ovrProgram_Destroy(program);
+			return false;
+		}
+		if (cache)
+			ovrProgramCache_WriteEntry(cache, program, sourceHash, vertexSource, fragmentSource);
+	}
+	ovrProgram_Reflect(program);
+	if (cache) {
+		pthread_mutex_lock(&cache->Mutex);
+		if (hit) cache->Hits++;
+		else cache->Misses++;
+		cache->CreateSeconds += vrapi_GetTimeInSeconds() - start;
+		pthread_mutex_unlock(&cache->Mutex);
+	}
+	return true;
+}
+
+void ovrProgramCache_Create(ovrProgramCache* cache, const char* path) {
+	memset(cache, 0, sizeof(ovrProgramCache));
+	strncpy(cache->Path, path, sizeof(cache->Path) - 1);
+	pthread_mutex_init(&cache->Mutex, NULL);
+	mkdir(cache->Path, 0755);
+
+	// Binaries are only valid for the driver build that produced them.
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	hash = HashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = HashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = HashString(hash, (const char*)glGetString(GL_VERSION));
+	cache->DriverHash = hash;
+
+	GLint numFormats = 0;
+	GL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats));
+	cache->Enabled = numFormats > 0;
+	ALOGV("ovrProgramCache: %s, driver %016llx, %d binary formats", cache->Path, cache->DriverHash, numFormats);
+}
+
+static void ovrProgramCache_Build(ovrProgramCache* cache, const char* vertexSource, const char* fragmentSource) {
+	ovrProgram program;
+	ovrProgram_Clear(&program);
+	const unsigned long long sourceHash = HashSources(vertexSource, fragmentSource);
+	if (ovrProgram_Link(&program, vertexSource, fragmentSource)) {
+		ovrProgramCache_WriteEntry(cache, &program, sourceHash, vertexSource, fragmentSource);
+		pthread_mutex_lock(&cache->Mutex);
+		cache->Precompiled++;
+		pthread_mutex_unlock(&cache->Mutex);
+	}
+	ovrProgram_Destroy(&program);
+}
+
+static bool ovrProgramCache_IsCurrent(ovrProgramCache* cache, const char* vertexSource, const char* fragmentSource) {
+	char path[320];
+	ovrProgramCache_EntryPath(cache, HashSources(vertexSource, fragmentSource), path, sizeof(path));
+	ovrProgramBinaryHeader* header;
+	unsigned char* data = ovrProgramCache_ReadEntry(path, &header);
+	if (!data)
+		return false;
+	const bool current = header->DriverHash == cache->DriverHash;
+	free(data);
+	return current;
+}
+
+static void ovrProgramCache_SetPrecompiling(ovrProgramCache* cache, bool precompiling) {
+	pthread_mutex_lock(&cache->Mutex);
+	cache->Precompiling = precompiling;
+	pthread_mutex_unlock(&cache->Mutex);
+}
+
+static void* ovrProgramCache_PrecompileThread(void* parm) {
+	ovrProgramCache* cache = (ovrProgramCache*)parm;
+	prctl(PR_SET_NAME, (long)"DQ::Programs", 0, 0, 0);
+	const double start = vrapi_GetTimeInSeconds();
+
+	// Program objects are never handed across: this context only warms the on-disk cache, so the render
+	// thread can pick up the results with glProgramBinary without any cross-context synchronization.
+	ovrEgl egl;
+	ovrEgl_Clear(&egl);
+	ovrEgl_CreateContext(&egl, cache->ShareEgl);
+	if (!egl.Context) {
+		ALOGE("ovrProgramCache: unable to create a shared context for precompilation");
+		ovrProgramCache_SetPrecompiling(cache, false);
+		return NULL;
+	}
+
+	// Rebuild entries left behind by a previous driver from their stored sources.
+	DIR* dir = opendir(cache->Path);
+	if (dir) {
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			const size_t length = strlen(entry->d_name);
+			if (length < 4 || strcmp(entry->d_name + length - 4, ".bin"))
+				continue;
+			char path[320];
+			snprintf(path, sizeof(path), "%s/%s", cache->Path, entry->d_name);
+			ovrProgramBinaryHeader* header;
+			unsigned char* data = ovrProgramCache_ReadEntry(path, &header);
+			if (!data)
+				continue;
+			if (header->DriverHash != cache->DriverHash) {
+				char* vertexSource = strndup((const char*)data + sizeof(ovrProgramBinaryHeader), header->VertexLength);
+				char* fragmentSource = strndup((const char*)data + sizeof(ovrProgramBinaryHeader) + header->VertexLength, header->FragmentLength);
+				ovrProgramCache_Build(cache, vertexSource, fragmentSource);
+				free(vertexSource);
+				free(fragmentSource);
+			}
+			free(data);
+		}
+		closedir(dir);
+	}
+
+	for (int i = 0; i < cache->PendingCount; i++) {
+		const ovrProgramSource* source = &cache->PendingSources[i];
+		if (!ovrProgramCache_IsCurrent(cache, source->VertexSource, source->FragmentSource))
+			ovrProgramCache_Build(cache, source->VertexSource, source->FragmentSource);
+	}
+
+	ovrEgl_DestroyContext(&egl);
+	ALOGV("ovrProgramCache: precompiled %d programs in %.1f ms", cache->Precompiled, (vrapi_GetTimeInSeconds() - start) * 1000.0);
+	ovrProgramCache_SetPrecompiling(cache, false);
+	return NULL;
+}
+
+static void ovrProgramCache_FreePending(ovrProgramCache* cache) {
+	for (int i = 0; i < cache->PendingCount; i++) {
+		free((void*)cache->PendingSources[i].VertexSource);
+		free((void*)cache->PendingSources[i].FragmentSource);
+	}
+	free(cache->PendingSources);
+	cache->PendingSources = NULL;
+	cache->PendingCount = 0;
+}
+
+void ovrProgramCache_Precompile(ovrProgramCache* cache, const ovrEgl* shareEgl, const ovrProgramSource* sources, int count) {
+	if (!cache->Enabled || cache->PrecompileThread)
+		return;
+	cache->ShareEgl = shareEgl;
+	cache->PendingSources = (ovrProgramSource*)malloc((count > 0 ? count : 1) * sizeof(ovrProgramSource));
+	cache->PendingCount = count;
+	for (int i = 0; i < count; i++) {
+		cache->PendingSources[i].VertexSource = strdup(sources[i].VertexSource);
+		cache->PendingSources[i].FragmentSource = strdup(sources[i].FragmentSource);
+	}
+	ovrProgramCache_SetPrecompiling(cache, true);
+	const int createError = pthread_create(&cache->PrecompileThread, NULL, ovrProgramCache_PrecompileThread, cache);
+	if (createError) {
+		ALOGE("pthread_create returned %i", createError);
+		cache->PrecompileThread = 0;
+		ovrProgramCache_SetPrecompiling(cache, false);
+		ovrProgramCache_FreePending(cache);
+	}
+}
+
+void ovrProgramCache_Report(ovrProgramCache* cache) {
+	pthread_mutex_lock(&cache->Mutex);
+	ALOGI("ovrProgramCache: %d hits, %d misses, %d rejected, %d precompiled%s, %.1f ms creating programs",
+		cache->Hits, cache->Misses, cache->Rejected, cache->Precompiled, cache->Precompiling ? " (running)" : "",
+		cache->CreateSeconds * 1000.0);
+	pthread_mutex_unlock(&cache->Mutex);
+}
+
+void ovrProgramCache_Destroy(ovrProgramCache* cache) {
+	if (cache->PrecompileThread) {
+		pthread_join(cache->PrecompileThread, NULL);
+		cache->PrecompileThread = 0;
+	}
+	ovrProgramCache_FreePending(cache);
+	pthread_mutex_destroy(&cache->Mutex);
+}
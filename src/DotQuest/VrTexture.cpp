@@ -0,0 +1,286 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+
+#include <VrApi.h>
+#include <VrApi_Helpers.h>
+
+#include "VrCompositor.h"
+#include "lib/Math.h"
+#include <sys/prctl.h>
+
+/*
+================================================================================
+ovrTextureUploader
+================================================================================
+*/
+
+static void ovrTextureUploader_ReleaseImage(ovrTextureImage* image) {
+	if (image->Release)
+		image->Release(image);
+	for (int i = 0; i < image->LevelCount; i++)
+		image->Levels[i].Data = NULL;
+}
+
+// Returns the next pixel buffer in the ring once the GPU has finished reading what was last staged in it.
+static GLuint ovrTextureUploader_NextPixelBuffer(ovrTextureUploader* uploader, int* slot) {
+	*slot = uploader->PixelBufferIndex;
+	uploader->PixelBufferIndex = (uploader->PixelBufferIndex + 1) % TEXTURE_UPLOAD_PBOS;
+	GLsync fence = uploader->PixelBufferFences[*slot];
+	if (fence) {
+		GL(const GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull));
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+			ALOGE("ovrTextureUploader: pixel buffer %d is still in use", *slot);
+		GL(glDeleteSync(fence));
+		uploader->PixelBufferFences[*slot] = 0;
+	}
+	return uploader->PixelBuffers[*slot];
+}
+
+static bool ovrTextureImage_IsHalfFloat(GLenum internalFormat) {
+	return internalFormat == GL_R16F || internalFormat == GL_RG16F || internalFormat == GL_RGB16F || internalFormat == GL_RGBA16F;
+}
+
+static void ovrTextureUploader_Upload(ovrTextureUploader* uploader, ovrTextureUpload* upload) {
+	const ovrTextureImage* image = &upload->Image;
+	const ovrTextureLevel* base = &image->Levels[0];
+	// float levels of a 16F texture are packed to half floats on the way in, rather than handing the driver
+	// twice the bytes to convert itself
+	const bool packHalf = image->Format && image->Type == GL_FLOAT && ovrTextureImage_IsHalfFloat(image->InternalFormat);
+	unsigned short* packed = NULL;
+
+	GL(glGenTextures(1, &upload->Texture));
+	GL(glBindTexture(GL_TEXTURE_2D, upload->Texture));
+	while (glGetError() != GL_NO_ERROR) {}
+	glTexStorage2D(GL_TEXTURE_2D, image->LevelCount, image->InternalFormat, base->Width, base->Height);
+	const GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		ALOGE("ovrTextureUploader: glTexStorage2D(0x%x, %dx%d) failed with 0x%x", image->InternalFormat, base->Width, base->Height, error);
+		GL(glBindTexture(GL_TEXTURE_2D, 0));
+		GL(glDeleteTextures(1, &upload->Texture));
+		upload->Texture = 0;
+		return;
+	}
+
+	for (int i = 0; i < image->LevelCount; i++) {
+		const ovrTextureLevel* level = &image->Levels[i];
+		const void* source = level->Data;
+		const int size = packHalf ? level->Size / 2 : level->Size;
+		int slot = -1;
+		// levels too large for the ring are uploaded straight from client memory
+		if (size <= uploader->PixelBufferSize) {
+			GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ovrTextureUploader_NextPixelBuffer(uploader, &slot)));
+			GL(void* data = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+			if (data) {
+				if (packHalf)
+					Math::FloatToHalfBatch((const float*)level->Data, (unsigned short*)data, level->Size / sizeof(float));
+				else
+					memcpy(data, level->Data, level->Size);
+				GL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+				source = NULL;
+			}
+			else {
+				GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+				slot = -1;
+			}
+		}
+		if (packHalf && source) {
+			packed = (unsigned short*)realloc(packed, size);
+			Math::FloatToHalfBatch((const float*)level->Data, packed, level->Size / sizeof(float));
+			source = packed;
+		}
+		if (image->Format) {
+			GL(glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level->Width, level->Height, image->Format, packHalf ? GL_HALF_FLOAT : image->Type, source));
+		}
+		else {
+			GL(glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level->Width, level->Height, image->InternalFormat, level->Size, source));
+		}
+		if (slot >= 0) {
+			GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+			GL(uploader->PixelBufferFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+		}
+	}
+	free(packed);
+
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image->LevelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GL(glBindTexture(GL_TEXTURE_2D, 0));
+
+	// the flush makes sure the fence reaches the GPU, otherwise the render thread could wait on it forever
+	GL(upload->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	GL(glFlush());
+}
+
+static void* ovrTextureUploader_Thread(void* parm) {
+	ovrTextureUploader* uploader = (ovrTextureUploader*)parm;
+	prctl(PR_SET_NAME, (long)"DQ::Uploads", 0, 0, 0);
+
+	ovrEgl egl;
+	ovrEgl_Clear(&egl);
+	ovrEgl_CreateContext(&egl, uploader->ShareEgl);
+	if (!egl.Context)
+		ALOGE("ovrTextureUploader: unable to create a shared context, uploads will fail");
+	else {
+		GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+		GL(glGenBuffers(TEXTURE_UPLOAD_PBOS, uploader->PixelBuffers));
+		for (int i = 0; i < TEXTURE_UPLOAD_PBOS; i++) {
+			GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploader->PixelBuffers[i]));
+			GL(glBufferData(GL_PIXEL_UNPACK_BUFFER, uploader->PixelBufferSize, NULL, GL_STREAM_DRAW));
+		}
+		GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+	}
+
+	pthread_mutex_lock(&uploader->Mutex);
+	for (;;) {
+		// completed uploads are held back until the render thread polls them, so a full list stalls the queue
+		while (!uploader->Exit && (uploader->PendingCount == 0 || uploader->CompletedCount == TEXTURE_UPLOAD_QUEUE))
+			pthread_cond_wait(&uploader->Cond, &uploader->Mutex);
+		if (uploader->Exit)
+			break;
+		ovrTextureUpload upload = uploader->Pending[uploader->PendingHead];
+		uploader->PendingHead = (uploader->PendingHead + 1) % TEXTURE_UPLOAD_QUEUE;
+		uploader->PendingCount--;
+		pthread_mutex_unlock(&uploader->Mutex);
+
+		const double start = vrapi_GetTimeInSeconds();
+		long long bytes = 0;
+		for (int i = 0; i < upload.Image.LevelCount; i++)
+			bytes += upload.Image.Levels[i].Size;
+		if (egl.Context)
+			ovrTextureUploader_Upload(uploader, &upload);
+		ovrTextureUploader_ReleaseImage(&upload.Image);
+		const double seconds = vrapi_GetTimeInSeconds() - start;
+
+		pthread_mutex_lock(&uploader->Mutex);
+		uploader->Completed[uploader->CompletedCount++] = upload;
+		if (upload.Texture) {
+			uploader->Uploaded++;
+			uploader->UploadedBytes += bytes;
+			uploader->UploadSeconds += seconds;
+		}
+	}
+	pthread_mutex_unlock(&uploader->Mutex);
+
+	if (egl.Context) {
+		for (int i = 0; i < TEXTURE_UPLOAD_PBOS; i++) {
+			if (uploader->PixelBufferFences[i]) {
+				GL(glDeleteSync(uploader->PixelBufferFences[i]));
+				uploader->PixelBufferFences[i] = 0;
+			}
+		}
+		GL(glDeleteBuffers(TEXTURE_UPLOAD_PBOS, uploader->PixelBuffers));
+	}
+	ovrEgl_DestroyContext(&egl);
+	return NULL;
+}
+
+bool ovrTextureUploader_Create(ovrTextureUploader* uploader, const ovrEgl* shareEgl, int pixelBufferSize) {
+	memset(uploader, 0, sizeof(ovrTextureUploader));
+	uploader->ShareEgl = shareEgl;
+	uploader->PixelBufferSize = pixelBufferSize;
+	pthread_mutex_init(&uploader->Mutex, NULL);
+	pthread_cond_init(&uploader->Cond, NULL);
+	const int createError = pthread_create(&uploader->Thread, NULL, ovrTextureUploader_Thread, uploader);
+	if (createError) {
+		ALOGE("pthread_create returned %i", createError);
+		uploader->Thread = 0;
+		return false;
+	}
+	return true;
+}
+
+void ovrTextureUploader_Destroy(ovrTextureUploader* uploader) {
+	if (uploader->Thread) {
+		pthread_mutex_lock(&uploader->Mutex);
+		uploader->Exit = true;
+		pthread_cond_signal(&uploader->Cond);
+		pthread_mutex_unlock(&uploader->Mutex);
+		pthread_join(uploader->Thread, NULL);
+		uploader->Thread = 0;
+	}
+	for (; uploader->PendingCount > 0; uploader->PendingCount--) {
+		ovrTextureUploader_ReleaseImage(&uploader->Pending[uploader->PendingHead].Image);
+		uploader->PendingHead = (uploader->PendingHead + 1) % TEXTURE_UPLOAD_QUEUE;
+	}
+	for (int i = 0; i < uploader->CompletedCount; i++) {
+		ovrTextureUpload* upload = &uploader->Completed[i];
+		if (upload->Fence) {
+			GL(glDeleteSync(upload->Fence));
+		}
+		if (upload->Texture) {
+			GL(glDeleteTextures(1, &upload->Texture));
+		}
+	}
+	uploader->CompletedCount = 0;
+	pthread_cond_destroy(&uploader->Cond);
+	pthread_mutex_destroy(&uploader->Mutex);
+}
+
+bool ovrTextureUploader_Submit(ovrTextureUploader* uploader, const ovrTextureImage* image) {
+	if (image->LevelCount < 1 || image->LevelCount > MAX_TEXTURE_LEVELS) {
+		ALOGE("ovrTextureUploader: invalid level count %d", image->LevelCount);
+		return false;
+	}
+	pthread_mutex_lock(&uploader->Mutex);
+	if (!uploader->Thread || uploader->Exit || uploader->PendingCount == TEXTURE_UPLOAD_QUEUE) {
+		pthread_mutex_unlock(&uploader->Mutex);
+		return false;
+	}
+	ovrTextureUpload* upload = &uploader->Pending[(uploader->PendingHead + uploader->PendingCount) % TEXTURE_UPLOAD_QUEUE];
+	upload->Image = *image;
+	upload->Texture = 0;
+	upload->Fence = 0;
+	uploader->PendingCount++;
+	pthread_cond_signal(&uploader->Cond);
+	pthread_mutex_unlock(&uploader->Mutex);
+	return true;
+}
+
+int ovrTextureUploader_Poll(ovrTextureUploader* uploader, int maxCount) {
+	ovrTextureUpload ready[TEXTURE_UPLOAD_QUEUE];
+	int readyCount = 0;
+
+	pthread_mutex_lock(&uploader->Mutex);
+	int kept = 0;
+	for (int i = 0; i < uploader->CompletedCount; i++) {
+		ovrTextureUpload* upload = &uploader->Completed[i];
+		bool signaled = readyCount < maxCount;
+		if (signaled && upload->Fence) {
+			// sync objects are shared with the upload context, so a zero timeout poll never blocks this thread
+			GL(const GLenum result = glClientWaitSync(upload->Fence, 0, 0));
+			signaled = result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+			if (signaled) {
+				GL(glDeleteSync(upload->Fence));
+				upload->Fence = 0;
+			}
+		}
+		if (signaled)
+			ready[readyCount++] = *upload;
+		else
+			uploader->Completed[kept++] = *upload;
+	}
+	uploader->CompletedCount = kept;
+	if (readyCount > 0)
+		pthread_cond_signal(&uploader->Cond);
+	pthread_mutex_unlock(&uploader->Mutex);
+
+	for (int i = 0; i < readyCount; i++) {
+		const ovrTextureImage* image = &ready[i].Image;
+		if (image->Ready)
+			image->Ready(image->UserData, ready[i].Texture);
+		else if (ready[i].Texture) {
+			GL(glDeleteTextures(1, &ready[i].Texture));
+		}
+	}
+	return readyCount;
+}
+
+void ovrTextureUploader_Report(ovrTextureUploader* uploader) {
+	pthread_mutex_lock(&uploader->Mutex);
+	ALOGI("ovrTextureUploader: %d textures, %.1f MB in %.1f ms, %d pending, %d waiting on fences",
+		uploader->Uploaded, uploader->UploadedBytes / (1024.0 * 1024.0), uploader->UploadSeconds * 1000.0,
+		uploader->PendingCount, uploader->CompletedCount);
+	pthread_mutex_unlock(&uploader->Mutex);
+}
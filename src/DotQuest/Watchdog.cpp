@@ -0,0 +1,468 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+
+#include "VrApi.h"
+
+#include "VrCompositor.h"
+#include "Watchdog.h"
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unwind.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+/*
+================================================================================
+ovrWatchdog
+================================================================================
+*/
+
+#define WATCHDOG_SIGNAL			(SIGRTMIN + 7)
+#define WATCHDOG_POLL_SECONDS	0.1
+#define WATCHDOG_COVER_SECONDS	0.1
+#define WATCHDOG_REPORT_PATH	"/sdcard/DotQuest"
+
+static ovrWatchdog* ActiveWatchdog;
+static struct sigaction PreviousSignalAction;
+
+// Submits a cover frame unless the loop has beaten since the stall was detected.
+static void ovrWatchdog_CoverIfStalled(ovrWatchdog* watchdog) {
+	pthread_mutex_lock(&watchdog->Mutex);
+	if (watchdog->Covering)
+		watchdog->Cover(watchdog->UserData, &watchdog->CoverFrameIndex, &watchdog->CoverDisplayTime);
+	pthread_mutex_unlock(&watchdog->Mutex);
+}
+
+/*
+================================
+Native stacks
+
+Each of the host's threads is sent WATCHDOG_SIGNAL in turn and unwinds
+itself inside the handler.
+================================
+*/
+
+typedef struct {
+	void**					Frames;
+	int						Count;
+} ovrWatchdogUnwind;
+
+static _Unwind_Reason_Code ovrWatchdog_UnwindFrame(struct _Unwind_Context* context, void* arg) {
+	ovrWatchdogUnwind* unwind = (ovrWatchdogUnwind*)arg;
+	const uintptr_t pc = _Unwind_GetIP(context);
+	if (pc == 0)
+		return _URC_END_OF_STACK;
+	unwind->Frames[unwind->Count++] = (void*)pc;
+	return unwind->Count == WATCHDOG_MAX_FRAMES ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+static void ovrWatchdog_SignalHandler(int signal, siginfo_t* info, void* context) {
+	// installed for the watchdog's lifetime, a signal a masked thread only takes after the capture is a no-op
+	ovrWatchdog* watchdog = ActiveWatchdog;
+	if (!watchdog || !__atomic_load_n(&watchdog->Capturing, __ATOMIC_ACQUIRE))
+		return;
+	const int tid = (int)syscall(__NR_gettid);
+	for (int i = 0; i < watchdog->ThreadCount; i++) {
+		ovrWatchdogThread* thread = &watchdog->Threads[i];
+		if (thread->Tid != tid)
+			continue;
+		ovrWatchdogUnwind unwind = { thread->Frames, 0 };
+		_Unwind_Backtrace(ovrWatchdog_UnwindFrame, &unwind);
+		thread->FrameCount = unwind.Count;
+		__atomic_store_n(&thread->Done, 1, __ATOMIC_RELEASE);
+		break;
+	}
+}
+
+static bool ovrWatchdog_ReadTask(int tid, char* name, int nameSize, char* state) {
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/self/task/%d/stat", tid);
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return false;
+	char stat[256];
+	const size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+	fclose(file);
+	stat[length] = 0;
+	// "tid (comm) S ...", the name may itself contain spaces and parentheses
+	const char* open = strchr(stat, '(');
+	const char* close = strrchr(stat, ')');
+	if (!open || !close || close < open || close[1] != ' ')
+		return false;
+	const int nameLength = close - open - 1 < nameSize - 1 ? (int)(close - open - 1) : nameSize - 1;
+	memcpy(name, open + 1, nameLength);
+	name[nameLength] = 0;
+	*state = close[2];
+	return true;
+}
+
+static void ovrWatchdog_CaptureThreads(ovrWatchdog* watchdog) {
+	watchdog->ThreadCount = 0;
+	DIR* dir = opendir("/proc/self/task");
+	if (!dir)
+		return;
+	const int self = (int)syscall(__NR_gettid);
+	for (struct dirent* entry = readdir(dir); entry && watchdog->ThreadCount < WATCHDOG_MAX_THREADS; entry = readdir(dir)) {
+		const int tid = atoi(entry->d_name);
+		if (tid <= 0 || tid == self)
+			continue;
+		ovrWatchdogThread* thread = &watchdog->Threads[watchdog->ThreadCount];
+		memset(thread, 0, sizeof(ovrWatchdogThread));
+		thread->Tid = tid;
+		// only the host's own threads, the runtime and the jvm have their own ways of dumping theirs
+		if (!ovrWatchdog_ReadTask(tid, thread->Name, sizeof(thread->Name), &thread->State))
+			continue;
+		if (strncmp(thread->Name, "DQ::", 4) != 0 && strncmp(thread->Name, "OVR::", 5) != 0)
+			continue;
+		watchdog->ThreadCount++;
+	}
+	closedir(dir);
+
+	__atomic_store_n(&watchdog->Capturing, 1, __ATOMIC_RELEASE);
+	for (int i = 0; i < watchdog->ThreadCount; i++) {
+		ovrWatchdogThread* thread = &watchdog->Threads[i];
+		if (syscall(__NR_tgkill, getpid(), thread->Tid, WATCHDOG_SIGNAL) != 0)
+			continue;
+		// a thread blocked with the signal masked never answers, do not wait on it for long
+		const double start = vrapi_GetTimeInSeconds();
+		while (!__atomic_load_n(&thread->Done, __ATOMIC_ACQUIRE) && vrapi_GetTimeInSeconds() - start < 0.1)
+			usleep(1000);
+	}
+	__atomic_store_n(&watchdog->Capturing, 0, __ATOMIC_RELEASE);
+}
+
+/*
+================================
+Managed stacks
+
+Starts an EventPipe session with the sample profiler over the diagnostics
+IPC socket (${TMPDIR}/dotnet-diagnostic-<pid>-<key>-socket), and writes the
+nettrace stream, rundown included, next to the report. dotnet-trace or
+PerfView turn it into managed stacks for every thread.
+================================
+*/
+
+typedef struct {
+	unsigned char			Magic[14];				// "DOTNET_IPC_V1"
+	unsigned short			Size;					// header included
+	unsigned char			CommandSet;
+	unsigned char			CommandId;
+	unsigned short			Reserved;
+} ovrIpcHeader;
+
+enum {
+	IPC_COMMANDSET_EVENTPIPE = 0x02,
+	IPC_EVENTPIPE_STOP_TRACING = 0x01,
+	IPC_EVENTPIPE_COLLECT_TRACING = 0x02,
+	IPC_COMMANDSET_SERVER = 0xFF,
+	IPC_SERVER_OK = 0x00
+};
+
+static int ovrWatchdog_ConnectIpc() {
+	const char* tmp = getenv("TMPDIR");
+	const char* directory = tmp && tmp[0] ? tmp : "/tmp";
+	char prefix[64];
+	snprintf(prefix, sizeof(prefix), "dotnet-diagnostic-%d-", getpid());
+	DIR* dir = opendir(directory);
+	if (!dir)
+		return -1;
+	struct sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	for (struct dirent* entry = readdir(dir); entry; entry = readdir(dir)) {
+		if (strncmp(entry->d_name, prefix, strlen(prefix)) == 0 && strstr(entry->d_name, "-socket")) {
+			snprintf(address.sun_path, sizeof(address.sun_path), "%s/%s", directory, entry->d_name);
+			break;
+		}
+	}
+	closedir(dir);
+	if (!address.sun_path[0])
+		return -1;
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static bool ovrWatchdog_Read(int fd, void* data, size_t size, int timeoutMilliseconds) {
+	for (size_t offset = 0; offset < size; ) {
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if (poll(&pfd, 1, timeoutMilliseconds) <= 0)
+			return false;
+		const ssize_t length = read(fd, (char*)data + offset, size - offset);
+		if (length <= 0)
+			return false;
+		offset += length;
+	}
+	return true;
+}
+
+// Sends a command and reads the response header. Returns the socket, or -1 if the runtime refused.
+static int ovrWatchdog_SendIpc(unsigned char commandId, const void* payload, int payloadSize) {
+	const int fd = ovrWatchdog_ConnectIpc();
+	if (fd < 0)
+		return -1;
+	unsigned char message[512];
+	ovrIpcHeader header = {};
+	memcpy(header.Magic, "DOTNET_IPC_V1", 14);
+	header.Size = (unsigned short)(sizeof(ovrIpcHeader) + payloadSize);
+	header.CommandSet = IPC_COMMANDSET_EVENTPIPE;
+	header.CommandId = commandId;
+	memcpy(message, &header, sizeof(header));
+	memcpy(message + sizeof(header), payload, payloadSize);
+	ovrIpcHeader response;
+	if (write(fd, message, header.Size) != header.Size || !ovrWatchdog_Read(fd, &response, sizeof(response), 1000) ||
+		response.CommandSet != IPC_COMMANDSET_SERVER || response.CommandId != IPC_SERVER_OK) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int ovrWatchdog_PutString(unsigned char* payload, const char* text) {
+	const unsigned int length = (unsigned int)strlen(text) + 1;
+	memcpy(payload, &length, 4);
+	for (unsigned int i = 0; i < length; i++) {
+		payload[4 + i * 2] = (unsigned char)text[i];
+		payload[4 + i * 2 + 1] = 0;
+	}
+	return 4 + length * 2;
+}
+
+static bool ovrWatchdog_CaptureManaged(ovrWatchdog* watchdog, const char* path, double sampleSeconds) {
+	// CollectTracing: circular buffer MB, format (1 = nettrace), providers (keywords, level, name, filter)
+	unsigned char payload[256];
+	int size = 0;
+	const unsigned int collect[3] = { 16, 1, 1 };
+	memcpy(payload, collect, sizeof(collect));
+	size += sizeof(collect);
+	const unsigned long long keywords = 0;
+	const unsigned int level = 5;
+	memcpy(payload + size, &keywords, 8);
+	memcpy(payload + size + 8, &level, 4);
+	size += 12;
+	size += ovrWatchdog_PutString(payload + size, "Microsoft-DotNETCore-SampleProfiler");
+	memset(payload + size, 0, 4);
+	size += 4;
+
+	const int session = ovrWatchdog_SendIpc(IPC_EVENTPIPE_COLLECT_TRACING, payload, size);
+	unsigned long long sessionId = 0;
+	if (session < 0 || !ovrWatchdog_Read(session, &sessionId, sizeof(sessionId), 1000)) {
+		if (session >= 0)
+			close(session);
+		return false;
+	}
+	const int file = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	bool stopped = false;
+	const double start = vrapi_GetTimeInSeconds();
+	double covered = start;
+	for (;;) {
+		const double elapsed = vrapi_GetTimeInSeconds() - start;
+		if (vrapi_GetTimeInSeconds() - covered > WATCHDOG_COVER_SECONDS) {
+			ovrWatchdog_CoverIfStalled(watchdog);
+			covered = vrapi_GetTimeInSeconds();
+		}
+		if (!stopped && elapsed > sampleSeconds) {
+			const int stop = ovrWatchdog_SendIpc(IPC_EVENTPIPE_STOP_TRACING, &sessionId, sizeof(sessionId));
+			if (stop >= 0)
+				close(stop);
+			stopped = true;
+		}
+		// the stream ends once the rundown after the stop has been written, give up if it never does
+		if (elapsed > sampleSeconds + 5.0)
+			break;
+		char buffer[16384];
+		struct pollfd pfd = { session, POLLIN, 0 };
+		if (poll(&pfd, 1, 50) < 0)
+			break;
+		if (!(pfd.revents & (POLLIN | POLLHUP)))
+			continue;
+		const ssize_t length = read(session, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+		if (file >= 0 && write(file, buffer, length) != length)
+			break;
+	}
+	close(session);
+	if (file >= 0)
+		close(file);
+	return file >= 0;
+}
+
+/*
+================================
+Report
+================================
+*/
+
+static void ovrWatchdog_WriteReport(ovrWatchdog* watchdog, double stalledSeconds) {
+	char stamp[32];
+	const time_t now = time(NULL);
+	strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+	char path[256];
+	snprintf(path, sizeof(path), "%s/hang-%s.txt", WATCHDOG_REPORT_PATH, stamp);
+	char tracePath[256];
+	snprintf(tracePath, sizeof(tracePath), "%s/hang-%s.nettrace", WATCHDOG_REPORT_PATH, stamp);
+
+	const double start = vrapi_GetTimeInSeconds();
+	ovrWatchdog_CaptureThreads(watchdog);
+	const bool managed = ovrWatchdog_CaptureManaged(watchdog, tracePath, 0.5);
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		ALOGE("ovrWatchdog: unable to write %s", path);
+		return;
+	}
+	fprintf(file, "frame loop stalled for %.0f ms after frame %lld, stall %d\n", stalledSeconds * 1000.0, watchdog->FrameIndex, watchdog->Stalls);
+	fprintf(file, "managed: %s\n\n", managed ? tracePath : "no diagnostics ipc session");
+	for (int i = 0; i < watchdog->ThreadCount; i++) {
+		const ovrWatchdogThread* thread = &watchdog->Threads[i];
+		fprintf(file, "\"%s\" tid=%d state=%c%s\n", thread->Name, thread->Tid, thread->State, thread->Done ? "" : " (no backtrace)");
+		for (int f = 0; f < thread->FrameCount; f++) {
+			Dl_info info = {};
+			if (dladdr(thread->Frames[f], &info) && info.dli_fname) {
+				const char* module = strrchr(info.dli_fname, '/');
+				const uintptr_t base = (uintptr_t)info.dli_fbase;
+				const uintptr_t symbol = (uintptr_t)info.dli_saddr;
+				fprintf(file, "  #%02d pc %08lx %s", f, (unsigned long)((uintptr_t)thread->Frames[f] - base), module ? module + 1 : info.dli_fname);
+				if (info.dli_sname)
+					fprintf(file, " (%s+%lu)", info.dli_sname, (unsigned long)((uintptr_t)thread->Frames[f] - symbol));
+				fprintf(file, "\n");
+			}
+			else
+				fprintf(file, "  #%02d pc %p\n", f, thread->Frames[f]);
+		}
+		fprintf(file, "\n");
+	}
+	fclose(file);
+	ALOGE("ovrWatchdog: frame loop stalled for %.0f ms after frame %lld, report written to %s in %.0f ms",
+		stalledSeconds * 1000.0, watchdog->FrameIndex, path, (vrapi_GetTimeInSeconds() - start) * 1000.0);
+}
+
+static void* ovrWatchdog_ThreadFunction(void* parm) {
+	prctl(PR_SET_NAME, (long)"DQ::Watchdog", 0, 0, 0);
+	ovrWatchdog* watchdog = (ovrWatchdog*)parm;
+	// vrapi_SubmitFrame2 needs a current context, even for frames without eye buffers
+	ovrEgl egl;
+	ovrEgl_Clear(&egl);
+	ovrEgl_CreateContext(&egl, watchdog->ShareEgl);
+	if (!egl.Context)
+		ALOGE("ovrWatchdog: unable to create a shared context, stalls will not be covered");
+	pthread_mutex_lock(&watchdog->Mutex);
+	while (!watchdog->Exit) {
+		struct timespec wake;
+		clock_gettime(CLOCK_REALTIME, &wake);
+		const double interval = watchdog->Covering ? WATCHDOG_COVER_SECONDS : WATCHDOG_POLL_SECONDS;
+		wake.tv_nsec += (long)(interval * 1e9);
+		wake.tv_sec += wake.tv_nsec / 1000000000;
+		wake.tv_nsec %= 1000000000;
+		pthread_cond_timedwait(&watchdog->Cond, &watchdog->Mutex, &wake);
+		if (watchdog->Exit)
+			break;
+		if (watchdog->Suspended)
+			continue;
+		const double stalled = vrapi_GetTimeInSeconds() - watchdog->Heartbeat;
+		if (stalled < watchdog->TimeoutSeconds)
+			continue;
+		if (!watchdog->Covering) {
+			watchdog->Covering = true;
+			watchdog->Stalls++;
+			// the loop may already have advanced past the index of its last beat, never reuse that frame
+			watchdog->CoverFrameIndex = watchdog->FrameIndex + 1;
+			if (egl.Context)
+				watchdog->Cover(watchdog->UserData, &watchdog->CoverFrameIndex, &watchdog->CoverDisplayTime);
+			// the loop may beat again while this runs, the report is written with the mutex released
+			pthread_mutex_unlock(&watchdog->Mutex);
+			ovrWatchdog_WriteReport(watchdog, stalled);
+			pthread_mutex_lock(&watchdog->Mutex);
+			continue;
+		}
+		if (egl.Context)
+			watchdog->Cover(watchdog->UserData, &watchdog->CoverFrameIndex, &watchdog->CoverDisplayTime);
+	}
+	pthread_mutex_unlock(&watchdog->Mutex);
+	ovrEgl_DestroyContext(&egl);
+	return NULL;
+}
+
+bool ovrWatchdog_Create(ovrWatchdog* watchdog, int timeoutMilliseconds, const ovrEgl* shareEgl,
+	void (*cover)(void* userData, long long* frameIndex, double* displayTime), void* userData) {
+	memset(watchdog, 0, sizeof(ovrWatchdog));
+	if (timeoutMilliseconds <= 0)
+		return false;
+	watchdog->TimeoutSeconds = timeoutMilliseconds * 0.001;
+	watchdog->Heartbeat = vrapi_GetTimeInSeconds();
+	watchdog->ShareEgl = shareEgl;
+	watchdog->Cover = cover;
+	watchdog->UserData = userData;
+	pthread_mutex_init(&watchdog->Mutex, NULL);
+	pthread_cond_init(&watchdog->Cond, NULL);
+	ActiveWatchdog = watchdog;
+	struct sigaction action = {};
+	action.sa_sigaction = ovrWatchdog_SignalHandler;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(WATCHDOG_SIGNAL, &action, &PreviousSignalAction);
+	const int createError = pthread_create(&watchdog->Thread, NULL, ovrWatchdog_ThreadFunction, watchdog);
+	if (createError != 0) {
+		ALOGE("pthread_create returned %i", createError);
+		watchdog->Thread = 0;
+		sigaction(WATCHDOG_SIGNAL, &PreviousSignalAction, NULL);
+		ActiveWatchdog = NULL;
+		return false;
+	}
+	ALOGV("ovrWatchdog: %d ms", timeoutMilliseconds);
+	return true;
+}
+
+void ovrWatchdog_Destroy(ovrWatchdog* watchdog) {
+	if (!watchdog->Thread)
+		return;
+	pthread_mutex_lock(&watchdog->Mutex);
+	watchdog->Exit = true;
+	pthread_cond_signal(&watchdog->Cond);
+	pthread_mutex_unlock(&watchdog->Mutex);
+	pthread_join(watchdog->Thread, NULL);
+	pthread_cond_destroy(&watchdog->Cond);
+	pthread_mutex_destroy(&watchdog->Mutex);
+	watchdog->Thread = 0;
+	sigaction(WATCHDOG_SIGNAL, &PreviousSignalAction, NULL);
+	ActiveWatchdog = NULL;
+}
+
+bool ovrWatchdog_Heartbeat(ovrWatchdog* watchdog, long long* frameIndex, double* displayTime) {
+	if (!watchdog->Thread)
+		return false;
+	pthread_mutex_lock(&watchdog->Mutex);
+	const bool covered = watchdog->Covering;
+	if (covered) {
+		ALOGI("ovrWatchdog: frame loop resumed after %.0f ms", (vrapi_GetTimeInSeconds() - watchdog->Heartbeat) * 1000.0);
+		watchdog->Covering = false;
+		// the loop carries on from the last cover frame and advances past it before it submits again
+		*frameIndex = watchdog->CoverFrameIndex;
+		*displayTime = watchdog->CoverDisplayTime;
+	}
+	watchdog->Heartbeat = vrapi_GetTimeInSeconds();
+	watchdog->FrameIndex = *frameIndex;
+	watchdog->Suspended = false;
+	pthread_mutex_unlock(&watchdog->Mutex);
+	return covered;
+}
+
+void ovrWatchdog_Suspend(ovrWatchdog* watchdog) {
+	if (!watchdog->Thread)
+		return;
+	pthread_mutex_lock(&watchdog->Mutex);
+	watchdog->Suspended = true;
+	pthread_mutex_unlock(&watchdog->Mutex);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <pthread.h>
+
+/*
+================================================================================
+ovrWatchdog
+
+Watches the frame loop's heartbeat from its own thread. When the loop stalls
+for longer than the timeout it writes a report to /sdcard/DotQuest with the
+native stacks of the host's threads and a managed sample trace taken through
+the runtime's diagnostics IPC, then keeps the compositor fed through the
+Cover callback until the loop beats again. The watchdog thread has its own EGL
+context, shared with the loop's, and numbers the cover frames itself; the loop
+takes the frame index over from it on the next beat.
+================================================================================
+*/
+
+#define WATCHDOG_MAX_THREADS	64
+#define WATCHDOG_MAX_FRAMES		32
+
+typedef struct {
+	int						Tid;
+	char					Name[16];
+	char					State;
+	void*					Frames[WATCHDOG_MAX_FRAMES];
+	int						FrameCount;
+	volatile int			Done;
+} ovrWatchdogThread;
+
+typedef struct {
+	pthread_t				Thread;
+	pthread_mutex_t			Mutex;
+	pthread_cond_t			Cond;
+	bool					Exit;
+	double					TimeoutSeconds;
+	double					Heartbeat;				// vrapi_GetTimeInSeconds of the last beat
+	long long				FrameIndex;				// frame of the last beat
+	long long				CoverFrameIndex;		// last frame submitted by Cover
+	double					CoverDisplayTime;
+	bool					Covering;				// the loop is stalled and the watchdog submits frames
+	bool					Suspended;				// the loop is waiting on purpose, until the next beat
+	const ovrEgl*			ShareEgl;
+	// called on the watchdog thread with Mutex held about every 100 ms while the loop is stalled, must advance
+	// frameIndex and displayTime and submit a frame with them, and must not touch eye buffers
+	void					(*Cover)(void* userData, long long* frameIndex, double* displayTime);
+	void*					UserData;
+	ovrWatchdogThread		Threads[WATCHDOG_MAX_THREADS];
+	int						ThreadCount;
+	volatile int			Capturing;				// the signal handler only unwinds while native stacks are captured
+	int						Stalls;
+} ovrWatchdog;
+
+bool ovrWatchdog_Create(ovrWatchdog* watchdog, int timeoutMilliseconds, const ovrEgl* shareEgl,
+	void (*cover)(void* userData, long long* frameIndex, double* displayTime), void* userData);
+void ovrWatchdog_Destroy(ovrWatchdog* watchdog);
+// Called by the frame loop at the start of a frame and again before it submits. Blocks while a cover frame is
+// being submitted, so the loop and the watchdog never submit at the same time. Returns true if cover frames were
+// submitted since the previous beat, frameIndex and displayTime are then those of the last cover frame and the
+// loop has to advance them before submitting.
+bool ovrWatchdog_Heartbeat(ovrWatchdog* watchdog, long long* frameIndex, double* displayTime);
+// Called before the loop blocks on purpose, e.g. out of vr mode. The next heartbeat re-arms the watchdog.
+void ovrWatchdog_Suspend(ovrWatchdog* watchdog);
@@ -33,7 +33,7 @@ void Math::AnglesQuaternion(const vec3_t angles, vec4_t _) {
 }
 
 void Math::AnglesVectors(const vec3_t angles, vec3_t forward, vec3_t right, vec3_t up) {
-	static float sr, sp, sy, cr, cp, cy;
+	float sr, sp, sy, cr, cp, cy;
 #ifdef XASH_VECTORIZE_SINCOS
 	SinCosFastVector3(Math_DEG2RAD(angles[M_YAW]), Math_DEG2RAD(angles[M_PITCH]), Math_DEG2RAD(angles[M_ROLL]),
 		&sy, &sp, &sr,
@@ -80,46 +80,45 @@ bool Math::BoundsIntersect(const vec3_t mins1, const vec3_t maxs1, const vec3_t
 }
 
 unsigned short Math::FloatToHalf(float value) {
-	unsigned int i = *((unsigned int*)&value);
-	unsigned int e = (i >> 23) & 0x00ff;
-	unsigned int m = i & 0x007fffff;
-	unsigned short h = e <= 127 - 15
-		? ((m | 0x00800000) >> (127 - 14 - e)) >> 13
-		: (i >> 13) & 0x3fff;
-	h |= (i >> 16) & 0xc000;
-	return h;
+	return Math_FloatToHalf(value);
 }
 
 float Math::HalfToFloat(unsigned short value) {
-	unsigned int f = (value << 16) & 0x80000000;
-	unsigned int em = value & 0x7fff;
-	if (em > 0x03ff)
-		f |= (em << 13) + ((127 - 15) << 23);
-	else {
-		unsigned int m = em & 0x03ff;
-		if (m != 0) {
-			unsigned int e = (em >> 10) & 0x1f;
-			while (!(m & 0x0400)) { m <<= 1; e--; }
-			m &= 0x3ff;
-			f |= ((e + (127 - 14)) << 23) | (m << 13);
-		}
+	return Math_HalfToFloat(value);
+}
+
+void Math::FloatToHalfBatch(const float* values, unsigned short* _, int count) {
+	int i = 0;
+#if MATH_SIMD
+	for (; i + 8 <= count; i += 8) {
+		Simd_StoreHalf(_ + i, Simd_Load(values + i));
+		Simd_StoreHalf(_ + i + 4, Simd_Load(values + i + 4));
+	}
+#endif
+	for (; i < count; i++)
+		_[i] = Math_FloatToHalf(values[i]);
+}
+
+void Math::HalfToFloatBatch(const unsigned short* values, float* _, int count) {
+	int i = 0;
+#if MATH_SIMD
+	for (; i + 8 <= count; i += 8) {
+		Simd_Store(_ + i, Simd_LoadHalf(values + i));
+		Simd_Store(_ + i + 4, Simd_LoadHalf(values + i + 4));
 	}
-	return *((float*)&f);
+#endif
+	for (; i < count; i++)
+		_[i] = Math_HalfToFloat(values[i]);
 }
 
 void Math::Matrix3x4_ConcatTransforms(matrix3x4 _, cmatrix3x4 m1, cmatrix3x4 m2) {
-	_[0][0] = m1[0][0] * m2[0][0] + m1[0][1] * m2[1][0] + m1[0][2] * m2[2][0];
-	_[0][1] = m1[0][0] * m2[0][1] + m1[0][1] * m2[1][1] + m1[0][2] * m2[2][1];
-	_[0][2] = m1[0][0] * m2[0][2] + m1[0][1] * m2[1][2] + m1[0][2] * m2[2][2];
-	_[0][3] = m1[0][0] * m2[0][3] + m1[0][1] * m2[1][3] + m1[0][2] * m2[2][3] + m1[0][3];
-	_[1][0] = m1[1][0] * m2[0][0] + m1[1][1] * m2[1][0] + m1[1][2] * m2[2][0];
-	_[1][1] = m1[1][0] * m2[0][1] + m1[1][1] * m2[1][1] + m1[1][2] * m2[2][1];
-	_[1][2] = m1[1][0] * m2[0][2] + m1[1][1] * m2[1][2] + m1[1][2] * m2[2][2];
-	_[1][3] = m1[1][0] * m2[0][3] + m1[1][1] * m2[1][3] + m1[1][2] * m2[2][3] + m1[1][3];
-	_[2][0] = m1[2][0] * m2[0][0] + m1[2][1] * m2[1][0] + m1[2][2] * m2[2][0];
-	_[2][1] = m1[2][0] * m2[0][1] + m1[2][1] * m2[1][1] + m1[2][2] * m2[2][1];
-	_[2][2] = m1[2][0] * m2[0][2] + m1[2][1] * m2[1][2] + m1[2][2] * m2[2][2];
-	_[2][3] = m1[2][0] * m2[0][3] + m1[2][1] * m2[1][3] + m1[2][2] * m2[2][3] + m1[2][3];
+	Math_Matrix3x4_ConcatTransforms(_, m1, m2);
+}
+
+// _[i] = m1[i] * m2[i], e.g. bone parents and locals
+void Math::Matrix3x4_ConcatTransformsBatch(matrix3x4* _, const matrix3x4* m1, const matrix3x4* m2, int count) {
+	for (int i = 0; i < count; i++)
+		Math_Matrix3x4_ConcatTransforms(_[i], (vec4_t*)m1[i], (vec4_t*)m2[i]);
 }
 
 void Math::Matrix3x4_CreateFromEntity(matrix3x4 _, const vec3_t angles, const vec3_t origin, float scale) {
@@ -269,65 +268,56 @@ void Math::Matrix3x4_TransformPositivePlane(cmatrix3x4 m, const vec3_t normal, f
 }
 
 void Math::Matrix3x4_VectorIRotate(cmatrix3x4 m, const float v[3], float _[3]) {
-	_[0] = v[0] * m[0][0] + v[1] * m[1][0] + v[2] * m[2][0];
-	_[1] = v[0] * m[0][1] + v[1] * m[1][1] + v[2] * m[2][1];
-	_[2] = v[0] * m[0][2] + v[1] * m[1][2] + v[2] * m[2][2];
+	Math_Matrix3x4_VectorIRotate(m, v, _);
 }
 
 void Math::Matrix3x4_VectorITransform(cmatrix3x4 m, const float v[3], float _[3]) {
-	vec3_t	dir;
-	dir[0] = v[0] - m[0][3];
-	dir[1] = v[1] - m[1][3];
-	dir[2] = v[2] - m[2][3];
-	_[0] = dir[0] * m[0][0] + dir[1] * m[1][0] + dir[2] * m[2][0];
-	_[1] = dir[0] * m[0][1] + dir[1] * m[1][1] + dir[2] * m[2][1];
-	_[2] = dir[0] * m[0][2] + dir[1] * m[1][2] + dir[2] * m[2][2];
+	Math_Matrix3x4_VectorITransform(m, v, _);
 }
 
 void Math::Matrix3x4_VectorRotate(cmatrix3x4 m, const float v[3], float _[3]) {
-	_[0] = v[0] * m[0][0] + v[1] * m[0][1] + v[2] * m[0][2];
-	_[1] = v[0] * m[1][0] + v[1] * m[1][1] + v[2] * m[1][2];
-	_[2] = v[0] * m[2][0] + v[1] * m[2][1] + v[2] * m[2][2];
+	Math_Matrix3x4_VectorRotate(m, v, _);
 }
 
 void Math::Matrix3x4_VectorTransform(cmatrix3x4 m, const float v[3], float _[3]) {
-	_[0] = v[0] * m[0][0] + v[1] * m[0][1] + v[2] * m[0][2] + m[0][3];
-	_[1] = v[0] * m[1][0] + v[1] * m[1][1] + v[2] * m[1][2] + m[1][3];
-	_[2] = v[0] * m[2][0] + v[1] * m[2][1] + v[2] * m[2][2] + m[2][3];
+	Math_Matrix3x4_VectorTransform(m, v, _);
+}
+
+// count points by one matrix, four per vector; _ may be v
+void Math::Matrix3x4_VectorTransformBatch(cmatrix3x4 m, const vec3soa_t* v, vec3soa_t* _, int count) {
+	int i = 0;
+#if MATH_SIMD
+	const simd4f m00 = Simd_Splat(m[0][0]), m01 = Simd_Splat(m[0][1]), m02 = Simd_Splat(m[0][2]), m03 = Simd_Splat(m[0][3]);
+	const simd4f m10 = Simd_Splat(m[1][0]), m11 = Simd_Splat(m[1][1]), m12 = Simd_Splat(m[1][2]), m13 = Simd_Splat(m[1][3]);
+	const simd4f m20 = Simd_Splat(m[2][0]), m21 = Simd_Splat(m[2][1]), m22 = Simd_Splat(m[2][2]), m23 = Simd_Splat(m[2][3]);
+	for (; i + 4 <= count; i += 4) {
+		const simd4f x = Simd_Load(v->x + i);
+		const simd4f y = Simd_Load(v->y + i);
+		const simd4f z = Simd_Load(v->z + i);
+		Simd_Store(_->x + i, Simd_Add(Simd_MulAdd(Simd_MulAdd(Simd_Mul(x, m00), y, m01), z, m02), m03));
+		Simd_Store(_->y + i, Simd_Add(Simd_MulAdd(Simd_MulAdd(Simd_Mul(x, m10), y, m11), z, m12), m13));
+		Simd_Store(_->z + i, Simd_Add(Simd_MulAdd(Simd_MulAdd(Simd_Mul(x, m20), y, m21), z, m22), m23));
+	}
+#endif
+	for (; i < count; i++) {
+		const float x = v->x[i], y = v->y[i], z = v->z[i];
+		_->x[i] = x * m[0][0] + y * m[0][1] + z * m[0][2] + m[0][3];
+		_->y[i] = x * m[1][0] + y * m[1][1] + z * m[1][2] + m[1][3];
+		_->z[i] = x * m[2][0] + y * m[2][1] + z * m[2][2] + m[2][3];
+	}
 }
 
 void Math::Matrix4x4_Concat(matrix4x4 _, const matrix4x4 m1, const matrix4x4 m2) {
-	_[0][0] = m1[0][0] * m2[0][0] + m1[0][1] * m2[1][0] + m1[0][2] * m2[2][0] + m1[0][3] * m2[3][0];
-	_[0][1] = m1[0][0] * m2[0][1] + m1[0][1] * m2[1][1] + m1[0][2] * m2[2][1] + m1[0][3] * m2[3][1];
-	_[0][2] = m1[0][0] * m2[0][2] + m1[0][1] * m2[1][2] + m1[0][2] * m2[2][2] + m1[0][3] * m2[3][2];
-	_[0][3] = m1[0][0] * m2[0][3] + m1[0][1] * m2[1][3] + m1[0][2] * m2[2][3] + m1[0][3] * m2[3][3];
-	_[1][0] = m1[1][0] * m2[0][0] + m1[1][1] * m2[1][0] + m1[1][2] * m2[2][0] + m1[1][3] * m2[3][0];
-	_[1][1] = m1[1][0] * m2[0][1] + m1[1][1] * m2[1][1] + m1[1][2] * m2[2][1] + m1[1][3] * m2[3][1];
-	_[1][2] = m1[1][0] * m2[0][2] + m1[1][1] * m2[1][2] + m1[1][2] * m2[2][2] + m1[1][3] * m2[3][2];
-	_[1][3] = m1[1][0] * m2[0][3] + m1[1][1] * m2[1][3] + m1[1][2] * m2[2][3] + m1[1][3] * m2[3][3];
-	_[2][0] = m1[2][0] * m2[0][0] + m1[2][1] * m2[1][0] + m1[2][2] * m2[2][0] + m1[2][3] * m2[3][0];
-	_[2][1] = m1[2][0] * m2[0][1] + m1[2][1] * m2[1][1] + m1[2][2] * m2[2][1] + m1[2][3] * m2[3][1];
-	_[2][2] = m1[2][0] * m2[0][2] + m1[2][1] * m2[1][2] + m1[2][2] * m2[2][2] + m1[2][3] * m2[3][2];
-	_[2][3] = m1[2][0] * m2[0][3] + m1[2][1] * m2[1][3] + m1[2][2] * m2[2][3] + m1[2][3] * m2[3][3];
-	_[3][0] = m1[3][0] * m2[0][0] + m1[3][1] * m2[1][0] + m1[3][2] * m2[2][0] + m1[3][3] * m2[3][0];
-	_[3][1] = m1[3][0] * m2[0][1] + m1[3][1] * m2[1][1] + m1[3][2] * m2[2][1] + m1[3][3] * m2[3][1];
-	_[3][2] = m1[3][0] * m2[0][2] + m1[3][1] * m2[1][2] + m1[3][2] * m2[2][2] + m1[3][3] * m2[3][2];
-	_[3][3] = m1[3][0] * m2[0][3] + m1[3][1] * m2[1][3] + m1[3][2] * m2[2][3] + m1[3][3] * m2[3][3];
+	Math_Matrix4x4_Concat(_, m1, m2);
 }
 
 void Math::Matrix4x4_ConcatTransforms(matrix4x4 _, cmatrix4x4 m1, cmatrix4x4 m2) {
-	_[0][0] = m1[0][0] * m2[0][0] + m1[0][1] * m2[1][0] + m1[0][2] * m2[2][0];
-	_[0][1] = m1[0][0] * m2[0][1] + m1[0][1] * m2[1][1] + m1[0][2] * m2[2][1];
-	_[0][2] = m1[0][0] * m2[0][2] + m1[0][1] * m2[1][2] + m1[0][2] * m2[2][2];
-	_[0][3] = m1[0][0] * m2[0][3] + m1[0][1] * m2[1][3] + m1[0][2] * m2[2][3] + m1[0][3];
-	_[1][0] = m1[1][0] * m2[0][0] + m1[1][1] * m2[1][0] + m1[1][2] * m2[2][0];
-	_[1][1] = m1[1][0] * m2[0][1] + m1[1][1] * m2[1][1] + m1[1][2] * m2[2][1];
-	_[1][2] = m1[1][0] * m2[0][2] + m1[1][1] * m2[1][2] + m1[1][2] * m2[2][2];
-	_[1][3] = m1[1][0] * m2[0][3] + m1[1][1] * m2[1][3] + m1[1][2] * m2[2][3] + m1[1][3];
-	_[2][0] = m1[2][0] * m2[0][0] + m1[2][1] * m2[1][0] + m1[2][2] * m2[2][0];
-	_[2][1] = m1[2][0] * m2[0][1] + m1[2][1] * m2[1][1] + m1[2][2] * m2[2][1];
-	_[2][2] = m1[2][0] * m2[0][2] + m1[2][1] * m2[1][2] + m1[2][2] * m2[2][2];
-	_[2][3] = m1[2][0] * m2[0][3] + m1[2][1] * m2[1][3] + m1[2][2] * m2[2][3] + m1[2][3];
+	Math_Matrix4x4_ConcatTransforms(_, m1, m2);
+}
+
+void Math::Matrix4x4_ConcatTransformsBatch(matrix4x4* _, const matrix4x4* m1, const matrix4x4* m2, int count) {
+	for (int i = 0; i < count; i++)
+		Math_Matrix4x4_ConcatTransforms(_[i], (vec4_t*)m1[i], (vec4_t*)m2[i]);
 }
 
 void Math::Matrix4x4_ConvertToEntity(cmatrix4x4 m, vec3_t angles, vec3_t origin) {
@@ -781,31 +771,23 @@ void Math::Matrix4x4_Transpose(matrix4x4 _, cmatrix4x4 m) {
 }
 
 void Math::Matrix4x4_VectorIRotate(cmatrix4x4 m, const float v[3], float _[3]) {
-	_[0] = v[0] * m[0][0] + v[1] * m[1][0] + v[2] * m[2][0];
-	_[1] = v[0] * m[0][1] + v[1] * m[1][1] + v[2] * m[2][1];
-	_[2] = v[0] * m[0][2] + v[1] * m[1][2] + v[2] * m[2][2];
+	Math_Matrix4x4_VectorIRotate(m, v, _);
 }
 
 void Math::Matrix4x4_VectorITransform(cmatrix4x4 m, const float v[3], float _[3]) {
-	vec3_t	dir;
-	dir[0] = v[0] - m[0][3];
-	dir[1] = v[1] - m[1][3];
-	dir[2] = v[2] - m[2][3];
-	_[0] = dir[0] * m[0][0] + dir[1] * m[1][0] + dir[2] * m[2][0];
-	_[1] = dir[0] * m[0][1] + dir[1] * m[1][1] + dir[2] * m[2][1];
-	_[2] = dir[0] * m[0][2] + dir[1] * m[1][2] + dir[2] * m[2][2];
+	Math_Matrix4x4_VectorITransform(m, v, _);
 }
 
 void Math::Matrix4x4_VectorRotate(cmatrix4x4 m, const float v[3], float _[3]) {
-	_[0] = v[0] * m[0][0] + v[1] * m[0][1] + v[2] * m[0][2];
-	_[1] = v[0] * m[1][0] + v[1] * m[1][1] + v[2] * m[1][2];
-	_[2] = v[0] * m[2][0] + v[1] * m[2][1] + v[2] * m[2][2];
+	Math_Matrix4x4_VectorRotate(m, v, _);
 }
 
 void Math::Matrix4x4_VectorTransform(cmatrix4x4 m, const float v[3], float _[3]) {
-	_[0] = v[0] * m[0][0] + v[1] * m[0][1] + v[2] * m[0][2] + m[0][3];
-	_[1] = v[0] * m[1][0] + v[1] * m[1][1] + v[2] * m[1][2] + m[1][3];
-	_[2] = v[0] * m[2][0] + v[1] * m[2][1] + v[2] * m[2][2] + m[2][3];
+	Math_Matrix4x4_VectorTransform(m, v, _);
+}
+
+void Math::Matrix4x4_VectorTransformBatch(cmatrix4x4 m, const vec3soa_t* v, vec3soa_t* _, int count) {
+	Matrix3x4_VectorTransformBatch(m, v, _, count);
 }
 
 int Math::NearestPow(int value, bool roundDown) {
@@ -816,12 +798,137 @@ int Math::NearestPow(int value, bool roundDown) {
 	return n;
 }
 
-void Math::QuaternionSlerp(const vec4_t p, vec4_t q, float t, vec4_t _) {
+// nlerp weight that follows slerp for quaternions dot d >= 0 apart, Kapoulkine's fit of the slerp timing curve
+static inline float QuaternionBlendWeight(float t, float d) {
+	const float A = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+	const float B = 0.848013f + d * (-1.06021f + d * 0.215638f);
+	const float k = A * (t - 0.5f) * (t - 0.5f) + B;
+	return t + t * (t - 0.5f) * (t - 1.0f) * k;
+}
+
+#if MATH_SIMD
+// 4 bones per call: transposed to x, y, z, w vectors, blended, transposed back. _ may be p or q
+static inline void QuaternionBlend4(const vec4_t* p, const vec4_t* q, const float* weights, vec4_t* _, int mode) {
+	simd4f px = Simd_Load(p[0]), py = Simd_Load(p[1]), pz = Simd_Load(p[2]), pw = Simd_Load(p[3]);
+	simd4f qx = Simd_Load(q[0]), qy = Simd_Load(q[1]), qz = Simd_Load(q[2]), qw = Simd_Load(q[3]);
+	Simd_Transpose(&px, &py, &pz, &pw);
+	Simd_Transpose(&qx, &qy, &qz, &qw);
+	simd4f t = Simd_Load(weights);
+	simd4f d = Simd_MulAdd(Simd_MulAdd(Simd_MulAdd(Simd_Mul(px, qx), py, qy), pz, qz), pw, qw);
+	// take the shorter arc: where the dot is negative q is negated, by flipping the sign of its scale
+	const simd4f flip = Simd_SignBits(d);
+	d = Simd_Abs(d);
+	simd4f sclp, sclq;
+	if (mode == QUAT_BLEND_SLERP) {
+		const simd4f omega = Simd_Acos(d);
+		const simd4f sinom = Simd_Sin(omega);
+		const simd4f slerpP = Simd_Div(Simd_Sin(Simd_Mul(Simd_Sub(Simd_Splat(1.0f), t), omega)), sinom);
+		const simd4f slerpQ = Simd_Div(Simd_Sin(Simd_Mul(t, omega)), sinom);
+		// nearly equal rotations lerp, like QuaternionSlerp
+		const simd4f near = Simd_Greater(d, Simd_Splat(1.0f - 0.000001f));
+		sclp = Simd_Select(near, Simd_Sub(Simd_Splat(1.0f), t), slerpP);
+		sclq = Simd_Select(near, t, slerpQ);
+	}
+	else {
+		if (mode == QUAT_BLEND_SLERP_FAST) {
+			const simd4f A = Simd_Add(Simd_Splat(1.0904f), Simd_Mul(d, Simd_Add(Simd_Splat(-3.2452f), Simd_Mul(d, Simd_Sub(Simd_Splat(3.55645f), Simd_Mul(d, Simd_Splat(1.43519f)))))));
+			const simd4f B = Simd_Add(Simd_Splat(0.848013f), Simd_Mul(d, Simd_Add(Simd_Splat(-1.06021f), Simd_Mul(d, Simd_Splat(0.215638f)))));
+			const simd4f c = Simd_Sub(t, Simd_Splat(0.5f));
+			const simd4f k = Simd_Add(Simd_Mul(Simd_Mul(A, c), c), B);
+			t = Simd_Add(t, Simd_Mul(Simd_Mul(Simd_Mul(t, c), Simd_Sub(t, Simd_Splat(1.0f))), k));
+		}
+		sclp = Simd_Sub(Simd_Splat(1.0f), t);
+		sclq = t;
+	}
+	sclq = Simd_Xor(sclq, flip);
+	simd4f x = Simd_MulAdd(Simd_Mul(sclp, px), sclq, qx);
+	simd4f y = Simd_MulAdd(Simd_Mul(sclp, py), sclq, qy);
+	simd4f z = Simd_MulAdd(Simd_Mul(sclp, pz), sclq, qz);
+	simd4f w = Simd_MulAdd(Simd_Mul(sclp, pw), sclq, qw);
+	if (mode != QUAT_BLEND_SLERP) {
+		const simd4f length = Simd_Sqrt(Simd_MulAdd(Simd_MulAdd(Simd_MulAdd(Simd_Mul(x, x), y, y), z, z), w, w));
+		x = Simd_Div(x, length);
+		y = Simd_Div(y, length);
+		z = Simd_Div(z, length);
+		w = Simd_Div(w, length);
+	}
+	Simd_Transpose(&x, &y, &z, &w);
+	Simd_Store(_[0], x);
+	Simd_Store(_[1], y);
+	Simd_Store(_[2], z);
+	Simd_Store(_[3], w);
+}
+#else
+static inline void QuaternionBlend1(const vec4_t p, const vec4_t q, float t, vec4_t _, int mode) {
+	float d = p[0] * q[0] + p[1] * q[1] + p[2] * q[2] + p[3] * q[3];
+	const float flip = d < 0.0f ? -1.0f : 1.0f;
+	d = fabsf(d);
+	float sclp, sclq;
+	if (mode == QUAT_BLEND_SLERP && d <= 1.0f - 0.000001f) {
+		const float omega = acosf(d);
+		const float sinom = sinf(omega);
+		sclp = sinf((1.0f - t) * omega) / sinom;
+		sclq = sinf(t * omega) / sinom;
+	}
+	else {
+		if (mode == QUAT_BLEND_SLERP_FAST)
+			t = QuaternionBlendWeight(t, d);
+		sclp = 1.0f - t;
+		sclq = t;
+	}
+	sclq *= flip;
+	vec4_t r;
+	for (int i = 0; i < 4; i++)
+		r[i] = sclp * p[i] + sclq * q[i];
+	float l = 1.0f;
+	if (mode != QUAT_BLEND_SLERP)
+		l = 1.0f / sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+	Math_Vector4Set(_, r[0] * l, r[1] * l, r[2] * l, r[3] * l);
+}
+#endif
+
+// _[i] = blend of p[i] toward q[i] by weights[i], along the shorter arc; _ may be p or q. For animation blending,
+// where one call covers every bone of every character
+void Math::QuaternionBlendBatch(const vec4_t* p, const vec4_t* q, const float* weights, vec4_t* _, int count, int mode) {
+	int i = 0;
+#if MATH_SIMD
+	for (; i + 4 <= count; i += 4)
+		QuaternionBlend4(p + i, q + i, weights + i, _ + i, mode);
+	if (i < count) {
+		// the tail is padded with identities, so it takes the same path
+		vec4_t tailP[4], tailQ[4], tail[4];
+		float tailWeights[4];
+		for (int j = 0; j < 4; j++) {
+			if (i + j < count) {
+				Math_Vector4Cpy(p[i + j], tailP[j]);
+				Math_Vector4Cpy(q[i + j], tailQ[j]);
+				tailWeights[j] = weights[i + j];
+			}
+			else {
+				Math_Vector4Set(tailP[j], 0.0f, 0.0f, 0.0f, 1.0f);
+				Math_Vector4Set(tailQ[j], 0.0f, 0.0f, 0.0f, 1.0f);
+				tailWeights[j] = 0.0f;
+			}
+		}
+		QuaternionBlend4(tailP, tailQ, tailWeights, tail, mode);
+		for (int j = 0; i + j < count; j++)
+			Math_Vector4Cpy(tail[j], _[i + j]);
+	}
+#else
+	for (; i < count; i++)
+		QuaternionBlend1(p[i], q[i], weights[i], _[i], mode);
+#endif
+}
+
+void Math::QuaternionSlerp(const vec4_t p, const vec4_t q0, float t, vec4_t _) {
 	float omega, sclp, sclq;
 	float cosom, sinom;
 	float a = 0.0f;
 	float b = 0.0f;
 	int	i;
+	// q0 is the caller's, the flip below works on a copy
+	vec4_t q;
+	Math_Vector4Cpy(q0, q);
 	// decide if one of the quaternions is backwards
 	for (i = 0; i < 4; i++) {
 		a += (p[i] - q[i]) * (p[i] - q[i]);
@@ -868,14 +975,7 @@ void Math::QuaternionSlerp(const vec4_t p, vec4_t q, float t, vec4_t _) {
 float Math::RangeRemapValue(float value, float a, float b, float c, float d) { return c + (d - c) * (value - a) / (b - a); }
 
 float Math::Rsqrt(float value) {
-	if (value == 0.0f)
-		return 0.0f;
-	float x = value * 0.5f;
-	int i = *(int*)&value;
-	i = 0x5f3759df - (i >> 1);
-	float y = *(float*)&i;
-	y = y * (1.5f - (x * y * y));
-	return y;
+	return Math_Rsqrt(value);
 }
 
 void Math::SinCos(float radians, float* sin, float* cos) {
@@ -953,14 +1053,9 @@ void Math::SinFastVector3(float r1, float r2, float r3,
 #endif
 
 float Math::Vector2NormLen(const vec3_t v, vec3_t _) {
-	float length = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
-	length = sqrt(length);
-	if (length) {
-		float ilength = 1.0f / length;
-		_[0] = v[0] * ilength;
-		_[1] = v[1] * ilength;
-		_[2] = v[2] * ilength;
-	}
+	const Vec<3> a = Vec<3>::Load(v);
+	const float length = Vec_Length(a);
+	if (length) (a * (1.0f / length)).Store(_);
 	return length;
 }
 
@@ -0,0 +1,183 @@
+#ifndef MATHINLINE_H
+#define MATHINLINE_H
+
+// The Math routines called once per vertex, bone or point, as inline functions a caller's loop can absorb. The
+// Math:: members of the same names are out-of-line copies of these for anything holding a pointer to them.
+
+inline float Math_Rsqrt(float value) {
+	if (value == 0.0f)
+		return 0.0f;
+	float x = value * 0.5f;
+	int i;
+	memcpy(&i, &value, sizeof(i));
+	i = 0x5f3759df - (i >> 1);
+	float y;
+	memcpy(&y, &i, sizeof(y));
+	y = y * (1.5f - (x * y * y));
+	return y;
+}
+
+// Rounds to nearest even, as the hardware conversions do. 65520 and up become infinity, NaN a quiet NaN.
+inline unsigned short Math_FloatToHalf(float value) {
+	unsigned int i;
+	memcpy(&i, &value, sizeof(i));
+	const unsigned int sign = i & 0x80000000;
+	i ^= sign;
+	unsigned int h;
+	if (i >= (127 + 16) << 23)
+		h = i > 0x7f800000 ? 0x7e00 : 0x7c00;
+	else if (i < 113 << 23) {
+		// the float adder rounds the denormal mantissa, against a magic number whose last bit is the half denormal step
+		const unsigned int magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+		float f, magic;
+		memcpy(&f, &i, sizeof(f));
+		memcpy(&magic, &magicBits, sizeof(magic));
+		f += magic;
+		memcpy(&h, &f, sizeof(h));
+		h -= magicBits;
+	}
+	else
+		h = (i - ((127u - 15u) << 23) + 0xfff + ((i >> 13) & 1)) >> 13;
+	return (unsigned short)(h | (sign >> 16));
+}
+
+inline float Math_HalfToFloat(unsigned short value) {
+	unsigned int f = (value << 16) & 0x80000000;
+	unsigned int em = value & 0x7fff;
+	if (em >= 0x7c00)
+		f |= 0x7f800000 | ((em & 0x03ff) << 13);
+	else if (em > 0x03ff)
+		f |= (em << 13) + ((127 - 15) << 23);
+	else {
+		unsigned int m = em & 0x03ff;
+		if (m != 0) {
+			unsigned int e = (em >> 10) & 0x1f;
+			while (!(m & 0x0400)) { m <<= 1; e--; }
+			m &= 0x3ff;
+			f |= ((e + (127 - 14)) << 23) | (m << 13);
+		}
+	}
+	float value32;
+	memcpy(&value32, &f, sizeof(value32));
+	return value32;
+}
+
+inline void Math_Matrix3x4_ConcatTransforms(matrix3x4 _, cmatrix3x4 m1, cmatrix3x4 m2) {
+#if MATH_SIMD
+	const simd4f b0 = Simd_Load(m2[0]);
+	const simd4f b1 = Simd_Load(m2[1]);
+	const simd4f b2 = Simd_Load(m2[2]);
+	for (int i = 0; i < 3; i++) {
+		simd4f r = Simd_Mul(Simd_Splat(m1[i][0]), b0);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][1]), b1);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][2]), b2);
+		// the implied fourth row of m2 is (0, 0, 0, 1), so it only adds the translation
+		Simd_Store(_[i], Simd_Add(r, Simd_MaskW(Simd_Load(m1[i]))));
+	}
+#else
+	Mat_ConcatTransforms(Mat<3, 4>::Load(m1), Mat<3, 4>::Load(m2)).Store(_);
+#endif
+}
+
+inline void Math_Matrix4x4_ConcatTransforms(matrix4x4 _, cmatrix4x4 m1, cmatrix4x4 m2) {
+#if MATH_SIMD
+	const simd4f b0 = Simd_Load(m2[0]);
+	const simd4f b1 = Simd_Load(m2[1]);
+	const simd4f b2 = Simd_Load(m2[2]);
+	for (int i = 0; i < 3; i++) {
+		simd4f r = Simd_Mul(Simd_Splat(m1[i][0]), b0);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][1]), b1);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][2]), b2);
+		// the implied fourth row of m2 is (0, 0, 0, 1), so it only adds the translation
+		Simd_Store(_[i], Simd_Add(r, Simd_MaskW(Simd_Load(m1[i]))));
+	}
+#else
+	Mat_ConcatTransforms(Mat<3, 4>::Load(m1), Mat<3, 4>::Load(m2)).Store(_);
+#endif
+}
+
+inline void Math_Matrix4x4_Concat(matrix4x4 _, const matrix4x4 m1, const matrix4x4 m2) {
+#if MATH_SIMD
+	const simd4f b0 = Simd_Load(m2[0]);
+	const simd4f b1 = Simd_Load(m2[1]);
+	const simd4f b2 = Simd_Load(m2[2]);
+	const simd4f b3 = Simd_Load(m2[3]);
+	for (int i = 0; i < 4; i++) {
+		simd4f r = Simd_Mul(Simd_Splat(m1[i][0]), b0);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][1]), b1);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][2]), b2);
+		r = Simd_MulAdd(r, Simd_Splat(m1[i][3]), b3);
+		Simd_Store(_[i], r);
+	}
+#else
+	Mat_Mul(Mat<4, 4>::Load(m1), Mat<4, 4>::Load(m2)).Store(_);
+#endif
+}
+
+inline void Math_Matrix3x4_VectorIRotate(cmatrix3x4 m, const float v[3], float _[3]) {
+	_[0] = v[0] * m[0][0] + v[1] * m[1][0] + v[2] * m[2][0];
+	_[1] = v[0] * m[0][1] + v[1] * m[1][1] + v[2] * m[2][1];
+	_[2] = v[0] * m[0][2] + v[1] * m[1][2] + v[2] * m[2][2];
+}
+
+inline void Math_Matrix3x4_VectorITransform(cmatrix3x4 m, const float v[3], float _[3]) {
+	vec3_t	dir;
+	dir[0] = v[0] - m[0][3];
+	dir[1] = v[1] - m[1][3];
+	dir[2] = v[2] - m[2][3];
+	_[0] = dir[0] * m[0][0] + dir[1] * m[1][0] + dir[2] * m[2][0];
+	_[1] = dir[0] * m[0][1] + dir[1] * m[1][1] + dir[2] * m[2][1];
+	_[2] = dir[0] * m[0][2] + dir[1] * m[1][2] + dir[2] * m[2][2];
+}
+
+inline void Math_Matrix3x4_VectorRotate(cmatrix3x4 m, const float v[3], float _[3]) {
+	_[0] = v[0] * m[0][0] + v[1] * m[0][1] + v[2] * m[0][2];
+	_[1] = v[0] * m[1][0] + v[1] * m[1][1] + v[2] * m[1][2];
+	_[2] = v[0] * m[2][0] + v[1] * m[2][1] + v[2] * m[2][2];
+}
+
+inline void Math_Matrix3x4_VectorTransform(cmatrix3x4 m, const float v[3], float _[3]) {
+#if MATH_SIMD
+	const simd4f p = Simd_Load3(v, 1.0f);
+	Simd_Store3(_, Simd_Sum3(Simd_Mul(Simd_Load(m[0]), p), Simd_Mul(Simd_Load(m[1]), p), Simd_Mul(Simd_Load(m[2]), p)));
+#else
+	// row by row rather than through Mat_TransformPoint, so the whole matrix is never copied for one point
+	const Vec<3> p = Vec<3>::Load(v);
+	Vec3(Vec_Dot(Vec<3>::Load(m[0]), p) + m[0][3], Vec_Dot(Vec<3>::Load(m[1]), p) + m[1][3], Vec_Dot(Vec<3>::Load(m[2]), p) + m[2][3]).Store(_);
+#endif
+}
+
+inline void Math_Matrix4x4_VectorIRotate(cmatrix4x4 m, const float v[3], float _[3]) {
+	_[0] = v[0] * m[0][0] + v[1] * m[1][0] + v[2] * m[2][0];
+	_[1] = v[0] * m[0][1] + v[1] * m[1][1] + v[2] * m[2][1];
+	_[2] = v[0] * m[0][2] + v[1] * m[1][2] + v[2] * m[2][2];
+}
+
+inline void Math_Matrix4x4_VectorITransform(cmatrix4x4 m, const float v[3], float _[3]) {
+	vec3_t	dir;
+	dir[0] = v[0] - m[0][3];
+	dir[1] = v[1] - m[1][3];
+	dir[2] = v[2] - m[2][3];
+	_[0] = dir[0] * m[0][0] + dir[1] * m[1][0] + dir[2] * m[2][0];
+	_[1] = dir[0] * m[0][1] + dir[1] * m[1][1] + dir[2] * m[2][1];
+	_[2] = dir[0] * m[0][2] + dir[1] * m[1][2] + dir[2] * m[2][2];
+}
+
+inline void Math_Matrix4x4_VectorRotate(cmatrix4x4 m, const float v[3], float _[3]) {
+	_[0] = v[0] * m[0][0] + v[1] * m[0][1] + v[2] * m[0][2];
+	_[1] = v[0] * m[1][0] + v[1] * m[1][1] + v[2] * m[1][2];
+	_[2] = v[0] * m[2][0] + v[1] * m[2][1] + v[2] * m[2][2];
+}
+
+inline void Math_Matrix4x4_VectorTransform(cmatrix4x4 m, const float v[3], float _[3]) {
+#if MATH_SIMD
+	const simd4f p = Simd_Load3(v, 1.0f);
+	Simd_Store3(_, Simd_Sum3(Simd_Mul(Simd_Load(m[0]), p), Simd_Mul(Simd_Load(m[1]), p), Simd_Mul(Simd_Load(m[2]), p)));
+#else
+	// row by row rather than through Mat_TransformPoint, so the whole matrix is never copied for one point
+	const Vec<3> p = Vec<3>::Load(v);
+	Vec3(Vec_Dot(Vec<3>::Load(m[0]), p) + m[0][3], Vec_Dot(Vec<3>::Load(m[1]), p) + m[1][3], Vec_Dot(Vec<3>::Load(m[2]), p) + m[2][3]).Store(_);
+#endif
+}
+
+#endif // MATHINLINE_H
@@ -0,0 +1,397 @@
+#ifndef MATHSIMD_H
+#define MATHSIMD_H
+
+// 4 wide float vectors for the hot Math routines: NEON on arm64-v8a, SSE on x86_64. MATH_SIMD is 0 on any other
+// target, or when MATH_NO_SIMD is defined, and the routines fall back to their scalar code.
+#if !defined(MATH_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MATH_SIMD		1
+#define MATH_SIMD_NEON	1
+#define MATH_SIMD_NAME	"neon"
+typedef float32x4_t simd4f;
+#elif !defined(MATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#ifdef __SSE3__
+#include <pmmintrin.h>
+#endif
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+#define MATH_SIMD		1
+#define MATH_SIMD_SSE	1
+#define MATH_SIMD_NAME	"sse"
+typedef __m128 simd4f;
+#else
+#define MATH_SIMD		0
+#define MATH_SIMD_NAME	"scalar"
+#endif
+
+#if MATH_SIMD
+
+#if defined(__GNUC__)
+#define SIMD_INLINE static inline __attribute__((always_inline))
+#else
+#define SIMD_INLINE static __forceinline
+#endif
+
+// unaligned, matrix rows are only 4 byte aligned
+SIMD_INLINE simd4f Simd_Load(const float* p) {
+#if MATH_SIMD_NEON
+	return vld1q_f32(p);
+#else
+	return _mm_loadu_ps(p);
+#endif
+}
+
+// x, y, z from memory and w from a constant, without reading past p[2]
+SIMD_INLINE simd4f Simd_Load3(const float* p, float w) {
+#if MATH_SIMD_NEON
+	return vcombine_f32(vld1_f32(p), vset_lane_f32(w, vld1_dup_f32(p + 2), 1));
+#else
+	return _mm_set_ps(w, p[2], p[1], p[0]);
+#endif
+}
+
+SIMD_INLINE void Simd_Store(float* p, simd4f a) {
+#if MATH_SIMD_NEON
+	vst1q_f32(p, a);
+#else
+	_mm_storeu_ps(p, a);
+#endif
+}
+
+// x, y, z only, for vec3_t destinations
+SIMD_INLINE void Simd_Store3(float* p, simd4f a) {
+#if MATH_SIMD_NEON
+	vst1_f32(p, vget_low_f32(a));
+	vst1q_lane_f32(p + 2, a, 2);
+#else
+	_mm_storel_pi((__m64*)p, a);
+	_mm_store_ss(p + 2, _mm_movehl_ps(a, a));
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Splat(float f) {
+#if MATH_SIMD_NEON
+	return vdupq_n_f32(f);
+#else
+	return _mm_set1_ps(f);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Add(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vaddq_f32(a, b);
+#else
+	return _mm_add_ps(a, b);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Sub(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vsubq_f32(a, b);
+#else
+	return _mm_sub_ps(a, b);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Mul(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vmulq_f32(a, b);
+#else
+	return _mm_mul_ps(a, b);
+#endif
+}
+
+// a + b * c, fused on arm64 so the last bit can differ from the scalar path
+SIMD_INLINE simd4f Simd_MulAdd(simd4f a, simd4f b, simd4f c) {
+#if MATH_SIMD_NEON
+	return vfmaq_f32(a, b, c);
+#else
+	return _mm_add_ps(a, _mm_mul_ps(b, c));
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Div(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vdivq_f32(a, b);
+#else
+	return _mm_div_ps(a, b);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Sqrt(simd4f a) {
+#if MATH_SIMD_NEON
+	return vsqrtq_f32(a);
+#else
+	return _mm_sqrt_ps(a);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Abs(simd4f a) {
+#if MATH_SIMD_NEON
+	return vabsq_f32(a);
+#else
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+#endif
+}
+
+// the sign bits of a, everything else zero, for flipping signs with Simd_Xor
+SIMD_INLINE simd4f Simd_SignBits(simd4f a) {
+#if MATH_SIMD_NEON
+	return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vdupq_n_u32(0x80000000)));
+#else
+	return _mm_and_ps(a, _mm_set1_ps(-0.0f));
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Xor(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+	return _mm_xor_ps(a, b);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Or(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+#else
+	return _mm_or_ps(a, b);
+#endif
+}
+
+// all ones where a > b
+SIMD_INLINE simd4f Simd_Greater(simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vreinterpretq_f32_u32(vcgtq_f32(a, b));
+#else
+	return _mm_cmpgt_ps(a, b);
+#endif
+}
+
+// a where mask is set, b elsewhere
+SIMD_INLINE simd4f Simd_Select(simd4f mask, simd4f a, simd4f b) {
+#if MATH_SIMD_NEON
+	return vbslq_f32(vreinterpretq_u32_f32(mask), a, b);
+#else
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+#endif
+}
+
+// one bit per lane of a Simd_Greater mask, x in bit 0
+SIMD_INLINE int Simd_Bits(simd4f mask) {
+#if MATH_SIMD_NEON
+	static const uint32_t bits[4] = { 1, 2, 4, 8 };
+	return (int)vaddvq_u32(vandq_u32(vreinterpretq_u32_f32(mask), vld1q_u32(bits)));
+#else
+	return _mm_movemask_ps(mask);
+#endif
+}
+
+// rows to columns, e.g. four quaternions to their x, y, z and w
+SIMD_INLINE void Simd_Transpose(simd4f* a, simd4f* b, simd4f* c, simd4f* d) {
+#if MATH_SIMD_NEON
+	const float32x4x2_t ab = vtrnq_f32(*a, *b);
+	const float32x4x2_t cd = vtrnq_f32(*c, *d);
+	*a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	*b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	*c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	*d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+#else
+	_MM_TRANSPOSE4_PS(*a, *b, *c, *d);
+#endif
+}
+
+// keeps w, zeroes x, y and z
+SIMD_INLINE simd4f Simd_MaskW(simd4f a) {
+#if MATH_SIMD_NEON
+	static const uint32_t mask[4] = { 0, 0, 0, 0xffffffff };
+	return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vld1q_u32(mask)));
+#else
+	return _mm_and_ps(a, _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0)));
+#endif
+}
+
+// the horizontal sums of a, b and c in x, y and z
+SIMD_INLINE simd4f Simd_Sum3(simd4f a, simd4f b, simd4f c) {
+#if MATH_SIMD_NEON
+	return vpaddq_f32(vpaddq_f32(a, b), vpaddq_f32(c, c));
+#elif defined(__SSE3__)
+	return _mm_hadd_ps(_mm_hadd_ps(a, b), _mm_hadd_ps(c, c));
+#else
+	simd4f d = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(a, b, c, d);
+	return _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d));
+#endif
+}
+
+/*
+sin and cos of 4 angles at once, the Cephes single precision kernel: the angle is reduced to an octant with pi / 4
+split in three parts, then a degree 7 (sin) or 8 (cos) polynomial runs on the remainder. Plain multiplies and adds
+on both paths, so NEON and SSE return the same bits. Against double precision sin and cos the error is at most
+7.8e-8 absolute, 2 ulp away from the zeros, for |x| <= 8192 (libm sinf is within 3.2e-8). That covers angles in
+radians of any practical size; above it the reduction loses bits and the error grows with |x|.
+*/
+
+#define SIMD_SINCOS_FOPI	1.27323954473516f		// 4 / pi
+#define SIMD_SINCOS_DP1		-0.78515625f			// -pi / 4 in three parts
+#define SIMD_SINCOS_DP2		-2.4187564849853515625e-4f
+#define SIMD_SINCOS_DP3		-3.77489497744594108e-8f
+#define SIMD_SINCOS_S0		-1.9515295891e-4f
+#define SIMD_SINCOS_S1		8.3321608736e-3f
+#define SIMD_SINCOS_S2		-1.6666654611e-1f
+#define SIMD_SINCOS_C0		2.443315711809948e-5f
+#define SIMD_SINCOS_C1		-1.388731625493765e-3f
+#define SIMD_SINCOS_C2		4.166664568298827e-2f
+
+SIMD_INLINE void Simd_SinCos(simd4f x, simd4f* sin, simd4f* cos) {
+#if MATH_SIMD_NEON
+	uint32x4_t signSin = vcltq_f32(x, vdupq_n_f32(0.0f));
+	x = vabsq_f32(x);
+	// octant, rounded up to even
+	uint32x4_t octant = vcvtq_u32_f32(vmulq_f32(x, vdupq_n_f32(SIMD_SINCOS_FOPI)));
+	octant = vandq_u32(vaddq_u32(octant, vdupq_n_u32(1)), vdupq_n_u32(~1u));
+	const simd4f y = vcvtq_f32_u32(octant);
+	x = vaddq_f32(x, vmulq_f32(y, vdupq_n_f32(SIMD_SINCOS_DP1)));
+	x = vaddq_f32(x, vmulq_f32(y, vdupq_n_f32(SIMD_SINCOS_DP2)));
+	x = vaddq_f32(x, vmulq_f32(y, vdupq_n_f32(SIMD_SINCOS_DP3)));
+	const uint32x4_t swap = vtstq_u32(octant, vdupq_n_u32(2));
+	signSin = veorq_u32(signSin, vtstq_u32(octant, vdupq_n_u32(4)));
+	const uint32x4_t signCos = vtstq_u32(vsubq_u32(octant, vdupq_n_u32(2)), vdupq_n_u32(4));
+#else
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 signSin = _mm_and_ps(x, signMask);
+	x = _mm_andnot_ps(signMask, x);
+	// octant, rounded up to even
+	__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(SIMD_SINCOS_FOPI)));
+	octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+	const __m128 y = _mm_cvtepi32_ps(octant);
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SIMD_SINCOS_DP1)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SIMD_SINCOS_DP2)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SIMD_SINCOS_DP3)));
+	const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+	signSin = _mm_xor_ps(signSin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+	const __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+#endif
+	const simd4f z = Simd_Mul(x, x);
+	simd4f c = Simd_Add(Simd_Mul(Simd_Splat(SIMD_SINCOS_C0), z), Simd_Splat(SIMD_SINCOS_C1));
+	c = Simd_Add(Simd_Mul(c, z), Simd_Splat(SIMD_SINCOS_C2));
+	c = Simd_Mul(Simd_Mul(c, z), z);
+	c = Simd_Add(Simd_Sub(c, Simd_Mul(z, Simd_Splat(0.5f))), Simd_Splat(1.0f));
+	simd4f s = Simd_Add(Simd_Mul(Simd_Splat(SIMD_SINCOS_S0), z), Simd_Splat(SIMD_SINCOS_S1));
+	s = Simd_Add(Simd_Mul(s, z), Simd_Splat(SIMD_SINCOS_S2));
+	s = Simd_Add(Simd_Mul(Simd_Mul(s, z), x), x);
+	// octants 2 and 6 (mod 8) swap the polynomials
+#if MATH_SIMD_NEON
+	const simd4f sinPoly = vbslq_f32(swap, c, s);
+	const simd4f cosPoly = vbslq_f32(swap, s, c);
+	*sin = vbslq_f32(signSin, vnegq_f32(sinPoly), sinPoly);
+	*cos = vbslq_f32(signCos, cosPoly, vnegq_f32(cosPoly));
+#else
+	const __m128 sinPoly = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+	const __m128 cosPoly = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+	*sin = _mm_xor_ps(sinPoly, signSin);
+	*cos = _mm_xor_ps(cosPoly, signCos);
+#endif
+}
+
+SIMD_INLINE simd4f Simd_Sin(simd4f x) {
+	simd4f sin, cos;
+	Simd_SinCos(x, &sin, &cos);
+	return sin;
+}
+
+/*
+acos of 4 values in [-1, 1], the Cephes single precision asin polynomial: near +-1 on the half angle square root
+(acos x = 2 asin sqrt((1 - x) / 2)), elsewhere as pi / 2 - asin x. At most 3.0e-7 absolute error against double
+precision acos.
+*/
+
+SIMD_INLINE simd4f Simd_Acos(simd4f x) {
+	const simd4f sign = Simd_SignBits(x);
+	const simd4f a = Simd_Abs(x);
+	const simd4f half = Simd_Greater(a, Simd_Splat(0.5f));
+	const simd4f z = Simd_Select(half, Simd_Mul(Simd_Splat(0.5f), Simd_Sub(Simd_Splat(1.0f), a)), Simd_Mul(a, a));
+	const simd4f r = Simd_Select(half, Simd_Sqrt(z), a);
+	simd4f p = Simd_Add(Simd_Mul(Simd_Splat(4.2163199048e-2f), z), Simd_Splat(2.4181311049e-2f));
+	p = Simd_Add(Simd_Mul(p, z), Simd_Splat(4.5470025998e-2f));
+	p = Simd_Add(Simd_Mul(p, z), Simd_Splat(7.4953002686e-2f));
+	p = Simd_Add(Simd_Mul(p, z), Simd_Splat(1.6666752422e-1f));
+	// asin of r
+	p = Simd_Add(Simd_Mul(Simd_Mul(p, z), r), r);
+	// |x| > 0.5: 2 p for x > 0, pi - 2 p for x < 0; otherwise pi / 2 - p for x > 0, pi / 2 + p for x < 0
+	const simd4f twice = Simd_Add(p, p);
+	const simd4f near = Simd_Select(Simd_Greater(Simd_Splat(0.0f), x), Simd_Sub(Simd_Splat(3.14159265358979f), twice), twice);
+	const simd4f middle = Simd_Sub(Simd_Splat(1.57079632679490f), Simd_Xor(p, sign));
+	return Simd_Select(half, near, middle);
+}
+
+/*
+Half floats, 4 at a time. NEON and F16C convert in hardware (FCVTN / FCVTL, VCVTPS2PH / VCVTPH2PS), plain SSE2 does
+the same in integer lanes: round to nearest even, overflow to infinity, denormals kept, NaN stays a quiet NaN.
+*/
+
+SIMD_INLINE void Simd_StoreHalf(unsigned short* p, simd4f a) {
+#if MATH_SIMD_NEON
+	vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(a)));
+#elif defined(__F16C__)
+	_mm_storel_epi64((__m128i*)p, _mm_cvtps_ph(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+#else
+	const __m128i bits = _mm_castps_si128(a);
+	const __m128i sign = _mm_and_si128(bits, _mm_set1_epi32(0x80000000));
+	const __m128i abs = _mm_xor_si128(bits, sign);
+	// below the smallest normal half the float adder does the rounding, against a magic number whose last
+	// mantissa bit is the half denormal step
+	const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23));
+	const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(abs), magic)), _mm_castps_si128(magic));
+	// otherwise rebias the exponent and round the 13 dropped bits to even, a carry out of the mantissa
+	// bumps the exponent and 65520 and up become infinity
+	const __m128i odd = _mm_and_si128(_mm_srli_epi32(abs, 13), _mm_set1_epi32(1));
+	const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_sub_epi32(abs, _mm_set1_epi32(((127 - 15) << 23) - 0xfff)), odd), 13);
+	const __m128i nan = _mm_and_si128(_mm_cmpgt_epi32(abs, _mm_set1_epi32(0x7f800000)), _mm_set1_epi32(0x0200));
+	const __m128i isDenormal = _mm_cmplt_epi32(abs, _mm_set1_epi32(113 << 23));
+	const __m128i isOverflow = _mm_cmpgt_epi32(abs, _mm_set1_epi32(((127 + 16) << 23) - 1));
+	__m128i h = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+	h = _mm_or_si128(_mm_and_si128(isOverflow, _mm_or_si128(_mm_set1_epi32(0x7c00), nan)), _mm_andnot_si128(isOverflow, h));
+	h = _mm_or_si128(h, _mm_srli_epi32(sign, 16));
+	// sign extended, so the saturating pack keeps all 16 bits
+	h = _mm_srai_epi32(_mm_slli_epi32(h, 16), 16);
+	_mm_storel_epi64((__m128i*)p, _mm_packs_epi32(h, h));
+#endif
+}
+
+SIMD_INLINE simd4f Simd_LoadHalf(const unsigned short* p) {
+#if MATH_SIMD_NEON
+	return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p)));
+#elif defined(__F16C__)
+	return _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)p));
+#else
+	const __m128i h = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+	const __m128i em = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+	// one multiply by 2^112 rebiases the exponent and normalizes denormals, exactly
+	__m128 f = _mm_mul_ps(_mm_castsi128_ps(em), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+	const __m128i infNan = _mm_cmpgt_epi32(em, _mm_set1_epi32((0x7c00 << 13) - 1));
+	f = _mm_or_ps(f, _mm_castsi128_ps(_mm_and_si128(infNan, _mm_set1_epi32(255 << 23))));
+	return _mm_or_ps(f, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16)));
+#endif
+}
+
+SIMD_INLINE float Simd_Lane(simd4f a, int lane) {
+	float lanes[4];
+	Simd_Store(lanes, a);
+	return lanes[lane];
+}
+
+// the names the xash vector sin/cos code in Math.cpp was written against
+typedef simd4f v4sf;
+#define sincos_ps(x, s, c)	Simd_SinCos(x, s, c)
+#define sin_ps(x)			Simd_Sin(x)
+#define s4f_x(a)			Simd_Lane(a, 0)
+#define s4f_y(a)			Simd_Lane(a, 1)
+#define s4f_z(a)			Simd_Lane(a, 2)
+#define s4f_w(a)			Simd_Lane(a, 3)
+
+#endif // MATH_SIMD
+
+#endif // MATHSIMD_H
@@ -0,0 +1,206 @@
+#ifndef MATHVEC_H
+#define MATHVEC_H
+
+#include <math.h>
+#include <string.h>
+#include "MathSimd.h"
+
+// Fixed size float vectors and row major matrices by value, so the compiler sees whole values instead of separate
+// stores through float pointers, and constant ones fold at compile time. 3 and 4 component vectors are 16 byte
+// aligned with 4 floats of storage, the 3 component one padded with a zero w, so a vector is one Simd_Load away.
+// The vec3_t and matrix3x4 style arrays the rest of lib/Math uses move in and out with Load and Store, which only
+// touch the first N floats.
+template<int N>
+struct alignas(N >= 3 ? 16 : 4 * N) Vec {
+	enum { Size = N, Width = N == 3 ? 4 : N };
+	float v[Width];
+
+	constexpr float operator[](int i) const { return v[i]; }
+	constexpr float& operator[](int i) { return v[i]; }
+
+	static constexpr Vec Load(const float* p) {
+		Vec r = {};
+		for (int i = 0; i < N; i++) r.v[i] = p[i];
+		return r;
+	}
+	void Store(float* p) const {
+		for (int i = 0; i < N; i++) p[i] = v[i];
+	}
+};
+
+template<int R, int C>
+struct Mat {
+	Vec<C> r[R];
+
+	constexpr const Vec<C>& operator[](int i) const { return r[i]; }
+	constexpr Vec<C>& operator[](int i) { return r[i]; }
+
+	static constexpr Mat Load(const float (*m)[C]) {
+		Mat a = {};
+		for (int i = 0; i < R; i++) a.r[i] = Vec<C>::Load(m[i]);
+		return a;
+	}
+	void Store(float (*m)[C]) const {
+		for (int i = 0; i < R; i++) r[i].Store(m[i]);
+	}
+	// ones on the diagonal, for 3x4 the identity transform
+	static constexpr Mat Identity() {
+		Mat a = {};
+		for (int i = 0; i < R && i < C; i++) a.r[i].v[i] = 1.0f;
+		return a;
+	}
+};
+
+constexpr Vec<2> Vec2(float x, float y) { return Vec<2>{ { x, y } }; }
+constexpr Vec<3> Vec3(float x, float y, float z) { return Vec<3>{ { x, y, z, 0.0f } }; }
+constexpr Vec<4> Vec4(float x, float y, float z, float w) { return Vec<4>{ { x, y, z, w } }; }
+
+template<int N> constexpr Vec<N> Vec_Splat(float f) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = f;
+	return r;
+}
+
+// elementwise over the N components only: running a loaded Vec<3> over its padding too makes the compiler spill it
+// and read it back 16 bytes wide, which stalls on the three 4 byte writes that filled it
+template<int N> constexpr Vec<N> operator+(const Vec<N>& a, const Vec<N>& b) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] + b.v[i];
+	return r;
+}
+template<int N> constexpr Vec<N> operator-(const Vec<N>& a, const Vec<N>& b) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] - b.v[i];
+	return r;
+}
+template<int N> constexpr Vec<N> operator-(const Vec<N>& a) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = -a.v[i];
+	return r;
+}
+template<int N> constexpr Vec<N> operator*(const Vec<N>& a, const Vec<N>& b) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] * b.v[i];
+	return r;
+}
+template<int N> constexpr Vec<N> operator*(const Vec<N>& a, float f) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] * f;
+	return r;
+}
+template<int N> constexpr Vec<N> operator*(float f, const Vec<N>& a) { return a * f; }
+template<int N> constexpr Vec<N> operator/(const Vec<N>& a, float d) { return a * (1.0f / d); }
+template<int N> constexpr bool operator==(const Vec<N>& a, const Vec<N>& b) {
+	for (int i = 0; i < N; i++)
+		if (a.v[i] != b.v[i]) return false;
+	return true;
+}
+template<int N> constexpr bool operator!=(const Vec<N>& a, const Vec<N>& b) { return !(a == b); }
+
+// a + b * f
+template<int N> constexpr Vec<N> Vec_MA(const Vec<N>& a, float f, const Vec<N>& b) { return a + b * f; }
+template<int N> constexpr Vec<N> Vec_Lerp(const Vec<N>& a, float t, const Vec<N>& b) { return a + (b - a) * t; }
+template<int N> constexpr Vec<N> Vec_Min(const Vec<N>& a, const Vec<N>& b) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+	return r;
+}
+template<int N> constexpr Vec<N> Vec_Max(const Vec<N>& a, const Vec<N>& b) {
+	Vec<N> r = {};
+	for (int i = 0; i < N; i++) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+	return r;
+}
+template<int N> constexpr Vec<N> Vec_Abs(const Vec<N>& a) { return Vec_Max(a, -a); }
+
+template<int N> constexpr float Vec_Dot(const Vec<N>& a, const Vec<N>& b) {
+	float d = a.v[0] * b.v[0];
+	for (int i = 1; i < N; i++) d += a.v[i] * b.v[i];
+	return d;
+}
+template<int N> constexpr float Vec_Sum(const Vec<N>& a) {
+	float s = a.v[0];
+	for (int i = 1; i < N; i++) s += a.v[i];
+	return s;
+}
+template<int N> constexpr float Vec_MaxComponent(const Vec<N>& a) {
+	float m = a.v[0];
+	for (int i = 1; i < N; i++) m = a.v[i] > m ? a.v[i] : m;
+	return m;
+}
+constexpr Vec<3> Vec_Cross(const Vec<3>& a, const Vec<3>& b) {
+	return Vec3(a.v[1] * b.v[2] - a.v[2] * b.v[1], a.v[2] * b.v[0] - a.v[0] * b.v[2], a.v[0] * b.v[1] - a.v[1] * b.v[0]);
+}
+
+template<int N> inline float Vec_Length(const Vec<N>& a) { return sqrtf(Vec_Dot(a, a)); }
+template<int N> inline float Vec_Distance(const Vec<N>& a, const Vec<N>& b) { return Vec_Length(a - b); }
+// zero length stays zero
+template<int N> inline Vec<N> Vec_Normalize(const Vec<N>& a) {
+	const float length = Vec_Length(a);
+	return length ? a * (1.0f / length) : a;
+}
+// one Newton step from the bit trick estimate, about 0.2% off
+template<int N> inline Vec<N> Vec_NormalizeFast(const Vec<N>& a) {
+	const float d = Vec_Dot(a, a);
+	if (!d) return a;
+	int i;
+	float y;
+	memcpy(&i, &d, sizeof(i));
+	i = 0x5f3759df - (i >> 1);
+	memcpy(&y, &i, sizeof(y));
+	return a * (y * (1.5f - 0.5f * d * y * y));
+}
+
+template<int R, int C> constexpr Vec<R> Mat_Transform(const Mat<R, C>& m, const Vec<C>& v) {
+	Vec<R> r = {};
+	for (int i = 0; i < R; i++) r.v[i] = Vec_Dot(m.r[i], v);
+	return r;
+}
+// v as a point with w = 1 through the first three columns and the translation in the fourth
+template<int R> constexpr Vec<R> Mat_TransformPoint(const Mat<R, 4>& m, const Vec<3>& v) {
+	Vec<R> r = {};
+	for (int i = 0; i < R; i++) r.v[i] = v.v[0] * m.r[i].v[0] + v.v[1] * m.r[i].v[1] + v.v[2] * m.r[i].v[2] + m.r[i].v[3];
+	return r;
+}
+// a * b, each row of the result a sum of the rows of b
+template<int R, int K, int C> constexpr Mat<R, C> Mat_Mul(const Mat<R, K>& a, const Mat<K, C>& b) {
+	Mat<R, C> m = {};
+	for (int i = 0; i < R; i++) {
+		Vec<C> row = b.r[0] * a.r[i].v[0];
+		for (int k = 1; k < K; k++) row = Vec_MA(row, a.r[i].v[k], b.r[k]);
+		m.r[i] = row;
+	}
+	return m;
+}
+// a * b for transforms that leave out an implied 0 0 0 1 bottom row, the first three rows of a 4x4 or all of a 3x4
+template<int R> constexpr Mat<R, 4> Mat_ConcatTransforms(const Mat<R, 4>& a, const Mat<R, 4>& b) {
+	Mat<R, 4> m = {};
+	for (int i = 0; i < R; i++) {
+		Vec<4> row = b.r[0] * a.r[i].v[0];
+		for (int k = 1; k < 3; k++) row = Vec_MA(row, a.r[i].v[k], b.r[k]);
+		row.v[3] += a.r[i].v[3];
+		m.r[i] = row;
+	}
+	return m;
+}
+template<int R, int C> constexpr Mat<C, R> Mat_Transpose(const Mat<R, C>& a) {
+	Mat<C, R> m = {};
+	for (int i = 0; i < R; i++)
+		for (int j = 0; j < C; j++) m.r[j].v[i] = a.r[i].v[j];
+	return m;
+}
+
+#if MATH_SIMD
+// the aligned storage of a 3 or 4 component vector as one register, w is 0 for Vec<3>
+template<int N> SIMD_INLINE simd4f Simd_FromVec(const Vec<N>& a) {
+	static_assert(Vec<N>::Width == 4, "only 3 and 4 component vectors fill a register");
+	return Simd_Load(a.v);
+}
+template<int N> SIMD_INLINE Vec<N> Simd_ToVec(simd4f a) {
+	static_assert(Vec<N>::Width == 4, "only 3 and 4 component vectors fill a register");
+	Vec<N> r;
+	Simd_Store(r.v, a);
+	return r;
+}
+#endif
+
+#endif // MATHVEC_H
@@ -6,7 +6,21 @@
 #include <string.h>
 #include <unistd.h>
 
+#ifdef __ANDROID__
 #include <android/log.h>
+#else
+// desktop builds, such as the standalone MathCheck, print the log to stdout
+#include <stdarg.h>
+enum { ANDROID_LOG_VERBOSE = 2, ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR };
+static inline int __android_log_print(int priority, const char* tag, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	const int written = vprintf(format, args);
+	va_end(args);
+	putchar('\n');
+	return written;
+}
+#endif
 
 #define ALOG_TAG "TAG1"
 #define ALOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, ALOG_TAG, __VA_ARGS__))
@@ -195,6 +195,8 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback {
 
 		try {
 			setenv("DOTQUEST_LIBDIR", getApplicationInfo().nativeLibraryDir, true);
+			// the .NET diagnostics socket lives in TMPDIR, and /tmp does not exist on Android
+			setenv("TMPDIR", getCacheDir().getAbsolutePath(), true);
 		} catch (Exception e) {
 		}
 